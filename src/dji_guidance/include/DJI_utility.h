@@ -1,65 +1,76 @@
-#ifndef __DJI_UTILITY_H__
-#define __DJI_UTILITY_H__
-#include <stdio.h>
-
-#ifdef WIN32
-
-#include <Windows.h>
-#include <WinBase.h>
-
-class DJI_lock
-{
-public:
-	DJI_lock();
-	~DJI_lock();
-	void         enter();
-	void         leave();
-private:
-	CRITICAL_SECTION  m_critical_section;
-};
-
-class DJI_event
-{
-public:
-	DJI_event();
-	~DJI_event();
-	int         set_event();
-	int         wait_event();
-private:
-	HANDLE      m_pipe_read;
-	HANDLE      m_pipe_write;
-};
-
-#else
-
-#include <pthread.h>
-#include <semaphore.h>
-
-class DJI_lock
-{
-public:
-	DJI_lock();
-	~DJI_lock();
-	void         enter();
-	void         leave();
-private:
-	pthread_mutex_t m_lock;
-};
-
-class DJI_event
-{
-public:
-	DJI_event();
-	~DJI_event();
-	int         set_event();
-	int         wait_event();
-private:
-	sem_t		m_sem;
-};
-
-#endif
-
-void   sleep( int microsecond );
-
-
-#endif
+#ifndef __DJI_UTILITY_H__
+#define __DJI_UTILITY_H__
+#include <stdio.h>
+
+#ifdef WIN32
+
+#include <Windows.h>
+#include <WinBase.h>
+
+class DJI_lock
+{
+public:
+	DJI_lock();
+	~DJI_lock();
+	void         enter();
+	void         leave();
+private:
+	CRITICAL_SECTION  m_critical_section;
+};
+
+class DJI_event
+{
+public:
+	DJI_event();
+	~DJI_event();
+	int         set_event();
+	int         wait_event();
+private:
+	HANDLE      m_pipe_read;
+	HANDLE      m_pipe_write;
+};
+
+#else
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+class DJI_lock
+{
+public:
+	DJI_lock();
+	~DJI_lock();
+	void         enter();
+	void         leave();
+private:
+	std::mutex m_lock;
+};
+
+/* Event built on a condition variable instead of a semaphore. Signals
+ * are coalesced: all set_event() calls that land in one transfer window
+ * are drained by a single wakeup, so the consumer loses the per-signal
+ * scheduling hop. wait_event_for() adds a timed wait so main loops can
+ * bound their latency without spinning on sleeps. */
+class DJI_event
+{
+public:
+	DJI_event();
+	~DJI_event();
+	int         set_event();
+	int         wait_event();
+
+	/* Returns 0 when signalled, -1 on timeout. */
+	int         wait_event_for( int microseconds );
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	unsigned int m_pending;
+};
+
+#endif
+
+void   sleep( int microsecond );
+
+
+#endif
@@ -23,10 +23,17 @@
 #include <geometry_msgs/TransformStamped.h> //IMU
 #include <geometry_msgs/Vector3Stamped.h> //velocity
 #include <sensor_msgs/LaserScan.h> //obstacle distance & ultrasonic
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/point_cloud2_iterator.h>
+#include <vector>
 
 ros::Publisher image_pub;
 ros::Publisher imu_pub;
 ros::Publisher velocity_pub;
+ros::Publisher cloud_pub;
+
+// Decimation factor for the published point cloud (1 = every pixel).
+int cloud_decimation = 2;
 
 using namespace cv;
 
@@ -43,6 +50,68 @@ DJI_lock        g_lock;
 DJI_event       g_event;
 Mat             g_depth(HEIGHT,WIDTH,CV_16SC1);
 
+/* Convert one 16-bit depth image straight into a preallocated
+ * PointCloud2. The per-column and per-row ray factors are precomputed
+ * once, rows are walked with the configured decimation, and invalid
+ * depths are compacted out with a predicated index instead of a branchy
+ * write path. Guidance depth is fixed point with 7 fractional bits. */
+static void publish_depth_cloud(image_data* data, e_vbus_index idx)
+{
+    if (cloud_pub.getNumSubscribers() == 0 || !data->m_depth_image[idx])
+        return;
+
+    static std::vector<float> col_factors, row_factors;
+    if (col_factors.empty())
+    {
+        // Guidance camera intrinsics, as used elsewhere in this stack.
+        const float fx = 248.9f, fy = 247.6f;
+        col_factors.resize(WIDTH);
+        row_factors.resize(HEIGHT);
+        for (int u = 0; u < WIDTH; ++u)
+            col_factors[u] = (u - 0.5f * WIDTH) / fx;
+        for (int v = 0; v < HEIGHT; ++v)
+            row_factors[v] = (v - 0.5f * HEIGHT) / fy;
+    }
+
+    static sensor_msgs::PointCloud2 cloud_msg;
+    sensor_msgs::PointCloud2Modifier modifier(cloud_msg);
+    if (cloud_msg.fields.empty())
+        modifier.setPointCloud2FieldsByString(1, "xyz");
+
+    const int step = (cloud_decimation > 1) ? cloud_decimation : 1;
+    const size_t max_points =
+        ((WIDTH + step - 1) / step) * ((HEIGHT + step - 1) / step);
+    modifier.resize(max_points);
+
+    cloud_msg.header.frame_id = "guidance";
+    cloud_msg.header.stamp = ros::Time::now();
+
+    const int16_t* depth =
+        reinterpret_cast<const int16_t*>(data->m_depth_image[idx]);
+    float* out = reinterpret_cast<float*>(&cloud_msg.data[0]);
+
+    size_t count = 0;
+    for (int v = 0; v < HEIGHT; v += step)
+    {
+        const float row_factor = row_factors[v];
+        const int16_t* row = depth + v * WIDTH;
+        for (int u = 0; u < WIDTH; u += step)
+        {
+            const int16_t raw = row[u];
+            const float z = raw * (1.0f / 128.0f);
+
+            // Always write, only advance on valid depth.
+            out[3 * count]     = col_factors[u] * z;
+            out[3 * count + 1] = row_factor * z;
+            out[3 * count + 2] = z;
+            count += (raw > 0) ? 1 : 0;
+        }
+    }
+
+    modifier.resize(count);
+    cloud_pub.publish(cloud_msg);
+}
+
 std::ostream& operator<<(std::ostream& out, const e_sdk_err_code value){
     const char* s = 0;
     static char str[100]={0};
@@ -108,6 +177,11 @@ int my_callback(int data_type, int data_len, char *content)
 
         image_pub.publish(msg);
         std::cout << "published " << msg.images.size() << " images" << std::endl;
+
+        // point cloud output for the SLAM stack
+        publish_depth_cloud(data, e_vbus2);
+        publish_depth_cloud(data, e_vbus3);
+        publish_depth_cloud(data, e_vbus4);
     }
 
     /* imu */
@@ -160,6 +234,8 @@ int main(int argc, char** argv)
     ros::NodeHandle my_node;
     
     image_pub    = my_node.advertise<dji_guidance::multi_image>("/guidance/depth/images",1);
+    cloud_pub    = my_node.advertise<sensor_msgs::PointCloud2>("/guidance/depth/points",1);
+    my_node.param("cloud_decimation", cloud_decimation, cloud_decimation);
     imu_pub      = my_node.advertise<geometry_msgs::TransformStamped>("/guidance/depth/imu",1);
     velocity_pub = my_node.advertise<geometry_msgs::Vector3Stamped>("/guidance/depth/velocity",1);
 
@@ -7,6 +7,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <ros/ros.h>
 #include <cv_bridge/cv_bridge.h>
 #include <sensor_msgs/Image.h>
@@ -50,12 +54,168 @@ e_vbus_index    CAMERA_ID = get_default_camera_id();
 exposure_param  exposure_para = get_default_exposure_param(CAMERA_ID);
 DJI_lock        g_lock;
 DJI_event       g_event;
-Mat             g_greyscale_image_left(HEIGHT, WIDTH, CV_8UC1);
-Mat             g_greyscale_image_right(HEIGHT, WIDTH, CV_8UC1);
-Mat             g_depth(HEIGHT,WIDTH,CV_16SC1);
-Mat             depth8(HEIGHT, WIDTH, CV_8UC1);
-Mat             g_disparity(HEIGHT,WIDTH,CV_16SC1);
-Mat             disparity8(HEIGHT, WIDTH, CV_8UC1);
+
+/* Per-data-type handoff. The SDK callback only copies image planes into
+ * a staging set and signals the worker thread; building and publishing
+ * the four image messages happens off the SDK thread. Small data (IMU,
+ * velocity, ultrasonic, obstacle distance) still publishes inline in the
+ * callback, so the 100 Hz streams are never head-of-line blocked behind
+ * 20 Hz image serialization. The mailbox is latest-wins: if the worker
+ * has not consumed the previous frame set, it is overwritten. */
+struct ImageSet {
+    bool has_left, has_right, has_depth, has_disparity;
+    ros::Time stamp;
+    char left[IMAGE_SIZE];
+    char right[IMAGE_SIZE];
+    char depth[IMAGE_SIZE * 2];
+    char disparity[IMAGE_SIZE * 2];
+};
+
+static ImageSet g_image_set_a, g_image_set_b;
+static ImageSet* g_image_staging = &g_image_set_a;
+static ImageSet* g_image_working = &g_image_set_b;
+static bool g_image_pending = false;
+static bool g_image_worker_running = false;
+static std::mutex g_image_mutex;
+static std::condition_variable g_image_cv;
+static std::thread g_image_worker;
+
+/* Small per-stream message pools. A message is reused once every
+ * subscriber has released it (use_count back to 1), so the steady-state
+ * publish path performs exactly one copy -- SDK buffer to message data --
+ * with no cv_bridge round-trip and no allocation. */
+static std::vector<sensor_msgs::ImagePtr> left_pool, right_pool,
+                                          depth_pool, disparity_pool;
+
+static sensor_msgs::ImagePtr pool_acquire(std::vector<sensor_msgs::ImagePtr>& pool)
+{
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+        if (pool[i].use_count() == 1)
+            return pool[i];
+    }
+
+    sensor_msgs::ImagePtr fresh(new sensor_msgs::Image());
+    pool.push_back(fresh);
+    return fresh;
+}
+
+/* Worker thread: build and publish the image messages for the newest
+ * staged frame set. */
+static void image_worker_loop();
+
+/* Fill a pooled Image message straight from a staged buffer. */
+static sensor_msgs::ImagePtr make_image_msg(std::vector<sensor_msgs::ImagePtr>& pool,
+                                            const char* buffer,
+                                            int bytes_per_pixel,
+                                            const std::string& encoding,
+                                            const ros::Time& stamp)
+{
+    sensor_msgs::ImagePtr msg = pool_acquire(pool);
+    msg->header.frame_id = "guidance";
+    msg->header.stamp    = stamp;
+    msg->height = HEIGHT;
+    msg->width  = WIDTH;
+    msg->encoding = encoding;
+    msg->is_bigendian = 0;
+    msg->step = WIDTH * bytes_per_pixel;
+    msg->data.resize(IMAGE_SIZE * bytes_per_pixel);
+    memcpy(&msg->data[0], buffer, IMAGE_SIZE * bytes_per_pixel);
+    return msg;
+}
+
+/* Dynamic stream management: only streams with active subscribers are
+ * selected on the Guidance USB link. The SDK applies selection changes
+ * around a transfer restart, so this only runs when the subscriber set
+ * actually changes. Unused greyscale streams otherwise cost USB
+ * bandwidth that degrades depth frame regularity. */
+static bool g_left_selected = false;
+static bool g_right_selected = false;
+static bool g_depth_selected = false;
+static bool g_disparity_selected = false;
+
+static void select_small_data_streams()
+{
+    select_imu();
+    select_ultrasonic();
+    select_obstacle_distance();
+    select_velocity();
+}
+
+static void update_stream_selection()
+{
+    const bool want_left = left_image_pub.getNumSubscribers() > 0;
+    const bool want_right = right_image_pub.getNumSubscribers() > 0;
+    const bool want_depth = depth_image_pub.getNumSubscribers() > 0;
+    const bool want_disparity = disparity_image_pub.getNumSubscribers() > 0;
+
+    if (want_left == g_left_selected && want_right == g_right_selected &&
+        want_depth == g_depth_selected && want_disparity == g_disparity_selected)
+        return;
+
+    std::cout << "subscriber set changed, reselecting Guidance streams"
+              << std::endl;
+
+    stop_transfer();
+    reset_config();
+
+    if (want_left)
+        select_greyscale_image(CAMERA_ID, true);
+    if (want_right)
+        select_greyscale_image(CAMERA_ID, false);
+    if (want_depth)
+        select_depth_image(CAMERA_ID);
+    if (want_disparity)
+        select_disparity_image(CAMERA_ID);
+
+    // small data is always on: it is cheap and the state estimator needs it
+    select_small_data_streams();
+
+    start_transfer();
+
+    g_left_selected = want_left;
+    g_right_selected = want_right;
+    g_depth_selected = want_depth;
+    g_disparity_selected = want_disparity;
+}
+
+static void image_worker_loop()
+{
+    while (true)
+    {
+        ImageSet* working;
+        {
+            std::unique_lock<std::mutex> guard(g_image_mutex);
+            while (!g_image_pending && g_image_worker_running)
+                g_image_cv.wait(guard);
+
+            if (!g_image_worker_running)
+                return;
+
+            // swap mailboxes: the callback keeps writing into the other set
+            std::swap(g_image_staging, g_image_working);
+            g_image_pending = false;
+            working = g_image_working;
+        }
+
+        if (working->has_left)
+            left_image_pub.publish(make_image_msg(
+                left_pool, working->left, 1,
+                sensor_msgs::image_encodings::MONO8, working->stamp));
+        if (working->has_right)
+            right_image_pub.publish(make_image_msg(
+                right_pool, working->right, 1,
+                sensor_msgs::image_encodings::MONO8, working->stamp));
+        if (working->has_depth)
+            depth_image_pub.publish(make_image_msg(
+                depth_pool, working->depth, 2,
+                sensor_msgs::image_encodings::MONO16, working->stamp));
+        if (working->has_disparity)
+            disparity_image_pub.publish(make_image_msg(
+                disparity_pool, working->disparity, 2,
+                sensor_msgs::image_encodings::MONO16, working->stamp));
+    }
+}
 
 std::ostream& operator<<(std::ostream& out, const e_sdk_err_code value){
     const char* s = 0;
@@ -91,52 +251,36 @@ int my_callback(int data_type, int data_len, char *content)
     {        
         image_data* data = (image_data*)content;
 
-        if ( data->m_greyscale_image_left[CAMERA_ID] ){
-            memcpy(g_greyscale_image_left.data, data->m_greyscale_image_left[CAMERA_ID], IMAGE_SIZE);
-            //imshow("left",  g_greyscale_image_left);
-            // publish left greyscale image
-            cv_bridge::CvImage left_8;
-            g_greyscale_image_left.copyTo(left_8.image);
-            left_8.header.frame_id  = "guidance";
-            left_8.header.stamp = ros::Time::now();
-            left_8.encoding     = sensor_msgs::image_encodings::MONO8;
-            left_image_pub.publish(left_8.toImageMsg());
-        }
-        if ( data->m_greyscale_image_right[CAMERA_ID] ){
-            memcpy(g_greyscale_image_right.data, data->m_greyscale_image_right[CAMERA_ID], IMAGE_SIZE);
-            //imshow("right", g_greyscale_image_right);
-            // publish right greyscale image
-            cv_bridge::CvImage right_8;
-            g_greyscale_image_right.copyTo(right_8.image);
-            right_8.header.frame_id  = "guidance";
-            right_8.header.stamp     = ros::Time::now();
-            right_8.encoding     = sensor_msgs::image_encodings::MONO8;
-            right_image_pub.publish(right_8.toImageMsg());
-        }
-        if ( data->m_depth_image[CAMERA_ID] ){
-            memcpy(g_depth.data, data->m_depth_image[CAMERA_ID], IMAGE_SIZE * 2);
-            //g_depth.convertTo(depth8, CV_8UC1);
-            //imshow("depth", depth8);
-            //publish depth image
-            cv_bridge::CvImage depth_16;
-            g_depth.copyTo(depth_16.image);
-            depth_16.header.frame_id  = "guidance";
-            depth_16.header.stamp     = ros::Time::now();
-            depth_16.encoding     = sensor_msgs::image_encodings::MONO16;
-            depth_image_pub.publish(depth_16.toImageMsg());
-        }
-        if ( data->m_disparity_image[CAMERA_ID] ){
-            memcpy(g_disparity.data, data->m_disparity_image[CAMERA_ID], IMAGE_SIZE * 2);
-            //g_disparity.convertTo(disparity8, CV_8UC1);
-            //imshow("disparity", disparity8);
-            //publish disparity image
-            cv_bridge::CvImage disparity_16;
-            g_disparity.copyTo(disparity_16.image);
-            disparity_16.header.frame_id  = "guidance";
-            disparity_16.header.stamp     = ros::Time::now();
-            disparity_16.encoding         = sensor_msgs::image_encodings::MONO16;
-            disparity_image_pub.publish(disparity_16.toImageMsg());
+        // stage the planes for the image worker; the SDK buffers are only
+        // valid for the duration of this callback
+        {
+            std::lock_guard<std::mutex> guard(g_image_mutex);
+            ImageSet* staging = g_image_staging;
+            staging->stamp = ros::Time::now();
+
+            staging->has_left = data->m_greyscale_image_left[CAMERA_ID] != NULL;
+            if (staging->has_left)
+                memcpy(staging->left, data->m_greyscale_image_left[CAMERA_ID],
+                       IMAGE_SIZE);
+
+            staging->has_right = data->m_greyscale_image_right[CAMERA_ID] != NULL;
+            if (staging->has_right)
+                memcpy(staging->right, data->m_greyscale_image_right[CAMERA_ID],
+                       IMAGE_SIZE);
+
+            staging->has_depth = data->m_depth_image[CAMERA_ID] != NULL;
+            if (staging->has_depth)
+                memcpy(staging->depth, data->m_depth_image[CAMERA_ID],
+                       IMAGE_SIZE * 2);
+
+            staging->has_disparity = data->m_disparity_image[CAMERA_ID] != NULL;
+            if (staging->has_disparity)
+                memcpy(staging->disparity, data->m_disparity_image[CAMERA_ID],
+                       IMAGE_SIZE * 2);
+
+            g_image_pending = true;
         }
+        g_image_cv.notify_one();
     }
 
     /* imu */
@@ -236,10 +380,14 @@ void set_camera_id_callback(const dji_guidance::set_camera_idConstPtr& msg) {
         reset_config();
         
         CAMERA_ID = idx;
-        select_greyscale_image(CAMERA_ID, true);
-        select_greyscale_image(CAMERA_ID, false);
-        select_depth_image(CAMERA_ID);
-        select_disparity_image(CAMERA_ID);
+
+        // reset_config cleared every selection: mark the image streams
+        // unselected so update_stream_selection rebuilds them from the
+        // subscriber set, and bring the small data streams straight back
+        // (they were previously lost here).
+        g_left_selected = g_right_selected = false;
+        g_depth_selected = g_disparity_selected = false;
+        select_small_data_streams();
 
         err_code = start_transfer();
         //RETURN_IF_ERR(err_code);
@@ -298,20 +446,13 @@ int main(int argc, char** argv)
         std::cout << cali[i].cu << "\t" << cali[i].cv << "\t" << cali[i].focal << "\t" << cali[i].baseline << std::endl;
     }
     
-    /* select data */
-    err_code = select_greyscale_image(CAMERA_ID, true);
-    RETURN_IF_ERR(err_code);
-    err_code = select_greyscale_image(CAMERA_ID, false);
-    RETURN_IF_ERR(err_code);
-    err_code = select_depth_image(CAMERA_ID);
-    RETURN_IF_ERR(err_code);
-    err_code = select_disparity_image(CAMERA_ID);
-    RETURN_IF_ERR(err_code);
+    /* select data: image streams are brought up on demand as subscribers
+     * appear (see update_stream_selection); small data is always on */
+    select_small_data_streams();
+    /* start the image worker before data begins flowing */
+    g_image_worker_running = true;
+    g_image_worker = std::thread(image_worker_loop);
 
-    select_imu();
-    select_ultrasonic();
-    select_obstacle_distance();
-    select_velocity();
     /* start data transfer */
     err_code = set_sdk_event_handler(my_callback);
     RETURN_IF_ERR(err_code);
@@ -320,9 +461,25 @@ int main(int argc, char** argv)
     
     std::cout << "start_transfer" << std::endl;
 
+    ros::Rate loop_rate(10);
     while (ros::ok()) {
         ros::spinOnce();
+
+        // bring Guidance streams in line with the current subscriber set
+        update_stream_selection();
+
+        loop_rate.sleep();
+    }
+
+    /* stop the image worker first: a joinable global thread at exit would
+     * terminate the process from its destructor on any error path below */
+    {
+        std::lock_guard<std::mutex> guard(g_image_mutex);
+        g_image_worker_running = false;
     }
+    g_image_cv.notify_all();
+    if (g_image_worker.joinable())
+        g_image_worker.join();
 
     /* release data transfer */
     err_code = stop_transfer();
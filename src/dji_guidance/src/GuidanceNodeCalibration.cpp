@@ -82,6 +82,21 @@ std::ostream& operator<<(std::ostream& out, const e_sdk_err_code value){
 std::string camera_params_left;
 std::string camera_params_right;
 
+/* Calibration is parsed once at startup (the YAML files used to be
+ * re-read and re-parsed for every frame of every camera), and the
+ * rectification maps are computed once from it. Per-frame rectification
+ * is then a single remap into a preallocated Mat. */
+sensor_msgs::CameraInfo g_cam_info_left_cached;
+sensor_msgs::CameraInfo g_cam_info_right_cached;
+bool g_cam_info_ready = false;
+
+cv::Mat g_rect_map_left_1, g_rect_map_left_2;
+cv::Mat g_rect_map_right_1, g_rect_map_right_2;
+cv::Mat g_rect_left, g_rect_right;
+bool g_rectify_ready = false;
+ros::Publisher left_rect_pub;
+ros::Publisher right_rect_pub;
+
 static const char CAM_YML_NAME[]    = "camera_name";
 static const char WIDTH_YML_NAME[]  = "image_width";
 static const char HEIGHT_YML_NAME[] = "image_height";
@@ -165,12 +180,22 @@ int my_callback(int data_type, int data_len, char *content)
 			left_8.encoding		= sensor_msgs::image_encodings::MONO8;
 			left_image_pub.publish(left_8.toImageMsg());
 
-	        sensor_msgs::CameraInfo g_cam_info_left;
-            g_cam_info_left.header.stamp = time_in_this_loop;
-            g_cam_info_left.header.frame_id = "guidance";
-
-            read_params_from_yaml_and_fill_cam_info_msg(camera_params_left, g_cam_info_left);
-            cam_info_left_pub.publish(g_cam_info_left);
+            g_cam_info_left_cached.header.stamp = time_in_this_loop;
+            g_cam_info_left_cached.header.frame_id = "guidance";
+            cam_info_left_pub.publish(g_cam_info_left_cached);
+
+            // rectify: one remap into the preallocated output
+            if (g_rectify_ready && left_rect_pub.getNumSubscribers() > 0){
+                cv::remap(g_greyscale_image_left, g_rect_left,
+                          g_rect_map_left_1, g_rect_map_left_2,
+                          cv::INTER_LINEAR);
+                cv_bridge::CvImage left_rect;
+                left_rect.image = g_rect_left;
+                left_rect.header.frame_id = "guidance";
+                left_rect.header.stamp = time_in_this_loop;
+                left_rect.encoding = sensor_msgs::image_encodings::MONO8;
+                left_rect_pub.publish(left_rect.toImageMsg());
+            }
 		}
 		if ( data->m_greyscale_image_right[CAMERA_ID] ){
 			memcpy(g_greyscale_image_right.data, data->m_greyscale_image_right[CAMERA_ID], IMAGE_SIZE);
@@ -183,12 +208,22 @@ int my_callback(int data_type, int data_len, char *content)
 			right_8.encoding  	 = sensor_msgs::image_encodings::MONO8;
 			right_image_pub.publish(right_8.toImageMsg());
 
-            sensor_msgs::CameraInfo g_cam_info_right;
-            g_cam_info_right.header.stamp = time_in_this_loop;
-            g_cam_info_right.header.frame_id = "guidance";
-
-            read_params_from_yaml_and_fill_cam_info_msg(camera_params_right, g_cam_info_right);
-            cam_info_right_pub.publish(g_cam_info_right);
+            g_cam_info_right_cached.header.stamp = time_in_this_loop;
+            g_cam_info_right_cached.header.frame_id = "guidance";
+            cam_info_right_pub.publish(g_cam_info_right_cached);
+
+            // rectify: one remap into the preallocated output
+            if (g_rectify_ready && right_rect_pub.getNumSubscribers() > 0){
+                cv::remap(g_greyscale_image_right, g_rect_right,
+                          g_rect_map_right_1, g_rect_map_right_2,
+                          cv::INTER_LINEAR);
+                cv_bridge::CvImage right_rect;
+                right_rect.image = g_rect_right;
+                right_rect.header.frame_id = "guidance";
+                right_rect.header.stamp = time_in_this_loop;
+                right_rect.encoding = sensor_msgs::image_encodings::MONO8;
+                right_rect_pub.publish(right_rect.toImageMsg());
+            }
 		}
 		if ( data->m_depth_image[CAMERA_ID] ){
 			memcpy(g_depth.data, data->m_depth_image[CAMERA_ID], IMAGE_SIZE * 2);
@@ -297,6 +332,36 @@ int my_callback(int data_type, int data_len, char *content)
 #define RETURN_IF_ERR(err_code) { if( err_code ){ release_transfer(); \
 std::cout<<"Error: "<<(e_sdk_err_code)err_code<<" at "<<__LINE__<<","<<__FILE__<<std::endl; return -1;}}
 
+/* Compute both cameras' rectification maps once from the cached
+ * calibration. */
+static void init_rectification()
+{
+    if (!g_cam_info_ready)
+        return;
+
+    cv::Mat K_left(3, 3, CV_64F, &g_cam_info_left_cached.K[0]);
+    cv::Mat R_left(3, 3, CV_64F, &g_cam_info_left_cached.R[0]);
+    cv::Mat P_left(3, 4, CV_64F, &g_cam_info_left_cached.P[0]);
+    cv::Mat D_left(g_cam_info_left_cached.D, true);
+
+    cv::Mat K_right(3, 3, CV_64F, &g_cam_info_right_cached.K[0]);
+    cv::Mat R_right(3, 3, CV_64F, &g_cam_info_right_cached.R[0]);
+    cv::Mat P_right(3, 4, CV_64F, &g_cam_info_right_cached.P[0]);
+    cv::Mat D_right(g_cam_info_right_cached.D, true);
+
+    const cv::Size size(WIDTH, HEIGHT);
+    cv::initUndistortRectifyMap(K_left, D_left, R_left,
+                                P_left.colRange(0, 3), size, CV_16SC2,
+                                g_rect_map_left_1, g_rect_map_left_2);
+    cv::initUndistortRectifyMap(K_right, D_right, R_right,
+                                P_right.colRange(0, 3), size, CV_16SC2,
+                                g_rect_map_right_1, g_rect_map_right_2);
+
+    g_rect_left.create(HEIGHT, WIDTH, CV_8UC1);
+    g_rect_right.create(HEIGHT, WIDTH, CV_8UC1);
+    g_rectify_ready = true;
+}
+
 int main(int argc, char** argv)
 {
 	if(argc>1){
@@ -314,6 +379,16 @@ int main(int argc, char** argv)
     ros::NodeHandle my_node;
 	my_node.getParam("/left_param_file", camera_params_left);
     my_node.getParam("/right_param_file", camera_params_right);
+
+    // parse the calibration once and build the rectification maps
+    if (!camera_params_left.empty() && !camera_params_right.empty()){
+        read_params_from_yaml_and_fill_cam_info_msg(camera_params_left,
+                                                    g_cam_info_left_cached);
+        read_params_from_yaml_and_fill_cam_info_msg(camera_params_right,
+                                                    g_cam_info_right_cached);
+        g_cam_info_ready = true;
+        init_rectification();
+    }
     depth_image_pub			= my_node.advertise<sensor_msgs::Image>("/guidance/depth_image",1);
     left_image_pub			= my_node.advertise<sensor_msgs::Image>("/guidance/left/image_raw",1);
     right_image_pub			= my_node.advertise<sensor_msgs::Image>("/guidance/right/image_raw",1);
@@ -323,6 +398,8 @@ int main(int argc, char** argv)
     ultrasonic_pub			= my_node.advertise<sensor_msgs::LaserScan>("/guidance/ultrasonic",1);
     cam_info_right_pub      = my_node.advertise<sensor_msgs::CameraInfo>("/guidance/right/camera_info",1);
     cam_info_left_pub       = my_node.advertise<sensor_msgs::CameraInfo>("/guidance/left/camera_info",1);
+    left_rect_pub           = my_node.advertise<sensor_msgs::Image>("/guidance/left/image_rect",1);
+    right_rect_pub          = my_node.advertise<sensor_msgs::Image>("/guidance/right/image_rect",1);
 
     /* initialize guidance */
     reset_config();
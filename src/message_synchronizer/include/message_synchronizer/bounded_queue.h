@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// A bounded handoff queue between pipeline stages.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef BOUNDED_QUEUE_H
+#define BOUNDED_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+// Single message type. Producers drop the oldest entry instead of blocking
+// when the queue is full, so a slow consumer sheds load rather than backing
+// up the sensor callback thread.
+template<typename MessageType>
+class BoundedQueue {
+ public:
+  explicit BoundedQueue() : capacity_(1), stopped_(false) {}
+  ~BoundedQueue() {}
+
+  // Set the maximum number of queued entries. Call before producing.
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  // Add an entry, evicting the oldest one if the queue is full.
+  void Push(const MessageType& msg) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (queue_.size() >= capacity_)
+      queue_.pop_front();
+    queue_.push_back(msg);
+    lock.unlock();
+
+    ready_.notify_one();
+  }
+
+  // Block until an entry arrives or Stop() is called. Returns false once
+  // the queue is stopped and drained.
+  bool Pop(MessageType& msg) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (queue_.empty() && !stopped_)
+      ready_.wait(lock);
+
+    if (queue_.empty())
+      return false;
+
+    msg = queue_.front();
+    queue_.pop_front();
+    return true;
+  }
+
+  // Wake all blocked consumers and refuse further blocking.
+  void Stop() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopped_ = true;
+    }
+    ready_.notify_all();
+  }
+
+ private:
+  std::deque<MessageType> queue_;
+  size_t capacity_;
+  bool stopped_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+};
+
+#endif
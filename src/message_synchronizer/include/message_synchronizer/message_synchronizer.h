@@ -46,57 +46,117 @@
 #include <vector>
 #include <algorithm>
 #include <functional>
+#include <atomic>
+#include <cstddef>
 
-// Single message type.
+// Single message type. The producer side (a sensor callback) feeds a
+// bounded single-producer/single-consumer ring without ever taking a lock
+// or blocking; the consumer side drains the ring into a min-heap keyed on
+// header stamp. When the ring fills up the producer drops the incoming
+// message and counts it, rather than stalling the callback thread.
 template<typename MessageType>
 class MessageSynchronizer {
  public:
   explicit MessageSynchronizer();
   ~MessageSynchronizer();
 
-  // Add message.
-  void AddMessage(const MessageType& msg);
+  // Set ring capacity. Not thread-safe: call before producing.
+  void SetCapacity(size_t capacity);
+
+  // Producer side. Never blocks; returns false (and drops the message)
+  // when the ring is full.
+  bool AddMessage(const MessageType& msg);
+
+  // Consumer side. Drain the ring and return messages in stamp order.
   void GetSorted(std::vector<MessageType>& sorted);
 
+  // Number of messages dropped because the ring was full.
+  size_t DroppedMessages() const;
+
  private:
-  std::vector<MessageType> buffer_;
+  // Bounded SPSC ring, one slot left empty as the full/empty sentinel.
+  // head_ is written only by the producer and tail_ only by the consumer,
+  // so acquire/release on the indices is all the synchronization needed.
+  std::vector<MessageType> ring_;
+  std::atomic<size_t> head_, tail_;
+  std::atomic<size_t> dropped_;
+
+  // Min-heap on header stamp, reused across drains.
+  std::vector<MessageType> heap_;
 };
 
 // ------------------------- IMPLEMENTATION ---------------------------------- //
 
 // Constructor/destructor.
 template<typename MessageType>
-MessageSynchronizer<MessageType>::MessageSynchronizer() {}
+MessageSynchronizer<MessageType>::MessageSynchronizer()
+  : ring_(129), head_(0), tail_(0), dropped_(0) {}
 
 template<typename MessageType>
 MessageSynchronizer<MessageType>::~MessageSynchronizer() {}
 
-// Message callback.
+// Set ring capacity.
 template<typename MessageType>
-void MessageSynchronizer<MessageType>::AddMessage(const MessageType& msg) {
-  buffer_.push_back(msg);
+void MessageSynchronizer<MessageType>::SetCapacity(size_t capacity) {
+  ring_.assign(capacity + 1, MessageType());
+  head_.store(0);
+  tail_.store(0);
 }
 
+// Message callback (producer side).
+template<typename MessageType>
+bool MessageSynchronizer<MessageType>::AddMessage(const MessageType& msg) {
+  const size_t head = head_.load(std::memory_order_relaxed);
+  const size_t next = (head + 1) % ring_.size();
+
+  // Ring full: shed the incoming message instead of blocking.
+  if (next == tail_.load(std::memory_order_acquire)) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  ring_[head] = msg;
+  head_.store(next, std::memory_order_release);
+  return true;
+}
+
+// Min-heap comparator: the earliest stamp sits on top.
 template<typename MessageType>
 struct TimeComparitor {
   bool operator()(const MessageType& msg1, const MessageType& msg2) {
-    return msg1->header.stamp < msg2->header.stamp;
+    return msg1->header.stamp > msg2->header.stamp;
   }
 };
 
-// Timer callback.
+// Timer callback (consumer side).
 template<typename MessageType>
 void MessageSynchronizer<MessageType>::GetSorted(std::vector<MessageType>& sorted) {
-  // Sort buffer_ by timestamps.
-  std::sort(buffer_.begin(), buffer_.end(), TimeComparitor<MessageType>());
+  // Drain the ring into the heap.
+  size_t tail = tail_.load(std::memory_order_relaxed);
+  const size_t head = head_.load(std::memory_order_acquire);
+  while (tail != head) {
+    heap_.push_back(ring_[tail]);
+    std::push_heap(heap_.begin(), heap_.end(), TimeComparitor<MessageType>());
+
+    // Release the slot's reference before handing it back to the producer.
+    ring_[tail] = MessageType();
+    tail = (tail + 1) % ring_.size();
+  }
+  tail_.store(tail, std::memory_order_release);
 
-  // Copy into a new vector.
+  // Pop in ascending stamp order.
   sorted.clear();
-  for (size_t ii = 0; ii < buffer_.size(); ii++)
-    sorted.push_back(buffer_[ii]);
+  while (!heap_.empty()) {
+    std::pop_heap(heap_.begin(), heap_.end(), TimeComparitor<MessageType>());
+    sorted.push_back(heap_.back());
+    heap_.pop_back();
+  }
+}
 
-  // Clear buffer_.
-  buffer_.clear();
+// Drop count.
+template<typename MessageType>
+size_t MessageSynchronizer<MessageType>::DroppedMessages() const {
+  return dropped_.load(std::memory_order_relaxed);
 }
 
 #endif
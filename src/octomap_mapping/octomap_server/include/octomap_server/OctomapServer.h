@@ -34,6 +34,7 @@
 #include <visualization_msgs/MarkerArray.h>
 #include <nav_msgs/OccupancyGrid.h>
 #include <std_msgs/ColorRGBA.h>
+#include <std_msgs/UInt64MultiArray.h>
 
 // #include <moveit_msgs/CollisionObject.h>
 // #include <moveit_msgs/CollisionMap.h>
@@ -62,10 +63,18 @@
 #include <octomap_msgs/BoundingBoxQuery.h>
 #include <octomap_msgs/conversions.h>
 
+#include <utils/timing/trace.h>
 #include <octomap_ros/conversions.h>
 #include <octomap/octomap.h>
 #include <octomap/OcTreeKey.h>
 
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+
 //#define COLOR_OCTOMAP_SERVER // turned off here, turned on identical ColorOctomapServer.h - easier maintenance, only maintain OctomapServer and then copy and paste to ColorOctomapServer and change define. There are prettier ways to do this, but this works for now
 
 #ifdef COLOR_OCTOMAP_SERVER
@@ -98,6 +107,17 @@ public:
   virtual void insertCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud);
   virtual bool openFile(const std::string& filename);
 
+  /**
+  * @brief filter, transform and insert one cloud. With decimate set (load
+  * shedding under overload), only every Nth point is integrated.
+  */
+  void processCloud(const sensor_msgs::PointCloud2::ConstPtr& cloud,
+                    bool decimate);
+
+  /// worker loop behind the load-shedding mailbox: always processes only
+  /// the newest pending cloud
+  void insertionThread();
+
 protected:
   inline static void updateMinKey(const octomap::OcTreeKey& in, octomap::OcTreeKey& min) {
     for (unsigned i = 0; i < 3; ++i)
@@ -123,8 +143,312 @@ protected:
   void reconfigureCallback(octomap_server::OctomapServerConfig& config, uint32_t level);
   void publishBinaryOctoMap(const ros::Time& rostime = ros::Time::now()) const;
   void publishFullOctoMap(const ros::Time& rostime = ros::Time::now()) const;
+
+  /**
+  * @brief build and publish depth-truncated maps for planning consumers
+  * (octomap_binary_coarse / octomap_full_coarse). The coarse tree is
+  * reconstructed from a depth-limited leaf iteration, so coarse
+  * subscribers get 8-64x smaller messages and proportionally cheaper
+  * deserialization.
+  */
+  void publishCoarseMaps(const ros::Time& rostime);
   virtual void publishAll(const ros::Time& rostime = ros::Time::now());
 
+  /**
+  * @brief the traversal engine behind publishAll. ServerT is the concrete
+  * server type: when a derived server routes through this with itself as
+  * ServerT (see OctomapServerT below), the per-node handler calls bind at
+  * compile time and inline into the loop instead of dispatching virtually
+  * per node. The virtual publishAll path remains for plugins.
+  */
+  template <class ServerT>
+  void doPublishAll(const ros::Time& rostime){
+  ros::WallTime startTime = ros::WallTime::now();
+  size_t octomapSize = m_octree->size();
+  // TODO: estimate num occ. voxels for size of arrays (reserve)
+  if (octomapSize <= 1){
+    ROS_WARN("Nothing to publish, octree is empty");
+    return;
+  }
+
+  // One leaf pass builds the index every speckle query below consults.
+  if (m_filterSpeckles)
+    buildSpeckleIndex();
+
+  bool publishFreeMarkerArray = m_publishFreeSpace && (m_latchedTopics || m_fmarkerPub.getNumSubscribers() > 0);
+  bool publishMarkerArray = (m_latchedTopics || m_markerPub.getNumSubscribers() > 0);
+  bool publishPointCloud = (m_latchedTopics || m_pointCloudPub.getNumSubscribers() > 0);
+  bool publishBinaryMap = (m_latchedTopics || m_binaryMapPub.getNumSubscribers() > 0);
+  bool publishFullMap = (m_latchedTopics || m_fullMapPub.getNumSubscribers() > 0);
+  m_publish2DMap = (m_latchedTopics || m_mapPub.getNumSubscribers() > 0);
+
+  // Per-product throttling: expensive products can run slower than the
+  // scan rate (e.g. the full map at 0.2 Hz) without touching the rest.
+  publishMarkerArray = publishMarkerArray
+    && dueToPublish(m_markerRate, m_lastMarkerPub, rostime);
+  publishPointCloud = publishPointCloud
+    && dueToPublish(m_pointCloudRate, m_lastPointCloudPub, rostime);
+  publishBinaryMap = publishBinaryMap
+    && dueToPublish(m_binaryMapRate, m_lastBinaryMapPub, rostime);
+  publishFullMap = publishFullMap
+    && dueToPublish(m_fullMapRate, m_lastFullMapPub, rostime);
+  // The incremental 2D projection folds in only each scan's BBX, so
+  // skipping scans would lose updates: throttle it only when projecting
+  // the complete map.
+  if (!m_incrementalUpdate)
+    m_publish2DMap = m_publish2DMap
+      && dueToPublish(m_projectedMapRate, m_lastProjectedMapPub, rostime);
+
+  // Depth-truncated maps for planning consumers, independent of the
+  // full-resolution traversal below.
+  if (m_coarseMapDepth > 0
+      && (m_latchedTopics || m_binaryMapCoarsePub.getNumSubscribers() > 0
+          || m_fullMapCoarsePub.getNumSubscribers() > 0)
+      && dueToPublish(m_coarseMapRate, m_lastCoarseMapPub, rostime))
+    publishCoarseMaps(rostime);
+
+  // Nothing left that needs walking the tree: the serialized maps are
+  // generated straight from the tree structure.
+  if (!publishMarkerArray && !publishFreeMarkerArray && !publishPointCloud
+      && !m_publish2DMap){
+    if (publishBinaryMap)
+      publishBinaryOctoMap(rostime);
+    if (publishFullMap)
+      publishFullOctoMap(rostime);
+    return;
+  }
+
+  // Incremental visualization: only voxels inside the changed BBX are
+  // regenerated, and markers / the center cloud come out of the persistent
+  // store instead of a full-tree walk. The full traversal below then only
+  // runs when the 2D projection or free-space markers still need it.
+  if (m_incrementalVis){
+    updateVisStore();
+
+    if (publishMarkerArray){
+      publishMarkersFromStore(rostime);
+      publishMarkerArray = false;
+    }
+    if (publishPointCloud){
+      publishCloudFromStore(rostime);
+      publishPointCloud = false;
+    }
+
+    if (!m_publish2DMap && !publishFreeMarkerArray){
+      if (publishBinaryMap)
+        publishBinaryOctoMap(rostime);
+      if (publishFullMap)
+        publishFullOctoMap(rostime);
+
+      double incr_elapsed = (ros::WallTime::now() - startTime).toSec();
+      ROS_DEBUG("Incremental map publishing in OctomapServer took %f sec", incr_elapsed);
+      return;
+    }
+  }
+
+  // init markers for free space:
+  visualization_msgs::MarkerArray freeNodesVis;
+  // each array stores all cubes of a different size, one for each depth level:
+  freeNodesVis.markers.resize(m_treeDepth+1);
+
+  geometry_msgs::Pose pose;
+  pose.orientation = tf::createQuaternionMsgFromYaw(0.0);
+
+  // init markers:
+  visualization_msgs::MarkerArray occupiedNodesVis;
+  // each array stores all cubes of a different size, one for each depth level:
+  occupiedNodesVis.markers.resize(m_treeDepth+1);
+
+  // init pointcloud:
+  pcl::PointCloud<PCLPoint> pclCloud;
+
+  // call pre-traversal hook:
+  static_cast<ServerT*>(this)->handlePreNodeTraversal(rostime);
+
+  // now, traverse all leafs in the tree:
+  for (OcTreeT::iterator it = m_octree->begin(m_maxTreeDepth),
+      end = m_octree->end(); it != end; ++it)
+  {
+    bool inUpdateBBX = isInUpdateBBX(it);
+
+    // call general hook:
+    static_cast<ServerT*>(this)->handleNode(it);
+    if (inUpdateBBX)
+      static_cast<ServerT*>(this)->handleNodeInBBX(it);
+
+    if (m_octree->isNodeOccupied(*it)){
+      double z = it.getZ();
+      if (z > m_occupancyMinZ && z < m_occupancyMaxZ)
+      {
+        double size = it.getSize();
+        double x = it.getX();
+        double y = it.getY();
+#ifdef COLOR_OCTOMAP_SERVER
+        int r = it->getColor().r;
+        int g = it->getColor().g;
+        int b = it->getColor().b;
+#endif
+
+        // Ignore speckles in the map:
+        if (m_filterSpeckles && (it.getDepth() == m_treeDepth) && isSpeckleNode(it.getKey())){
+          ROS_DEBUG("Ignoring single speckle at (%f,%f,%f)", x, y, z);
+          continue;
+        } // else: current octree node is no speckle, send it out
+
+        static_cast<ServerT*>(this)->handleOccupiedNode(it);
+        if (inUpdateBBX)
+          static_cast<ServerT*>(this)->handleOccupiedNodeInBBX(it);
+
+
+        //create marker:
+        if (publishMarkerArray){
+          unsigned idx = it.getDepth();
+          assert(idx < occupiedNodesVis.markers.size());
+
+          geometry_msgs::Point cubeCenter;
+          cubeCenter.x = x;
+          cubeCenter.y = y;
+          cubeCenter.z = z;
+
+          occupiedNodesVis.markers[idx].points.push_back(cubeCenter);
+          if (m_useHeightMap){
+            double minX, minY, minZ, maxX, maxY, maxZ;
+            m_octree->getMetricMin(minX, minY, minZ);
+            m_octree->getMetricMax(maxX, maxY, maxZ);
+
+            double h = (1.0 - std::min(std::max((cubeCenter.z-minZ)/ (maxZ - minZ), 0.0), 1.0)) *m_colorFactor;
+            occupiedNodesVis.markers[idx].colors.push_back(heightMapColor(h));
+          }
+
+#ifdef COLOR_OCTOMAP_SERVER
+          if (m_useColoredMap) {
+            std_msgs::ColorRGBA _color; _color.r = (r / 255.); _color.g = (g / 255.); _color.b = (b / 255.); _color.a = 1.0; // TODO/EVALUATE: potentially use occupancy as measure for alpha channel?
+            occupiedNodesVis.markers[idx].colors.push_back(_color);
+          }
+#endif
+        }
+
+        // insert into pointcloud:
+        if (publishPointCloud) {
+#ifdef COLOR_OCTOMAP_SERVER
+          PCLPoint _point = PCLPoint();
+          _point.x = x; _point.y = y; _point.z = z;
+          _point.r = r; _point.g = g; _point.b = b;
+          pclCloud.push_back(_point);
+#else
+          pclCloud.push_back(PCLPoint(x, y, z));
+#endif
+        }
+
+      }
+    } else{ // node not occupied => mark as free in 2D map if unknown so far
+      double z = it.getZ();
+      if (z > m_occupancyMinZ && z < m_occupancyMaxZ)
+      {
+        static_cast<ServerT*>(this)->handleFreeNode(it);
+        if (inUpdateBBX)
+          static_cast<ServerT*>(this)->handleFreeNodeInBBX(it);
+
+        if (m_publishFreeSpace){
+          double x = it.getX();
+          double y = it.getY();
+
+          //create marker for free space:
+          if (publishFreeMarkerArray){
+            unsigned idx = it.getDepth();
+            assert(idx < freeNodesVis.markers.size());
+
+            geometry_msgs::Point cubeCenter;
+            cubeCenter.x = x;
+            cubeCenter.y = y;
+            cubeCenter.z = z;
+
+            freeNodesVis.markers[idx].points.push_back(cubeCenter);
+          }
+        }
+
+      }
+    }
+  }
+
+  // call post-traversal hook:
+  static_cast<ServerT*>(this)->handlePostNodeTraversal(rostime);
+
+  // finish MarkerArray:
+  if (publishMarkerArray){
+    for (unsigned i= 0; i < occupiedNodesVis.markers.size(); ++i){
+      double size = m_octree->getNodeSize(i);
+
+      occupiedNodesVis.markers[i].header.frame_id = m_worldFrameId;
+      occupiedNodesVis.markers[i].header.stamp = rostime;
+      occupiedNodesVis.markers[i].ns = "map";
+      occupiedNodesVis.markers[i].id = i;
+      occupiedNodesVis.markers[i].type = visualization_msgs::Marker::CUBE_LIST;
+      occupiedNodesVis.markers[i].scale.x = size;
+      occupiedNodesVis.markers[i].scale.y = size;
+      occupiedNodesVis.markers[i].scale.z = size;
+      if (!m_useColoredMap)
+        occupiedNodesVis.markers[i].color = m_color;
+
+
+      if (occupiedNodesVis.markers[i].points.size() > 0)
+        occupiedNodesVis.markers[i].action = visualization_msgs::Marker::ADD;
+      else
+        occupiedNodesVis.markers[i].action = visualization_msgs::Marker::DELETE;
+    }
+
+    m_markerPub.publish(occupiedNodesVis);
+  }
+
+
+  // finish FreeMarkerArray:
+  if (publishFreeMarkerArray){
+    for (unsigned i= 0; i < freeNodesVis.markers.size(); ++i){
+      double size = m_octree->getNodeSize(i);
+
+      freeNodesVis.markers[i].header.frame_id = m_worldFrameId;
+      freeNodesVis.markers[i].header.stamp = rostime;
+      freeNodesVis.markers[i].ns = "map";
+      freeNodesVis.markers[i].id = i;
+      freeNodesVis.markers[i].type = visualization_msgs::Marker::CUBE_LIST;
+      freeNodesVis.markers[i].scale.x = size;
+      freeNodesVis.markers[i].scale.y = size;
+      freeNodesVis.markers[i].scale.z = size;
+      freeNodesVis.markers[i].color = m_colorFree;
+
+
+      if (freeNodesVis.markers[i].points.size() > 0)
+        freeNodesVis.markers[i].action = visualization_msgs::Marker::ADD;
+      else
+        freeNodesVis.markers[i].action = visualization_msgs::Marker::DELETE;
+    }
+
+    m_fmarkerPub.publish(freeNodesVis);
+  }
+
+
+  // finish pointcloud:
+  if (publishPointCloud){
+    sensor_msgs::PointCloud2 cloud;
+    pcl::toROSMsg (pclCloud, cloud);
+    cloud.header.frame_id = m_worldFrameId;
+    cloud.header.stamp = rostime;
+    m_pointCloudPub.publish(cloud);
+  }
+
+  if (publishBinaryMap)
+    publishBinaryOctoMap(rostime);
+
+  if (publishFullMap)
+    publishFullOctoMap(rostime);
+
+
+  double total_elapsed = (ros::WallTime::now() - startTime).toSec();
+  ROS_DEBUG("Map publishing in OctomapServer took %f sec", total_elapsed);
+
+  }
+
+
   /**
   * @brief update occupancy map with a scan labeled as ground and nonground.
   * The scans should be in the global map frame.
@@ -135,9 +459,67 @@ protected:
   */
   virtual void insertScan(const tf::Point& sensorOrigin, const PCLPointCloud& ground, const PCLPointCloud& nonground);
 
+  /**
+  * @brief compute the free/occupied cell updates for a range of cloud points.
+  * Reads only immutable tree geometry, so ranges can run on worker threads in
+  * parallel; each worker owns its KeyRay buffer and output sets, which are
+  * merged before the (deterministic, single-threaded) tree update.
+  */
+  void computeRaysRange(const PCLPointCloud& cloud,
+                        const octomap::point3d& sensorOrigin, bool clearOnly,
+                        size_t begin, size_t end, octomap::KeySet* freeCells,
+                        octomap::KeySet* occupiedCells,
+                        octomap::OcTreeKey* bbxMin,
+                        octomap::OcTreeKey* bbxMax) const;
+
+  /**
+  * @brief propagate deferred (lazy_eval) occupancy to inner nodes, but only
+  * along the paths touched by this scan's cells. Ancestors are deduplicated
+  * per depth, so the work shrinks geometrically toward the root instead of
+  * paying for a full-tree updateInnerOccupancy().
+  */
+  void propagateNodes(const octomap::KeySet& freeCells,
+                      const octomap::KeySet& occupiedCells);
+
   /// label the input cloud "pc" into ground and nonground. Should be in the robot's fixed frame (not world!)
   void filterGroundPlane(const PCLPointCloud& pc, PCLPointCloud& ground, PCLPointCloud& nonground) const;
 
+  /**
+  * @brief cheap ground segmentation against the persisted plane estimate
+  * from the last RANSAC fit. The plane is validated against the scan's
+  * per-cell lowest points first; returns false when the residuals say the
+  * ground moved, in which case the caller re-runs RANSAC.
+  */
+  bool segmentGroundFast(const PCLPointCloud& pc, PCLPointCloud& ground,
+                         PCLPointCloud& nonground) const;
+
+  /**
+  * @brief apply the x/y/z range limits and NaN rejection in one pass, in
+  * place. Replaces the chain of three PassThrough filters, each of which
+  * deep-copied the cloud via makeShared(); survivors are compacted through
+  * a buffer reused across scans.
+  */
+  void filterPointCloud(PCLPointCloud& pc);
+
+  /**
+  * @brief refresh the persistent occupied-voxel store from the current
+  * update bounding box only: entries inside the (node-size padded) BBX are
+  * dropped and regenerated from a bbx-limited leaf traversal, so publishing
+  * never needs a full-tree walk. Walking the store itself is a linear
+  * memory scan, far cheaper than chasing tree pointers.
+  */
+  void updateVisStore();
+
+  /// rebuild and publish the occupied marker array from the store
+  void publishMarkersFromStore(const ros::Time& rostime);
+
+  /// rebuild and publish the center point cloud from the store
+  void publishCloudFromStore(const ros::Time& rostime);
+
+  /// rate-limit one publish product; a non-positive rate publishes on
+  /// every map update
+  bool dueToPublish(double rate, ros::Time& lastPub, const ros::Time& now);
+
   /**
   * @brief Find speckle nodes (single occupied voxels with no neighbors). Only works on lowest resolution!
   * @param key
@@ -145,6 +527,15 @@ protected:
   */
   bool isSpeckleNode(const octomap::OcTreeKey& key) const;
 
+  /**
+  * @brief build the occupied-key index the speckle filter consults: one
+  * leaf pass per publish, after which each candidate's 26-neighborhood
+  * resolves with hash lookups instead of 26 independent tree descents.
+  * Small coarse occupied leaves expand into their finest keys; large ones
+  * are kept as key ranges and tested by containment.
+  */
+  void buildSpeckleIndex() const;
+
   /// hook that is called before traversing all nodes
   virtual void handlePreNodeTraversal(const ros::Time& rostime);
 
@@ -207,7 +598,35 @@ protected:
   dynamic_reconfigure::Server<OctomapServerConfig> m_reconfigureServer;
 
   OcTreeT* m_octree;
+
+  // Serializes tree mutation (scan insertion, clearing) against the map
+  // services' snapshot phase: the services copy the tree under this lock
+  // and serialize from the copy, so a multithreaded spinner keeps
+  // inserting while a snapshot is written out.
+  std::mutex m_treeMutex;
+
   octomap::KeyRay m_keyRay;  // temp storage for ray casting
+  PCLPointCloud m_filteredCloud; // reused scratch for single-pass filtering
+
+  // persistent per-depth occupied-voxel store (key -> center) backing the
+  // incremental visualization path:
+  typedef std::unordered_map<octomap::OcTreeKey, geometry_msgs::Point,
+                             octomap::OcTreeKey::KeyHash> VisStore;
+  std::vector<VisStore> m_occupiedVisStore;
+  bool m_incrementalVis;
+
+  // per-product publish rates (Hz; 0 publishes on every map update):
+  double m_markerRate, m_pointCloudRate, m_binaryMapRate, m_fullMapRate,
+    m_projectedMapRate, m_coarseMapRate;
+  ros::Time m_lastMarkerPub, m_lastPointCloudPub, m_lastBinaryMapPub,
+    m_lastFullMapPub, m_lastProjectedMapPub, m_lastCoarseMapPub;
+
+  // depth-truncated map topic for planning consumers (0 disables):
+  int m_coarseMapDepth;
+  ros::Publisher m_binaryMapCoarsePub, m_fullMapCoarsePub;
+
+  // cross-node trace sidecar:
+  timing::TraceEmitter m_trace;
   octomap::OcTreeKey m_updateBBXMin;
   octomap::OcTreeKey m_updateBBXMax;
 
@@ -243,7 +662,35 @@ protected:
   double m_groundFilterAngle;
   double m_groundFilterPlaneDistance;
 
+  // fast ground segmentation: warm-started plane cache
+  bool m_fastGroundFilter;
+  mutable bool m_groundPlaneValid;
+  mutable float m_groundCoeffs[4];
+
+  // per-publish occupied-key index backing the speckle filter
+  mutable octomap::KeySet m_speckleKeys;
+  mutable std::vector< std::pair<octomap::OcTreeKey, octomap::OcTreeKey> >
+    m_speckleCoarse;
+  mutable bool m_speckleIndexValid;
+
   bool m_compressMap;
+  bool m_lazyEval;
+
+  int m_numRayThreads;
+
+  // Load shedding: a latest-wins mailbox bounds staleness instead of
+  // letting the subscriber queue grow, decimating points when scans were
+  // dropped since the last insertion.
+  bool m_loadShedding;
+  int m_overloadDecimation;
+  std::mutex m_mailboxMutex;
+  std::condition_variable m_mailboxReady;
+  sensor_msgs::PointCloud2::ConstPtr m_pendingCloud;
+  bool m_cloudPending;
+  bool m_insertionRunning;
+  std::thread m_insertionThread;
+  uint64_t m_droppedScans, m_decimatedScans, m_lastDroppedCount;
+  ros::Publisher m_overloadPub;
 
   // downprojected 2D map:
   bool m_incrementalUpdate;
@@ -255,6 +702,28 @@ protected:
   bool m_projectCompleteMap;
   bool m_useColoredMap;
 };
+
+/**
+ * CRTP variant: derive a concrete server from OctomapServerT<Derived>,
+ * declaring any overridden handle* hooks public (the base traversal
+ * engine cannot reach a derived class's protected members) and final (so
+ * the calls bind statically). publishAll then routes the traversal
+ * through doPublishAll<Derived> and the per-node handlers inline into
+ * the loop -- see OctomapServerMultilayer for the in-tree user. Servers
+ * that need runtime polymorphism (e.g. TrackingOctomapServer) keep
+ * deriving from OctomapServer directly.
+ */
+template <class Derived>
+class OctomapServerT : public OctomapServer {
+public:
+  OctomapServerT(ros::NodeHandle private_nh = ros::NodeHandle("~"))
+    : OctomapServer(private_nh) {}
+
+protected:
+  virtual void publishAll(const ros::Time& rostime = ros::Time::now()){
+    doPublishAll<Derived>(rostime);
+  }
+};
 }
 
 #endif
@@ -32,12 +32,28 @@
 #include <octomap_server/OctomapServer.h>
 
 namespace octomap_server {
-class OctomapServerMultilayer : public OctomapServer{
+// Derives through OctomapServerT so publishAll routes the traversal
+// through doPublishAll<OctomapServerMultilayer>: the per-node hooks below
+// are final, so their calls bind statically and inline into the loop
+// instead of dispatching virtually per node.
+class OctomapServerMultilayer
+  : public OctomapServerT<OctomapServerMultilayer>{
 
 public:
   OctomapServerMultilayer(ros::NodeHandle private_nh_ = ros::NodeHandle("~"));
   virtual ~OctomapServerMultilayer();
 
+  // Traversal hooks. Public so the base traversal engine may call them
+  // through a Derived pointer (a base member cannot reach a derived
+  // class's protected members), and final so the compiler may bind them
+  // at the template call sites.
+
+  /// hook that is called before traversing all nodes
+  virtual void handlePreNodeTraversal(const ros::Time& rostime) final;
+
+  /// hook that is called after traversing all nodes
+  virtual void handlePostNodeTraversal(const ros::Time& rostime) final;
+
 protected:
   struct ProjectedMap{
     double minZ;
@@ -48,14 +64,26 @@ protected:
   };
   typedef std::vector<ProjectedMap> MultilevelGrid;
 
-  /// hook that is called after traversing all nodes
-  virtual void handlePreNodeTraversal(const ros::Time& rostime);
-
   /// updates the downprojected 2D map as either occupied or free
-  virtual void update2DMap(const OcTreeT::iterator& it, bool occupied);
+  virtual void update2DMap(const OcTreeT::iterator& it, bool occupied) final;
 
-  /// hook that is called after traversing all nodes
-  virtual void handlePostNodeTraversal(const ros::Time& rostime);
+  /// write one projected cell into the base map and every masked layer
+  inline void projectCell(unsigned idx, bool occupied){
+    if (occupied)
+      m_gridmap.data[idx] = 100;
+    else if (m_gridmap.data[idx] == -1)
+      m_gridmap.data[idx] = 0;
+
+    for (unsigned i = 0; i < m_inMapLevel.size(); ++i){
+      if (!m_inMapLevel[i])
+        continue;
+
+      if (occupied)
+        m_multiGridmap[i].map.data[idx] = 100;
+      else if (m_multiGridmap[i].map.data[idx] == -1)
+        m_multiGridmap[i].map.data[idx] = 0;
+    }
+  }
 
   std::vector<ros::Publisher*> m_multiMapPub;
   ros::Subscriber m_attachedObjectsSub;
@@ -65,6 +93,9 @@ protected:
 
   MultilevelGrid m_multiGridmap;
 
+  /// which layers the node being projected spans; reused across calls so
+  /// the per-node hot path does not allocate
+  std::vector<char> m_inMapLevel;
 
 };
 }
@@ -31,6 +31,7 @@
 #define OCTOMAP_SERVER_TRACKINGOCTOMAPSERVER_H_
 
 #include "octomap_server/OctomapServer.h"
+#include <std_msgs/UInt8MultiArray.h>
 
 namespace octomap_server {
 
@@ -40,13 +41,25 @@ public:
   virtual ~TrackingOctomapServer();
 
   void trackCallback(sensor_msgs::PointCloud2Ptr cloud);
+
+  /** Decode a compact (sorted, varint key-delta) change stream straight
+   * into updateNode calls, without an intermediate point cloud. */
+  void trackCompactCallback(std_msgs::UInt8MultiArrayConstPtr msg);
+
   void insertScan(const tf::Point& sensorOrigin, const PCLPointCloud& ground, const PCLPointCloud& nonground);
 
 protected:
   void trackChanges();
 
+  /** Publish the changed keys as a varint-packed delta stream: keys are
+   * sorted, each component encoded as a zigzag varint difference from the
+   * previous key, with one occupancy byte per cell. Bursts compress to a
+   * few bytes per cell instead of a 16-byte PointCloud2 entry. */
+  void trackChangesCompact();
+
   bool listen_changes;
   bool track_changes;
+  bool compact_changes;
   int min_change_pub;
   std::string change_id_frame;
   ros::Publisher pubFreeChangeSet;
@@ -39,6 +39,7 @@ OctomapServer::OctomapServer(ros::NodeHandle private_nh_)
   m_pointCloudSub(NULL),
   m_tfPointCloudSub(NULL),
   m_octree(NULL),
+  m_incrementalVis(false),
   m_maxRange(-1.0),
   m_worldFrameId("/map"), m_baseFrameId("base_footprint"),
   m_useHeightMap(true),
@@ -60,7 +61,18 @@ OctomapServer::OctomapServer(ros::NodeHandle private_nh_)
   m_minSizeX(0.0), m_minSizeY(0.0),
   m_filterSpeckles(false), m_filterGroundPlane(false),
   m_groundFilterDistance(0.04), m_groundFilterAngle(0.15), m_groundFilterPlaneDistance(0.07),
+  m_fastGroundFilter(false), m_groundPlaneValid(false),
+  m_speckleIndexValid(false),
   m_compressMap(true),
+  m_lazyEval(false),
+  m_numRayThreads(4),
+  m_loadShedding(false),
+  m_overloadDecimation(2),
+  m_cloudPending(false),
+  m_insertionRunning(false),
+  m_droppedScans(0),
+  m_decimatedScans(0),
+  m_lastDroppedCount(0),
   m_incrementalUpdate(false)
 {
   double probHit, probMiss, thresMin, thresMax;
@@ -91,8 +103,10 @@ OctomapServer::OctomapServer(ros::NodeHandle private_nh_)
   private_nh.param("ground_filter/angle", m_groundFilterAngle, m_groundFilterAngle);
   // distance of found plane from z=0 to be detected as ground (e.g. to exclude tables)
   private_nh.param("ground_filter/plane_distance", m_groundFilterPlaneDistance, m_groundFilterPlaneDistance);
+  private_nh.param("ground_filter/fast", m_fastGroundFilter, m_fastGroundFilter);
 
   private_nh.param("sensor_model/max_range", m_maxRange, m_maxRange);
+  private_nh.param("ray_threads", m_numRayThreads, m_numRayThreads);
 
   private_nh.param("resolution", m_res, m_res);
   private_nh.param("sensor_model/hit", probHit, 0.7);
@@ -100,7 +114,20 @@ OctomapServer::OctomapServer(ros::NodeHandle private_nh_)
   private_nh.param("sensor_model/min", thresMin, 0.12);
   private_nh.param("sensor_model/max", thresMax, 0.97);
   private_nh.param("compress_map", m_compressMap, m_compressMap);
+  private_nh.param("lazy_eval", m_lazyEval, m_lazyEval);
+  private_nh.param("overload/load_shedding", m_loadShedding, m_loadShedding);
+  private_nh.param("overload/decimation", m_overloadDecimation, m_overloadDecimation);
   private_nh.param("incremental_2D_projection", m_incrementalUpdate, m_incrementalUpdate);
+  private_nh.param("incremental_vis", m_incrementalVis, m_incrementalVis);
+
+  // per-product publish rate limits (Hz), 0 = publish on every update:
+  private_nh.param("publish_rates/markers", m_markerRate, 0.0);
+  private_nh.param("publish_rates/point_cloud", m_pointCloudRate, 0.0);
+  private_nh.param("publish_rates/binary_map", m_binaryMapRate, 0.0);
+  private_nh.param("publish_rates/full_map", m_fullMapRate, 0.0);
+  private_nh.param("publish_rates/projected_map", m_projectedMapRate, 0.0);
+  private_nh.param("publish_rates/coarse_map", m_coarseMapRate, 0.0);
+  private_nh.param("coarse_map_depth", m_coarseMapDepth, 0);
 
   if (m_filterGroundPlane && (m_pointcloudMinZ > 0.0 || m_pointcloudMaxZ < 0.0)){
     ROS_WARN_STREAM("You enabled ground filtering but incoming pointclouds will be pre-filtered in ["
@@ -165,6 +192,10 @@ OctomapServer::OctomapServer(ros::NodeHandle private_nh_)
   m_pointCloudPub = m_nh.advertise<sensor_msgs::PointCloud2>("octomap_point_cloud_centers", 1, m_latchedTopics);
   m_mapPub = m_nh.advertise<nav_msgs::OccupancyGrid>("projected_map", 5, m_latchedTopics);
   m_fmarkerPub = m_nh.advertise<visualization_msgs::MarkerArray>("free_cells_vis_array", 1, m_latchedTopics);
+  m_overloadPub = m_nh.advertise<std_msgs::UInt64MultiArray>("overload_stats", 1, false);
+  m_binaryMapCoarsePub = m_nh.advertise<Octomap>("octomap_binary_coarse", 1, m_latchedTopics);
+  m_fullMapCoarsePub = m_nh.advertise<Octomap>("octomap_full_coarse", 1, m_latchedTopics);
+  m_trace.Advertise(m_nh);
 
   m_pointCloudSub = new message_filters::Subscriber<sensor_msgs::PointCloud2> (m_nh, "cloud_in", 5);
   m_tfPointCloudSub = new tf::MessageFilter<sensor_msgs::PointCloud2> (*m_pointCloudSub, m_tfListener, m_worldFrameId, 5);
@@ -179,9 +210,23 @@ OctomapServer::OctomapServer(ros::NodeHandle private_nh_)
 
   f = boost::bind(&OctomapServer::reconfigureCallback, this, _1, _2);
   m_reconfigureServer.setCallback(f);
+
+  if (m_loadShedding){
+    m_insertionRunning = true;
+    m_insertionThread = std::thread(&OctomapServer::insertionThread, this);
+  }
 }
 
 OctomapServer::~OctomapServer(){
+  // unblock and join the load-shedding worker:
+  {
+    std::lock_guard<std::mutex> lock(m_mailboxMutex);
+    m_insertionRunning = false;
+  }
+  m_mailboxReady.notify_all();
+  if (m_insertionThread.joinable())
+    m_insertionThread.join();
+
   if (m_tfPointCloudSub){
     delete m_tfPointCloudSub;
     m_tfPointCloudSub = NULL;
@@ -254,7 +299,67 @@ bool OctomapServer::openFile(const std::string& filename){
 }
 
 void OctomapServer::insertCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud){
+  // Load shedding: deposit the newest cloud in the mailbox. If the worker
+  // has not consumed the previous one it is obsolete and is dropped,
+  // bounding staleness instead of queue length.
+  if (m_loadShedding){
+    {
+      std::lock_guard<std::mutex> lock(m_mailboxMutex);
+      if (m_cloudPending)
+        m_droppedScans++;
+      m_pendingCloud = cloud;
+      m_cloudPending = true;
+    }
+    m_mailboxReady.notify_one();
+    return;
+  }
+
+  processCloud(cloud, false);
+}
+
+// Worker behind the load-shedding mailbox.
+void OctomapServer::insertionThread(){
+  while (true){
+    sensor_msgs::PointCloud2::ConstPtr cloud;
+    uint64_t droppedBefore;
+    {
+      std::unique_lock<std::mutex> lock(m_mailboxMutex);
+      while (!m_cloudPending && m_insertionRunning)
+        m_mailboxReady.wait(lock);
+
+      if (!m_insertionRunning)
+        return;
+
+      cloud = m_pendingCloud;
+      m_pendingCloud.reset();
+      m_cloudPending = false;
+      droppedBefore = m_droppedScans;
+    }
+
+    // Decimate whenever we had to drop a scan to catch up.
+    const bool overloaded = (droppedBefore != m_lastDroppedCount);
+    m_lastDroppedCount = droppedBefore;
+    if (overloaded)
+      m_decimatedScans++;
+
+    processCloud(cloud, overloaded && m_overloadDecimation > 1);
+
+    // Publish shedding counters for monitoring.
+    if (m_overloadPub.getNumSubscribers() > 0){
+      std_msgs::UInt64MultiArray stats;
+      stats.data.push_back(droppedBefore);
+      stats.data.push_back(m_decimatedScans);
+      m_overloadPub.publish(stats);
+    }
+  }
+}
+
+void OctomapServer::processCloud(const sensor_msgs::PointCloud2::ConstPtr& cloud, bool decimate){
   ros::WallTime startTime = ros::WallTime::now();
+  std::lock_guard<std::mutex> lock(m_treeMutex);
+
+  // The scan stamp correlates this record with the rest of the pipeline.
+  m_trace.Emit(cloud->header.stamp.toNSec(), "octomap_server/insert");
 
 
   //
@@ -263,6 +368,16 @@ void OctomapServer::insertCloudCallback(const sensor_msgs::PointCloud2::ConstPtr
   PCLPointCloud pc; // input cloud for filtering and ground-detection
   pcl::fromROSMsg(*cloud, pc);
 
+  // Under overload, integrate only every Nth point.
+  if (decimate){
+    size_t kept = 0;
+    for (size_t i = 0; i < pc.size(); i += m_overloadDecimation)
+      pc.points[kept++] = pc.points[i];
+    pc.points.resize(kept);
+    pc.width = static_cast<uint32_t>(kept);
+    pc.height = 1;
+  }
+
   tf::StampedTransform sensorToWorldTf;
   try {
     m_tfListener.lookupTransform(m_worldFrameId, cloud->header.frame_id, cloud->header.stamp, sensorToWorldTf);
@@ -275,17 +390,6 @@ void OctomapServer::insertCloudCallback(const sensor_msgs::PointCloud2::ConstPtr
   pcl_ros::transformAsMatrix(sensorToWorldTf, sensorToWorld);
 
 
-  // set up filter for height range, also removes NANs:
-  pcl::PassThrough<pcl::PointXYZ> pass_x;
-  pass_x.setFilterFieldName("x");
-  pass_x.setFilterLimits(m_pointcloudMinX, m_pointcloudMaxX);
-  pcl::PassThrough<pcl::PointXYZ> pass_y;
-  pass_y.setFilterFieldName("y");
-  pass_y.setFilterLimits(m_pointcloudMinY, m_pointcloudMaxY);
-  pcl::PassThrough<pcl::PointXYZ> pass_z;
-  pass_z.setFilterFieldName("z");
-  pass_z.setFilterLimits(m_pointcloudMinZ, m_pointcloudMaxZ);
-
   PCLPointCloud pc_ground; // segmented ground plane
   PCLPointCloud pc_nonground; // everything else
 
@@ -309,12 +413,9 @@ void OctomapServer::insertCloudCallback(const sensor_msgs::PointCloud2::ConstPtr
 
     // transform pointcloud from sensor frame to fixed robot frame
     pcl::transformPointCloud(pc, pc, sensorToBase);
-    pass_x.setInputCloud(pc.makeShared());
-    pass_x.filter(pc);
-    pass_y.setInputCloud(pc.makeShared());
-    pass_y.filter(pc);
-    pass_z.setInputCloud(pc.makeShared());
-    pass_z.filter(pc);
+
+    // fused height range + NaN filter, single pass, no cloud copies:
+    filterPointCloud(pc);
     filterGroundPlane(pc, pc_ground, pc_nonground);
 
     // transform clouds to world frame for insertion
@@ -324,13 +425,8 @@ void OctomapServer::insertCloudCallback(const sensor_msgs::PointCloud2::ConstPtr
     // directly transform to map frame:
     pcl::transformPointCloud(pc, pc, sensorToWorld);
 
-    // just filter height range:
-    pass_x.setInputCloud(pc.makeShared());
-    pass_x.filter(pc);
-    pass_y.setInputCloud(pc.makeShared());
-    pass_y.filter(pc);
-    pass_z.setInputCloud(pc.makeShared());
-    pass_z.filter(pc);
+    // just filter height range (fused, single pass, no cloud copies):
+    filterPointCloud(pc);
 
     pc_nonground = pc;
     // pc_nonground is empty without ground segmentation
@@ -356,93 +452,95 @@ void OctomapServer::insertScan(const tf::Point& sensorOriginTf, const PCLPointCl
     ROS_ERROR_STREAM("Could not generate Key for origin "<<sensorOrigin);
   }
 
-#ifdef COLOR_OCTOMAP_SERVER
-  unsigned char* colors = new unsigned char[3];
-#endif
-
   // instead of direct scan insertion, compute update to filter ground:
   KeySet free_cells, occupied_cells;
-  // insert ground points only as free:
-  for (PCLPointCloud::const_iterator it = ground.begin(); it != ground.end(); ++it){
-    point3d point(it->x, it->y, it->z);
-    // maxrange check
-    if ((m_maxRange > 0.0) && ((point - sensorOrigin).norm() > m_maxRange) ) {
-      point = sensorOrigin + (point - sensorOrigin).normalized() * m_maxRange;
-    }
 
-    // only clear space (ground points)
-    if (m_octree->computeRayKeys(sensorOrigin, point, m_keyRay)){
-      free_cells.insert(m_keyRay.begin(), m_keyRay.end());
+  const size_t numThreads =
+    (m_numRayThreads > 1) ? static_cast<size_t>(m_numRayThreads) : 1;
+  if (numThreads == 1){
+    // insert ground points only as free:
+    computeRaysRange(ground, sensorOrigin, true, 0, ground.size(),
+                     &free_cells, &occupied_cells, &m_updateBBXMin,
+                     &m_updateBBXMax);
+    // all other points: free on ray, occupied on endpoint:
+    computeRaysRange(nonground, sensorOrigin, false, 0, nonground.size(),
+                     &free_cells, &occupied_cells, &m_updateBBXMin,
+                     &m_updateBBXMax);
+  } else {
+    // Partition both clouds across worker threads. Ray computation only
+    // reads immutable tree geometry, so the workers never race; their
+    // per-thread sets merge here and the tree update below remains a
+    // deterministic single pass.
+    std::vector<KeySet> freeSets(2 * numThreads), occSets(2 * numThreads);
+    std::vector<OcTreeKey> bbxMins(2 * numThreads, m_updateBBXMin);
+    std::vector<OcTreeKey> bbxMaxs(2 * numThreads, m_updateBBXMax);
+    std::vector<std::thread> workers;
+
+    const size_t groundStride = (ground.size() + numThreads - 1) / numThreads;
+    const size_t nongroundStride =
+      (nonground.size() + numThreads - 1) / numThreads;
+    for (size_t t = 0; t < numThreads; ++t){
+      const size_t groundBegin = t * groundStride;
+      if (groundBegin < ground.size()){
+        workers.push_back(std::thread(
+          &OctomapServer::computeRaysRange, this, std::cref(ground),
+          std::cref(sensorOrigin), true, groundBegin,
+          std::min(groundBegin + groundStride, ground.size()),
+          &freeSets[t], &occSets[t], &bbxMins[t], &bbxMaxs[t]));
+      }
+
+      const size_t nongroundBegin = t * nongroundStride;
+      if (nongroundBegin < nonground.size()){
+        workers.push_back(std::thread(
+          &OctomapServer::computeRaysRange, this, std::cref(nonground),
+          std::cref(sensorOrigin), false, nongroundBegin,
+          std::min(nongroundBegin + nongroundStride, nonground.size()),
+          &freeSets[numThreads + t], &occSets[numThreads + t],
+          &bbxMins[numThreads + t], &bbxMaxs[numThreads + t]));
+      }
     }
 
-    octomap::OcTreeKey endKey;
-    if (m_octree->coordToKeyChecked(point, endKey)){
-      updateMinKey(endKey, m_updateBBXMin);
-      updateMaxKey(endKey, m_updateBBXMax);
-    } else{
-      ROS_ERROR_STREAM("Could not generate Key for endpoint "<<point);
+    for (size_t t = 0; t < workers.size(); ++t)
+      workers[t].join();
+
+    for (size_t s = 0; s < 2 * numThreads; ++s){
+      free_cells.insert(freeSets[s].begin(), freeSets[s].end());
+      occupied_cells.insert(occSets[s].begin(), occSets[s].end());
+      updateMinKey(bbxMins[s], m_updateBBXMin);
+      updateMaxKey(bbxMaxs[s], m_updateBBXMax);
     }
   }
 
-  // all other points: free on ray, occupied on endpoint:
+#ifdef COLOR_OCTOMAP_SERVER // NB: Only read and interpret color for occupied endpoints
+  // Color integration touches the tree, so it stays on this thread.
   for (PCLPointCloud::const_iterator it = nonground.begin(); it != nonground.end(); ++it){
     point3d point(it->x, it->y, it->z);
-    // maxrange check
     if ((m_maxRange < 0.0) || ((point - sensorOrigin).norm() <= m_maxRange) ) {
-
-      // free cells
-      if (m_octree->computeRayKeys(sensorOrigin, point, m_keyRay)){
-        free_cells.insert(m_keyRay.begin(), m_keyRay.end());
-      }
-      // occupied endpoint
-      OcTreeKey key;
-      if (m_octree->coordToKeyChecked(point, key)){
-        occupied_cells.insert(key);
-
-        updateMinKey(key, m_updateBBXMin);
-        updateMaxKey(key, m_updateBBXMax);
-
-#ifdef COLOR_OCTOMAP_SERVER // NB: Only read and interpret color if it's an occupied node
-        const int rgb = *reinterpret_cast<const int*>(&(it->rgb)); // TODO: there are other ways to encode color than this one
-        colors[0] = ((rgb >> 16) & 0xff);
-        colors[1] = ((rgb >> 8) & 0xff);
-        colors[2] = (rgb & 0xff);
-        m_octree->averageNodeColor(it->x, it->y, it->z, colors[0], colors[1], colors[2]);
-#endif
-      }
-    } else {// ray longer than maxrange:;
-      point3d new_end = sensorOrigin + (point - sensorOrigin).normalized() * m_maxRange;
-      if (m_octree->computeRayKeys(sensorOrigin, new_end, m_keyRay)){
-        free_cells.insert(m_keyRay.begin(), m_keyRay.end());
-
-        octomap::OcTreeKey endKey;
-        if (m_octree->coordToKeyChecked(new_end, endKey)){
-          updateMinKey(endKey, m_updateBBXMin);
-          updateMaxKey(endKey, m_updateBBXMax);
-        } else{
-          ROS_ERROR_STREAM("Could not generate Key for endpoint "<<new_end);
-        }
-
-
-      }
+      const int rgb = *reinterpret_cast<const int*>(&(it->rgb)); // TODO: there are other ways to encode color than this one
+      m_octree->averageNodeColor(it->x, it->y, it->z, (rgb >> 16) & 0xff,
+                                 (rgb >> 8) & 0xff, rgb & 0xff);
     }
   }
+#endif
 
   // mark free cells only if not seen occupied in this cloud
   for(KeySet::iterator it = free_cells.begin(), end=free_cells.end(); it!= end; ++it){
     if (occupied_cells.find(*it) == occupied_cells.end()){
-      m_octree->updateNode(*it, false);
+      m_octree->updateNode(*it, false, m_lazyEval);
     }
   }
 
   // now mark all occupied cells:
   for (KeySet::iterator it = occupied_cells.begin(), end=occupied_cells.end(); it!= end; it++) {
-    m_octree->updateNode(*it, true);
+    m_octree->updateNode(*it, true, m_lazyEval);
   }
 
-  // TODO: eval lazy+updateInner vs. proper insertion
-  // non-lazy by default (updateInnerOccupancy() too slow for large maps)
-  //m_octree->updateInnerOccupancy();
+  // With lazy updates, inner-node occupancy is propagated afterwards, but
+  // only along the paths this scan touched (a full updateInnerOccupancy()
+  // is too slow for large maps, per the old TODO here).
+  if (m_lazyEval)
+    propagateNodes(free_cells, occupied_cells);
+
   octomap::point3d minPt, maxPt;
   ROS_DEBUG_STREAM("Bounding box keys (before): " << m_updateBBXMin[0] << " " <<m_updateBBXMin[1] << " " << m_updateBBXMin[2] << " / " <<m_updateBBXMax[0] << " "<<m_updateBBXMax[1] << " "<< m_updateBBXMax[2]);
 
@@ -470,226 +568,228 @@ void OctomapServer::insertScan(const tf::Point& sensorOriginTf, const PCLPointCl
 
 }
 
+// Propagate deferred occupancy to inner nodes along only the updated
+// paths, bottom-up. Each level's ancestor keys are deduplicated, so the
+// number of touched nodes shrinks roughly 8x per level toward the root.
+void OctomapServer::propagateNodes(const KeySet& freeCells,
+                                   const KeySet& occupiedCells){
+  KeySet current;
+  current.insert(freeCells.begin(), freeCells.end());
+  current.insert(occupiedCells.begin(), occupiedCells.end());
+
+  for (unsigned depth = m_treeDepth; depth-- > 0;){
+    KeySet parents;
+    for (KeySet::const_iterator it = current.begin(), end = current.end();
+         it != end; ++it)
+      parents.insert(m_octree->adjustKeyAtDepth(*it, depth));
+
+    for (KeySet::const_iterator it = parents.begin(), end = parents.end();
+         it != end; ++it){
+      OcTreeT::NodeType* node = m_octree->search(*it, depth);
+      if (node && node->hasChildren())
+        node->updateOccupancyChildren();
+    }
 
-
-void OctomapServer::publishAll(const ros::Time& rostime){
-  ros::WallTime startTime = ros::WallTime::now();
-  size_t octomapSize = m_octree->size();
-  // TODO: estimate num occ. voxels for size of arrays (reserve)
-  if (octomapSize <= 1){
-    ROS_WARN("Nothing to publish, octree is empty");
-    return;
+    current.swap(parents);
   }
+}
 
-  bool publishFreeMarkerArray = m_publishFreeSpace && (m_latchedTopics || m_fmarkerPub.getNumSubscribers() > 0);
-  bool publishMarkerArray = (m_latchedTopics || m_markerPub.getNumSubscribers() > 0);
-  bool publishPointCloud = (m_latchedTopics || m_pointCloudPub.getNumSubscribers() > 0);
-  bool publishBinaryMap = (m_latchedTopics || m_binaryMapPub.getNumSubscribers() > 0);
-  bool publishFullMap = (m_latchedTopics || m_fullMapPub.getNumSubscribers() > 0);
-  m_publish2DMap = (m_latchedTopics || m_mapPub.getNumSubscribers() > 0);
-
-  // init markers for free space:
-  visualization_msgs::MarkerArray freeNodesVis;
-  // each array stores all cubes of a different size, one for each depth level:
-  freeNodesVis.markers.resize(m_treeDepth+1);
-
-  geometry_msgs::Pose pose;
-  pose.orientation = tf::createQuaternionMsgFromYaw(0.0);
-
-  // init markers:
-  visualization_msgs::MarkerArray occupiedNodesVis;
-  // each array stores all cubes of a different size, one for each depth level:
-  occupiedNodesVis.markers.resize(m_treeDepth+1);
-
-  // init pointcloud:
-  pcl::PointCloud<PCLPoint> pclCloud;
-
-  // call pre-traversal hook:
-  handlePreNodeTraversal(rostime);
-
-  // now, traverse all leafs in the tree:
-  for (OcTreeT::iterator it = m_octree->begin(m_maxTreeDepth),
-      end = m_octree->end(); it != end; ++it)
-  {
-    bool inUpdateBBX = isInUpdateBBX(it);
-
-    // call general hook:
-    handleNode(it);
-    if (inUpdateBBX)
-      handleNodeInBBX(it);
-
-    if (m_octree->isNodeOccupied(*it)){
-      double z = it.getZ();
-      if (z > m_occupancyMinZ && z < m_occupancyMaxZ)
-      {
-        double size = it.getSize();
-        double x = it.getX();
-        double y = it.getY();
-#ifdef COLOR_OCTOMAP_SERVER
-        int r = it->getColor().r;
-        int g = it->getColor().g;
-        int b = it->getColor().b;
-#endif
-
-        // Ignore speckles in the map:
-        if (m_filterSpeckles && (it.getDepth() == m_treeDepth +1) && isSpeckleNode(it.getKey())){
-          ROS_DEBUG("Ignoring single speckle at (%f,%f,%f)", x, y, z);
-          continue;
-        } // else: current octree node is no speckle, send it out
-
-        handleOccupiedNode(it);
-        if (inUpdateBBX)
-          handleOccupiedNodeInBBX(it);
-
-
-        //create marker:
-        if (publishMarkerArray){
-          unsigned idx = it.getDepth();
-          assert(idx < occupiedNodesVis.markers.size());
-
-          geometry_msgs::Point cubeCenter;
-          cubeCenter.x = x;
-          cubeCenter.y = y;
-          cubeCenter.z = z;
-
-          occupiedNodesVis.markers[idx].points.push_back(cubeCenter);
-          if (m_useHeightMap){
-            double minX, minY, minZ, maxX, maxY, maxZ;
-            m_octree->getMetricMin(minX, minY, minZ);
-            m_octree->getMetricMax(maxX, maxY, maxZ);
-
-            double h = (1.0 - std::min(std::max((cubeCenter.z-minZ)/ (maxZ - minZ), 0.0), 1.0)) *m_colorFactor;
-            occupiedNodesVis.markers[idx].colors.push_back(heightMapColor(h));
-          }
+// Compute the free/occupied updates for one range of cloud points. Only
+// immutable tree geometry (key conversions, ray stepping) is read here,
+// which is what makes ranges safe to run on worker threads.
+void OctomapServer::computeRaysRange(const PCLPointCloud& cloud,
+                                     const point3d& sensorOrigin,
+                                     bool clearOnly, size_t begin, size_t end,
+                                     KeySet* freeCells, KeySet* occupiedCells,
+                                     OcTreeKey* bbxMin, OcTreeKey* bbxMax) const{
+  KeyRay keyRay; // worker-local ray buffer
+
+  for (size_t i = begin; i < end; ++i){
+    point3d point(cloud[i].x, cloud[i].y, cloud[i].z);
+
+    if (clearOnly){
+      // maxrange check
+      if ((m_maxRange > 0.0) && ((point - sensorOrigin).norm() > m_maxRange) ) {
+        point = sensorOrigin + (point - sensorOrigin).normalized() * m_maxRange;
+      }
 
-#ifdef COLOR_OCTOMAP_SERVER
-          if (m_useColoredMap) {
-            std_msgs::ColorRGBA _color; _color.r = (r / 255.); _color.g = (g / 255.); _color.b = (b / 255.); _color.a = 1.0; // TODO/EVALUATE: potentially use occupancy as measure for alpha channel?
-            occupiedNodesVis.markers[idx].colors.push_back(_color);
-          }
-#endif
-        }
+      // only clear space (ground points)
+      if (m_octree->computeRayKeys(sensorOrigin, point, keyRay)){
+        freeCells->insert(keyRay.begin(), keyRay.end());
+      }
 
-        // insert into pointcloud:
-        if (publishPointCloud) {
-#ifdef COLOR_OCTOMAP_SERVER
-          PCLPoint _point = PCLPoint();
-          _point.x = x; _point.y = y; _point.z = z;
-          _point.r = r; _point.g = g; _point.b = b;
-          pclCloud.push_back(_point);
-#else
-          pclCloud.push_back(PCLPoint(x, y, z));
-#endif
-        }
+      octomap::OcTreeKey endKey;
+      if (m_octree->coordToKeyChecked(point, endKey)){
+        updateMinKey(endKey, *bbxMin);
+        updateMaxKey(endKey, *bbxMax);
+      } else{
+        ROS_ERROR_STREAM("Could not generate Key for endpoint "<<point);
+      }
+    } else if ((m_maxRange < 0.0) || ((point - sensorOrigin).norm() <= m_maxRange) ) {
+      // free cells
+      if (m_octree->computeRayKeys(sensorOrigin, point, keyRay)){
+        freeCells->insert(keyRay.begin(), keyRay.end());
+      }
+      // occupied endpoint
+      OcTreeKey key;
+      if (m_octree->coordToKeyChecked(point, key)){
+        occupiedCells->insert(key);
 
+        updateMinKey(key, *bbxMin);
+        updateMaxKey(key, *bbxMax);
       }
-    } else{ // node not occupied => mark as free in 2D map if unknown so far
-      double z = it.getZ();
-      if (z > m_occupancyMinZ && z < m_occupancyMaxZ)
-      {
-        handleFreeNode(it);
-        if (inUpdateBBX)
-          handleFreeNodeInBBX(it);
-
-        if (m_publishFreeSpace){
-          double x = it.getX();
-          double y = it.getY();
-
-          //create marker for free space:
-          if (publishFreeMarkerArray){
-            unsigned idx = it.getDepth();
-            assert(idx < freeNodesVis.markers.size());
-
-            geometry_msgs::Point cubeCenter;
-            cubeCenter.x = x;
-            cubeCenter.y = y;
-            cubeCenter.z = z;
-
-            freeNodesVis.markers[idx].points.push_back(cubeCenter);
-          }
-        }
+    } else {// ray longer than maxrange:;
+      point3d new_end = sensorOrigin + (point - sensorOrigin).normalized() * m_maxRange;
+      if (m_octree->computeRayKeys(sensorOrigin, new_end, keyRay)){
+        freeCells->insert(keyRay.begin(), keyRay.end());
 
+        octomap::OcTreeKey endKey;
+        if (m_octree->coordToKeyChecked(new_end, endKey)){
+          updateMinKey(endKey, *bbxMin);
+          updateMaxKey(endKey, *bbxMax);
+        } else{
+          ROS_ERROR_STREAM("Could not generate Key for endpoint "<<new_end);
+        }
       }
     }
   }
+}
 
-  // call post-traversal hook:
-  handlePostNodeTraversal(rostime);
 
-  // finish MarkerArray:
-  if (publishMarkerArray){
-    for (unsigned i= 0; i < occupiedNodesVis.markers.size(); ++i){
-      double size = m_octree->getNodeSize(i);
 
-      occupiedNodesVis.markers[i].header.frame_id = m_worldFrameId;
-      occupiedNodesVis.markers[i].header.stamp = rostime;
-      occupiedNodesVis.markers[i].ns = "map";
-      occupiedNodesVis.markers[i].id = i;
-      occupiedNodesVis.markers[i].type = visualization_msgs::Marker::CUBE_LIST;
-      occupiedNodesVis.markers[i].scale.x = size;
-      occupiedNodesVis.markers[i].scale.y = size;
-      occupiedNodesVis.markers[i].scale.z = size;
-      if (!m_useColoredMap)
-        occupiedNodesVis.markers[i].color = m_color;
+void OctomapServer::publishAll(const ros::Time& rostime){
+  doPublishAll<OctomapServer>(rostime);
+}
 
 
-      if (occupiedNodesVis.markers[i].points.size() > 0)
-        occupiedNodesVis.markers[i].action = visualization_msgs::Marker::ADD;
-      else
-        occupiedNodesVis.markers[i].action = visualization_msgs::Marker::DELETE;
-    }
+// Rate-limit one publish product against its last publication stamp.
+bool OctomapServer::dueToPublish(double rate, ros::Time& lastPub,
+                                 const ros::Time& now){
+  if (rate <= 0.0)
+    return true;
 
-    m_markerPub.publish(occupiedNodesVis);
+  // Time jumped backwards (e.g. sim time reset): start over.
+  if (now < lastPub){
+    lastPub = now;
+    return true;
   }
 
+  if ((now - lastPub).toSec() < 1.0 / rate)
+    return false;
 
-  // finish FreeMarkerArray:
-  if (publishFreeMarkerArray){
-    for (unsigned i= 0; i < freeNodesVis.markers.size(); ++i){
-      double size = m_octree->getNodeSize(i);
-
-      freeNodesVis.markers[i].header.frame_id = m_worldFrameId;
-      freeNodesVis.markers[i].header.stamp = rostime;
-      freeNodesVis.markers[i].ns = "map";
-      freeNodesVis.markers[i].id = i;
-      freeNodesVis.markers[i].type = visualization_msgs::Marker::CUBE_LIST;
-      freeNodesVis.markers[i].scale.x = size;
-      freeNodesVis.markers[i].scale.y = size;
-      freeNodesVis.markers[i].scale.z = size;
-      freeNodesVis.markers[i].color = m_colorFree;
-
+  lastPub = now;
+  return true;
+}
 
-      if (freeNodesVis.markers[i].points.size() > 0)
-        freeNodesVis.markers[i].action = visualization_msgs::Marker::ADD;
+// Refresh the persistent occupied-voxel store inside the update BBX. An
+// entry can only have changed if its node overlaps the BBX, i.e. if its
+// center lies within the BBX padded by half the node size at that depth;
+// all such entries are dropped and regenerated from a bbx-limited leaf
+// traversal, leaving the rest of the store untouched.
+void OctomapServer::updateVisStore(){
+  if (m_occupiedVisStore.size() != m_treeDepth + 1)
+    m_occupiedVisStore.resize(m_treeDepth + 1);
+
+  const point3d minPt = m_octree->keyToCoord(m_updateBBXMin);
+  const point3d maxPt = m_octree->keyToCoord(m_updateBBXMax);
+
+  // Drop every entry whose node could overlap the BBX.
+  for (unsigned depth = 0; depth < m_occupiedVisStore.size(); ++depth){
+    const double halfSize = 0.5 * m_octree->getNodeSize(depth);
+
+    VisStore::iterator it = m_occupiedVisStore[depth].begin();
+    while (it != m_occupiedVisStore[depth].end()){
+      const geometry_msgs::Point& center = it->second;
+      if (center.x >= minPt.x() - halfSize && center.x <= maxPt.x() + halfSize
+          && center.y >= minPt.y() - halfSize && center.y <= maxPt.y() + halfSize
+          && center.z >= minPt.z() - halfSize && center.z <= maxPt.z() + halfSize)
+        it = m_occupiedVisStore[depth].erase(it);
       else
-        freeNodesVis.markers[i].action = visualization_msgs::Marker::DELETE;
+        ++it;
     }
-
-    m_fmarkerPub.publish(freeNodesVis);
   }
 
-
-  // finish pointcloud:
-  if (publishPointCloud){
-    sensor_msgs::PointCloud2 cloud;
-    pcl::toROSMsg (pclCloud, cloud);
-    cloud.header.frame_id = m_worldFrameId;
-    cloud.header.stamp = rostime;
-    m_pointCloudPub.publish(cloud);
+  // Regenerate from the current leaves overlapping the BBX.
+  for (OcTreeT::leaf_bbx_iterator it =
+         m_octree->begin_leafs_bbx(m_updateBBXMin, m_updateBBXMax, m_maxTreeDepth),
+       end = m_octree->end_leafs_bbx(); it != end; ++it){
+    if (!m_octree->isNodeOccupied(*it))
+      continue;
+
+    double z = it.getZ();
+    if (z <= m_occupancyMinZ || z >= m_occupancyMaxZ)
+      continue;
+
+    if (m_filterSpeckles && (it.getDepth() == m_treeDepth)
+        && isSpeckleNode(it.getKey()))
+      continue;
+
+    geometry_msgs::Point center;
+    center.x = it.getX();
+    center.y = it.getY();
+    center.z = z;
+    m_occupiedVisStore[it.getDepth()][it.getIndexKey()] = center;
   }
+}
+
+// Assemble and publish the occupied marker array from the store.
+void OctomapServer::publishMarkersFromStore(const ros::Time& rostime){
+  visualization_msgs::MarkerArray occupiedNodesVis;
+  occupiedNodesVis.markers.resize(m_treeDepth + 1);
 
-  if (publishBinaryMap)
-    publishBinaryOctoMap(rostime);
+  double minX, minY, minZ, maxX, maxY, maxZ;
+  m_octree->getMetricMin(minX, minY, minZ);
+  m_octree->getMetricMax(maxX, maxY, maxZ);
 
-  if (publishFullMap)
-    publishFullOctoMap(rostime);
+  for (unsigned depth = 0; depth < m_occupiedVisStore.size(); ++depth){
+    visualization_msgs::Marker& marker = occupiedNodesVis.markers[depth];
+    marker.points.reserve(m_occupiedVisStore[depth].size());
 
+    for (VisStore::const_iterator it = m_occupiedVisStore[depth].begin(),
+           end = m_occupiedVisStore[depth].end(); it != end; ++it){
+      marker.points.push_back(it->second);
+      if (m_useHeightMap){
+        double h = (1.0 - std::min(std::max((it->second.z - minZ) / (maxZ - minZ), 0.0), 1.0)) * m_colorFactor;
+        marker.colors.push_back(heightMapColor(h));
+      }
+    }
 
-  double total_elapsed = (ros::WallTime::now() - startTime).toSec();
-  ROS_DEBUG("Map publishing in OctomapServer took %f sec", total_elapsed);
+    double size = m_octree->getNodeSize(depth);
+    marker.header.frame_id = m_worldFrameId;
+    marker.header.stamp = rostime;
+    marker.ns = "map";
+    marker.id = depth;
+    marker.type = visualization_msgs::Marker::CUBE_LIST;
+    marker.scale.x = size;
+    marker.scale.y = size;
+    marker.scale.z = size;
+    if (!m_useColoredMap)
+      marker.color = m_color;
+
+    if (marker.points.size() > 0)
+      marker.action = visualization_msgs::Marker::ADD;
+    else
+      marker.action = visualization_msgs::Marker::DELETE;
+  }
 
+  m_markerPub.publish(occupiedNodesVis);
 }
 
+// Assemble and publish the occupied-center cloud from the store.
+void OctomapServer::publishCloudFromStore(const ros::Time& rostime){
+  pcl::PointCloud<PCLPoint> pclCloud;
+  for (unsigned depth = 0; depth < m_occupiedVisStore.size(); ++depth){
+    for (VisStore::const_iterator it = m_occupiedVisStore[depth].begin(),
+           end = m_occupiedVisStore[depth].end(); it != end; ++it)
+      pclCloud.push_back(PCLPoint(it->second.x, it->second.y, it->second.z));
+  }
+
+  sensor_msgs::PointCloud2 cloud;
+  pcl::toROSMsg(pclCloud, cloud);
+  cloud.header.frame_id = m_worldFrameId;
+  cloud.header.stamp = rostime;
+  m_pointCloudPub.publish(cloud);
+}
 
 bool OctomapServer::octomapBinarySrv(OctomapSrv::Request  &req,
                                     OctomapSrv::Response &res)
@@ -698,7 +798,19 @@ bool OctomapServer::octomapBinarySrv(OctomapSrv::Request  &req,
   ROS_INFO("Sending binary map data on service request");
   res.map.header.frame_id = m_worldFrameId;
   res.map.header.stamp = ros::Time::now();
-  if (!octomap_msgs::binaryMapToMsg(*m_octree, res.map))
+
+  // Snapshot under the lock, serialize outside it: copying the tree is
+  // far cheaper than serializing it, so insertion stalls only for the
+  // copy instead of the whole save.
+  OcTreeT* snapshot;
+  {
+    std::lock_guard<std::mutex> lock(m_treeMutex);
+    snapshot = new OcTreeT(*m_octree);
+  }
+
+  const bool ok = octomap_msgs::binaryMapToMsg(*snapshot, res.map);
+  delete snapshot;
+  if (!ok)
     return false;
 
   double total_elapsed = (ros::WallTime::now() - startTime).toSec();
@@ -713,14 +825,21 @@ bool OctomapServer::octomapFullSrv(OctomapSrv::Request  &req,
   res.map.header.frame_id = m_worldFrameId;
   res.map.header.stamp = ros::Time::now();
 
+  // Snapshot under the lock, serialize outside it (see octomapBinarySrv).
+  OcTreeT* snapshot;
+  {
+    std::lock_guard<std::mutex> lock(m_treeMutex);
+    snapshot = new OcTreeT(*m_octree);
+  }
 
-  if (!octomap_msgs::fullMapToMsg(*m_octree, res.map))
-    return false;
-
-  return true;
+  const bool ok = octomap_msgs::fullMapToMsg(*snapshot, res.map);
+  delete snapshot;
+  return ok;
 }
 
 bool OctomapServer::clearBBXSrv(BBXSrv::Request& req, BBXSrv::Response& resp){
+  std::lock_guard<std::mutex> lock(m_treeMutex);
+
   point3d min = pointMsgToOctomap(req.min);
   point3d max = pointMsgToOctomap(req.max);
 
@@ -734,16 +853,27 @@ bool OctomapServer::clearBBXSrv(BBXSrv::Request& req, BBXSrv::Response& resp){
   // TODO: eval which is faster (setLogOdds+updateInner or updateNode)
   m_octree->updateInnerOccupancy();
 
+  // widen the update BBX so incremental consumers see the cleared region:
+  octomap::OcTreeKey minKey, maxKey;
+  if (m_octree->coordToKeyChecked(min, minKey)
+      && m_octree->coordToKeyChecked(max, maxKey)){
+    updateMinKey(minKey, m_updateBBXMin);
+    updateMaxKey(maxKey, m_updateBBXMax);
+  }
+
   publishAll(ros::Time::now());
 
   return true;
 }
 
 bool OctomapServer::resetSrv(std_srvs::Empty::Request& req, std_srvs::Empty::Response& resp) {
+  std::lock_guard<std::mutex> lock(m_treeMutex);
+
   visualization_msgs::MarkerArray occupiedNodesVis;
   occupiedNodesVis.markers.resize(m_treeDepth +1);
   ros::Time rostime = ros::Time::now();
   m_octree->clear();
+  m_occupiedVisStore.clear();
   // clear 2D map:
   m_gridmap.data.clear();
   m_gridmap.info.height = 0.0;
@@ -785,6 +915,58 @@ bool OctomapServer::resetSrv(std_srvs::Empty::Request& req, std_srvs::Empty::Res
   return true;
 }
 
+// Build and publish the depth-truncated coarse maps.
+void OctomapServer::publishCoarseMaps(const ros::Time& rostime){
+  const unsigned depth = std::min<unsigned>(m_coarseMapDepth, m_treeDepth);
+  if (depth == 0)
+    return;
+
+  const double coarse_res =
+    m_octree->getResolution() * (1 << (m_treeDepth - depth));
+  OcTreeT coarse(coarse_res);
+
+  // One depth-limited leaf pass. The iterator yields true leaves plus
+  // inner nodes truncated at 'depth' (whose occupancy is maintained on
+  // insertion), so every visited node is exactly one aggregate to paint;
+  // shallower leaves paint all the coarse cells they cover.
+  for (OcTreeT::iterator it = m_octree->begin(depth),
+       end = m_octree->end(); it != end; ++it){
+    const float log_odds = it->getLogOdds();
+    const unsigned span =
+      (it.getDepth() < depth) ? (1u << (depth - it.getDepth())) : 1u;
+    const double size = coarse_res;
+    const double x0 = it.getX() - 0.5 * it.getSize() + 0.5 * size;
+    const double y0 = it.getY() - 0.5 * it.getSize() + 0.5 * size;
+    const double z0 = it.getZ() - 0.5 * it.getSize() + 0.5 * size;
+
+    for (unsigned dx = 0; dx < span; ++dx)
+      for (unsigned dy = 0; dy < span; ++dy)
+        for (unsigned dz = 0; dz < span; ++dz)
+          coarse.setNodeValue(octomap::point3d(x0 + dx * size, y0 + dy * size,
+                                               z0 + dz * size),
+                              log_odds, true);
+  }
+
+  coarse.updateInnerOccupancy();
+  coarse.prune();
+
+  if (m_latchedTopics || m_binaryMapCoarsePub.getNumSubscribers() > 0){
+    Octomap map;
+    map.header.frame_id = m_worldFrameId;
+    map.header.stamp = rostime;
+    if (octomap_msgs::binaryMapToMsg(coarse, map))
+      m_binaryMapCoarsePub.publish(map);
+  }
+
+  if (m_fullMapCoarsePub.getNumSubscribers() > 0){
+    Octomap map;
+    map.header.frame_id = m_worldFrameId;
+    map.header.stamp = rostime;
+    if (octomap_msgs::fullMapToMsg(coarse, map))
+      m_fullMapCoarsePub.publish(map);
+  }
+}
+
 void OctomapServer::publishBinaryOctoMap(const ros::Time& rostime) const{
 
   Octomap map;
@@ -811,6 +993,35 @@ void OctomapServer::publishFullOctoMap(const ros::Time& rostime) const{
 }
 
 
+// One fused pass over the cloud: drop NaNs and everything outside the
+// configured x/y/z ranges, compacting survivors through a reused buffer.
+void OctomapServer::filterPointCloud(PCLPointCloud& pc){
+  m_filteredCloud.points.clear();
+  m_filteredCloud.points.reserve(pc.size());
+  m_filteredCloud.header = pc.header;
+
+  for (size_t i = 0; i < pc.size(); ++i){
+    const PCLPoint& point = pc[i];
+    if (!pcl_isfinite(point.x) || !pcl_isfinite(point.y) || !pcl_isfinite(point.z))
+      continue;
+
+    if (point.x < m_pointcloudMinX || point.x > m_pointcloudMaxX
+        || point.y < m_pointcloudMinY || point.y > m_pointcloudMaxY
+        || point.z < m_pointcloudMinZ || point.z > m_pointcloudMaxZ)
+      continue;
+
+    m_filteredCloud.points.push_back(point);
+  }
+
+  m_filteredCloud.width = static_cast<uint32_t>(m_filteredCloud.points.size());
+  m_filteredCloud.height = 1;
+  m_filteredCloud.is_dense = true;
+
+  // Hand the compacted points back; pc's old storage becomes next scan's
+  // scratch buffer.
+  pc.swap(m_filteredCloud);
+}
+
 void OctomapServer::filterGroundPlane(const PCLPointCloud& pc, PCLPointCloud& ground, PCLPointCloud& nonground) const{
   ground.header = pc.header;
   nonground.header = pc.header;
@@ -819,6 +1030,13 @@ void OctomapServer::filterGroundPlane(const PCLPointCloud& pc, PCLPointCloud& gr
     ROS_WARN("Pointcloud in OctomapServer too small, skipping ground plane extraction");
     nonground = pc;
   } else {
+    // Fast mode: split on the persisted plane from the previous RANSAC
+    // fit when it still explains this scan; only when that fails (or on
+    // the first scan) does the full RANSAC below run.
+    if (m_fastGroundFilter && m_groundPlaneValid
+        && segmentGroundFast(pc, ground, nonground))
+      return;
+
     // plane detection for ground plane removal:
     pcl::ModelCoefficients::Ptr coefficients (new pcl::ModelCoefficients);
     pcl::PointIndices::Ptr inliers (new pcl::PointIndices);
@@ -855,6 +1073,16 @@ void OctomapServer::filterGroundPlane(const PCLPointCloud& pc, PCLPointCloud& gr
       if (std::abs(coefficients->values.at(3)) < m_groundFilterPlaneDistance){
         ROS_DEBUG("Ground plane found: %zu/%zu inliers. Coeff: %f %f %f %f", inliers->indices.size(), cloud_filtered.size(),
                   coefficients->values.at(0), coefficients->values.at(1), coefficients->values.at(2), coefficients->values.at(3));
+
+        // persist the plane as the next frames' warm start, normal up so
+        // the staleness test's below-plane sign is well defined
+        const float flip = (coefficients->values.at(2) < 0.f) ? -1.f : 1.f;
+        m_groundCoeffs[0] = flip * coefficients->values.at(0);
+        m_groundCoeffs[1] = flip * coefficients->values.at(1);
+        m_groundCoeffs[2] = flip * coefficients->values.at(2);
+        m_groundCoeffs[3] = flip * coefficients->values.at(3);
+        m_groundPlaneValid = true;
+
         extract.setNegative (false);
         extract.filter (ground);
 
@@ -920,6 +1148,62 @@ void OctomapServer::filterGroundPlane(const PCLPointCloud& pc, PCLPointCloud& gr
 
 }
 
+// Cheap grid-based ground segmentation against the persisted plane.
+bool OctomapServer::segmentGroundFast(const PCLPointCloud& pc,
+                                      PCLPointCloud& ground,
+                                      PCLPointCloud& nonground) const{
+  const float a = m_groundCoeffs[0], b = m_groundCoeffs[1];
+  const float c = m_groundCoeffs[2], d = m_groundCoeffs[3];
+
+  // Validate the plane against the lowest point of each 0.5 m grid cell:
+  // a changed ground shows up there first.
+  const float cellSize = 0.5f;
+  std::unordered_map<long long, PCLPoint> lowest;
+  for (size_t i = 0; i < pc.size(); ++i){
+    const long long cx = static_cast<long long>(std::floor(pc[i].x / cellSize));
+    const long long cy = static_cast<long long>(std::floor(pc[i].y / cellSize));
+    const long long key = (cx << 32) ^ static_cast<unsigned int>(cy);
+
+    std::unordered_map<long long, PCLPoint>::iterator it = lowest.find(key);
+    if (it == lowest.end() || pc[i].z < it->second.z)
+      lowest[key] = pc[i];
+  }
+
+  size_t stale = 0;
+  for (std::unordered_map<long long, PCLPoint>::const_iterator it = lowest.begin();
+       it != lowest.end(); ++it){
+    // A lowest point below the plane by more than the tolerance means the
+    // plane no longer models the ground there.
+    const PCLPoint& point = it->second;
+    const float dist = a * point.x + b * point.y + c * point.z + d;
+    if (dist < -2.f * m_groundFilterDistance)
+      stale++;
+  }
+
+  if (4 * stale > lowest.size()){
+    ROS_DEBUG("Fast ground filter: plane stale (%zu/%zu cells), rerunning RANSAC",
+              stale, lowest.size());
+    return false;
+  }
+
+  // Split the scan on the persisted plane.
+  ground.points.reserve(pc.size());
+  nonground.points.reserve(pc.size());
+  for (size_t i = 0; i < pc.size(); ++i){
+    const float dist = a * pc[i].x + b * pc[i].y + c * pc[i].z + d;
+    if (std::abs(dist) < m_groundFilterDistance)
+      ground.points.push_back(pc[i]);
+    else
+      nonground.points.push_back(pc[i]);
+  }
+
+  ground.width = static_cast<uint32_t>(ground.points.size());
+  ground.height = 1;
+  nonground.width = static_cast<uint32_t>(nonground.points.size());
+  nonground.height = 1;
+  return true;
+}
+
 void OctomapServer::handlePreNodeTraversal(const ros::Time& rostime){
   if (m_publish2DMap){
     // init projected 2D map:
@@ -1097,7 +1381,72 @@ void OctomapServer::update2DMap(const OcTreeT::iterator& it, bool occupied){
 
 
 
-bool OctomapServer::isSpeckleNode(const OcTreeKey&nKey) const {
+// Build the occupied-key index consulted by the speckle filter.
+void OctomapServer::buildSpeckleIndex() const{
+  m_speckleKeys.clear();
+  m_speckleCoarse.clear();
+
+  for (OcTreeT::leaf_iterator it = m_octree->begin_leafs(),
+       end = m_octree->end_leafs(); it != end; ++it){
+    if (!m_octree->isNodeOccupied(*it))
+      continue;
+
+    const unsigned depth = it.getDepth();
+    const octomap::OcTreeKey base = it.getIndexKey();
+
+    if (depth == m_treeDepth){
+      m_speckleKeys.insert(it.getKey());
+    } else if (depth + 2 >= m_treeDepth){
+      // small coarse leaf: expand into its finest keys (at most 64)
+      const unsigned span = 1 << (m_treeDepth - depth);
+      octomap::OcTreeKey key;
+      for (unsigned dx = 0; dx < span; ++dx){
+        key[0] = base[0] + dx;
+        for (unsigned dy = 0; dy < span; ++dy){
+          key[1] = base[1] + dy;
+          for (unsigned dz = 0; dz < span; ++dz){
+            key[2] = base[2] + dz;
+            m_speckleKeys.insert(key);
+          }
+        }
+      }
+    } else {
+      // large occupied slab: keep as a key range
+      const unsigned span = 1 << (m_treeDepth - depth);
+      octomap::OcTreeKey maxKey(base[0] + span - 1, base[1] + span - 1,
+                                base[2] + span - 1);
+      m_speckleCoarse.push_back(std::make_pair(base, maxKey));
+    }
+  }
+
+  m_speckleIndexValid = true;
+}
+
+bool OctomapServer::isSpeckleNode(const OcTreeKey& nKey) const {
+  if (m_speckleIndexValid){
+    // batched path: hash lookups against the per-publish index
+    OcTreeKey key;
+    for (key[2] = nKey[2] - 1; key[2] <= nKey[2] + 1; ++key[2]){
+      for (key[1] = nKey[1] - 1; key[1] <= nKey[1] + 1; ++key[1]){
+        for (key[0] = nKey[0] - 1; key[0] <= nKey[0] + 1; ++key[0]){
+          if (key == nKey)
+            continue;
+
+          if (m_speckleKeys.find(key) != m_speckleKeys.end())
+            return false;
+
+          for (size_t i = 0; i < m_speckleCoarse.size(); ++i){
+            if (key[0] >= m_speckleCoarse[i].first[0] && key[0] <= m_speckleCoarse[i].second[0]
+                && key[1] >= m_speckleCoarse[i].first[1] && key[1] <= m_speckleCoarse[i].second[1]
+                && key[2] >= m_speckleCoarse[i].first[2] && key[2] <= m_speckleCoarse[i].second[2])
+              return false;
+          }
+        }
+      }
+    }
+    return true;
+  }
+
   OcTreeKey key;
   bool neighborFound = false;
   for (key[2] = nKey[2] - 1; !neighborFound && key[2] <= nKey[2] + 1; ++key[2]){
@@ -1114,10 +1463,13 @@ bool OctomapServer::isSpeckleNode(const OcTreeKey&nKey) const {
     }
   }
 
-  return neighborFound;
+  // a speckle is a node with NO occupied neighbor
+  return !neighborFound;
 }
 
 void OctomapServer::reconfigureCallback(octomap_server::OctomapServerConfig& config, uint32_t level){
+  std::lock_guard<std::mutex> lock(m_treeMutex);
+
   if (m_maxTreeDepth != unsigned(config.max_depth))
     m_maxTreeDepth = unsigned(config.max_depth);
   else{
@@ -36,7 +36,7 @@ namespace octomap_server{
 
 
 OctomapServerMultilayer::OctomapServerMultilayer(ros::NodeHandle private_nh_)
-: OctomapServer(private_nh_)
+: OctomapServerT<OctomapServerMultilayer>(private_nh_)
 {
 
   // TODO: callback for arm_navigation attached objects was removed, is
@@ -209,57 +209,32 @@ void OctomapServerMultilayer::update2DMap(const OcTreeT::iterator& it, bool occu
   double z = it.getZ();
   double s2 = it.getSize()/2.0;
 
-  // create a mask on which maps to update:
-  std::vector<bool> inMapLevel(m_multiGridmap.size(), false);
+  // bin this node into all z-layers at once; the mask buffer is reused
+  // across calls so the per-node path never allocates:
+  if (m_inMapLevel.size() != m_multiGridmap.size())
+    m_inMapLevel.resize(m_multiGridmap.size());
   for (unsigned i = 0; i < m_multiGridmap.size(); ++i){
-    if (z+s2 >= m_multiGridmap[i].minZ && z-s2 <= m_multiGridmap[i].maxZ){
-      inMapLevel[i] = true;
-    }
+    m_inMapLevel[i] = (z+s2 >= m_multiGridmap[i].minZ
+                       && z-s2 <= m_multiGridmap[i].maxZ);
   }
 
   if (it.getDepth() == m_maxTreeDepth){
-    unsigned idx = mapIdx(it.getKey());
-    if (occupied)
-      m_gridmap.data[idx] = 100;
-    else if (m_gridmap.data[idx] == -1){
-      m_gridmap.data[idx] = 0;
-    }
-
-    for (unsigned i = 0; i < inMapLevel.size(); ++i){
-      if (inMapLevel[i]){
-        if (occupied)
-          m_multiGridmap[i].map.data[idx] = 100;
-        else if (m_multiGridmap[i].map.data[idx] == -1)
-          m_multiGridmap[i].map.data[idx] = 0;
-      }
-    }
-
+    projectCell(mapIdx(it.getKey()), occupied);
   } else {
     int intSize = 1 << (m_treeDepth - it.getDepth());
     octomap::OcTreeKey minKey=it.getIndexKey();
-    for(int dx=0; dx < intSize; dx++){
-      int i = (minKey[0]+dx - m_paddedMinKey[0])/m_multires2DScale;
-      for(int dy=0; dy < intSize; dy++){
-        unsigned idx = mapIdx(i, (minKey[1]+dy - m_paddedMinKey[1])/m_multires2DScale);
-        if (occupied)
-          m_gridmap.data[idx] = 100;
-        else if (m_gridmap.data[idx] == -1){
-          m_gridmap.data[idx] = 0;
-        }
-
-        for (unsigned i = 0; i < inMapLevel.size(); ++i){
-          if (inMapLevel[i]){
-            if (occupied)
-              m_multiGridmap[i].map.data[idx] = 100;
-            else if (m_multiGridmap[i].map.data[idx] == -1)
-              m_multiGridmap[i].map.data[idx] = 0;
-          }
-        }
+
+    // y in the outer loop: consecutive x cells are adjacent in the
+    // row-major grids, so every layer's writes walk one contiguous row
+    // segment per scanline.
+    for(int dy=0; dy < intSize; dy++){
+      int j = (minKey[1]+dy - m_paddedMinKey[1])/m_multires2DScale;
+      for(int dx=0; dx < intSize; dx++){
+        projectCell(mapIdx((minKey[0]+dx - m_paddedMinKey[0])/m_multires2DScale, j),
+                    occupied);
       }
     }
   }
-
-
 }
 
 }
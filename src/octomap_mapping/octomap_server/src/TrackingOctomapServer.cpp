@@ -29,11 +29,50 @@
 
 #include <octomap_server/TrackingOctomapServer.h>
 #include <string>
+#include <algorithm>
 
 using namespace octomap;
 
 namespace octomap_server {
 
+namespace {
+  // Varint helpers for the compact change stream.
+  void encodeVarint(uint64_t value, std::vector<uint8_t>& out) {
+    while (value >= 0x80) {
+      out.push_back(static_cast<uint8_t>(value) | 0x80);
+      value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+  }
+
+  bool decodeVarint(const std::vector<uint8_t>& data, size_t& pos, uint64_t& value) {
+    value = 0;
+    unsigned shift = 0;
+    while (pos < data.size() && shift <= 63) {
+      const uint8_t byte = data[pos++];
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+      shift += 7;
+    }
+    return false;
+  }
+
+  uint64_t zigzagEncode(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+  }
+
+  int64_t zigzagDecode(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+
+  bool keyLess(const OcTreeKey& a, const OcTreeKey& b) {
+    if (a[0] != b[0]) return a[0] < b[0];
+    if (a[1] != b[1]) return a[1] < b[1];
+    return a[2] < b[2];
+  }
+}
+
 TrackingOctomapServer::TrackingOctomapServer(const std::string& filename) :
 	    OctomapServer()
 {
@@ -62,6 +101,7 @@ TrackingOctomapServer::TrackingOctomapServer(const std::string& filename) :
   private_nh.param("track_changes", track_changes, false);
   private_nh.param("listen_changes", listen_changes, false);
   private_nh.param("min_change_pub", min_change_pub, 0);
+  private_nh.param("compact_changes", compact_changes, false);
 
   if (track_changes && listen_changes) {
     ROS_WARN("OctoMapServer: It might not be useful to publish changes and at the same time listen to them."
@@ -71,15 +111,23 @@ TrackingOctomapServer::TrackingOctomapServer(const std::string& filename) :
 
   if (track_changes) {
     ROS_INFO("starting server");
-    pubChangeSet = private_nh.advertise<sensor_msgs::PointCloud2>(
-        changeSetTopic, 1);
+    if (compact_changes)
+      pubChangeSet = private_nh.advertise<std_msgs::UInt8MultiArray>(
+          changeSetTopic, 1);
+    else
+      pubChangeSet = private_nh.advertise<sensor_msgs::PointCloud2>(
+          changeSetTopic, 1);
     m_octree->enableChangeDetection(true);
   }
 
   if (listen_changes) {
     ROS_INFO("starting client");
-    subChangeSet = private_nh.subscribe(changeSetTopic, 1,
-                                        &TrackingOctomapServer::trackCallback, this);
+    if (compact_changes)
+      subChangeSet = private_nh.subscribe(changeSetTopic, 1,
+                                          &TrackingOctomapServer::trackCompactCallback, this);
+    else
+      subChangeSet = private_nh.subscribe(changeSetTopic, 1,
+                                          &TrackingOctomapServer::trackCallback, this);
   }
 }
 
@@ -95,6 +143,11 @@ void TrackingOctomapServer::insertScan(const tf::Point & sensorOrigin, const PCL
 }
 
 void TrackingOctomapServer::trackChanges() {
+  if (compact_changes) {
+    trackChangesCompact();
+    return;
+  }
+
   KeyBoolMap::const_iterator startPnt = m_octree->changedKeysBegin();
   KeyBoolMap::const_iterator endPnt = m_octree->changedKeysEnd();
 
@@ -138,6 +191,81 @@ void TrackingOctomapServer::trackChanges() {
   }
 }
 
+void TrackingOctomapServer::trackChangesCompact() {
+  // Collect and sort the changed keys so consecutive keys delta-encode to
+  // tiny varints.
+  std::vector<OcTreeKey> keys;
+  for (KeyBoolMap::const_iterator it = m_octree->changedKeysBegin(),
+       end = m_octree->changedKeysEnd(); it != end; ++it)
+    keys.push_back(it->first);
+
+  if (static_cast<int>(keys.size()) <= min_change_pub)
+    return;
+
+  std::sort(keys.begin(), keys.end(), keyLess);
+
+  std_msgs::UInt8MultiArray msg;
+  msg.data.reserve(5 * keys.size());
+
+  encodeVarint(keys.size(), msg.data);
+
+  OcTreeKey previous;
+  previous[0] = previous[1] = previous[2] = 0;
+  for (size_t i = 0; i < keys.size(); i++) {
+    const OcTreeKey& key = keys[i];
+    for (unsigned d = 0; d < 3; d++)
+      encodeVarint(zigzagEncode(static_cast<int64_t>(key[d])
+                                - static_cast<int64_t>(previous[d])),
+                   msg.data);
+
+    OcTreeNode* node = m_octree->search(key);
+    msg.data.push_back((node && m_octree->isNodeOccupied(node)) ? 1 : 0);
+    previous = key;
+  }
+
+  pubChangeSet.publish(msg);
+  ROS_DEBUG("[server] sending %d changed entries in %d bytes",
+            (int)keys.size(), (int)msg.data.size());
+
+  m_octree->resetChangeDetection();
+}
+
+void TrackingOctomapServer::trackCompactCallback(std_msgs::UInt8MultiArrayConstPtr msg) {
+  size_t pos = 0;
+  uint64_t count = 0;
+  if (!decodeVarint(msg->data, pos, count)) {
+    ROS_ERROR("[client] truncated compact change stream");
+    return;
+  }
+
+  OcTreeKey key;
+  key[0] = key[1] = key[2] = 0;
+  uint64_t decoded = 0;
+  for (; decoded < count; decoded++) {
+    uint64_t delta;
+    bool ok = true;
+    for (unsigned d = 0; d < 3 && ok; d++) {
+      ok = decodeVarint(msg->data, pos, delta);
+      if (ok)
+        key[d] = static_cast<unsigned short>(
+          static_cast<int64_t>(key[d]) + zigzagDecode(delta));
+    }
+
+    if (!ok || pos >= msg->data.size()) {
+      ROS_ERROR("[client] truncated compact change stream");
+      break;
+    }
+
+    // Saturating log-odds update, matching the point-cloud client path.
+    const bool occupied = msg->data[pos++] != 0;
+    m_octree->updateNode(key, occupied ? 1000.0f : -1000.0f, false);
+  }
+
+  m_octree->updateInnerOccupancy();
+  ROS_DEBUG("[client] applied %d compact changes, octomap size: %d",
+            (int)decoded, (int)m_octree->calcNumNodes());
+}
+
 void TrackingOctomapServer::trackCallback(sensor_msgs::PointCloud2Ptr cloud) {
   pcl::PointCloud<pcl::PointXYZI> cells;
   pcl::fromROSMsg(*cloud, cells);
@@ -68,7 +68,12 @@ int main(int argc, char** argv){
 
 
   try{
-    ros::spin();
+    // Two spinner threads: scan insertion keeps running while a map
+    // service serializes its snapshot. Tree access is serialized by the
+    // server's internal tree mutex.
+    ros::AsyncSpinner spinner(2);
+    spinner.start();
+    ros::waitForShutdown();
   }catch(std::runtime_error& e){
     ROS_ERROR("octomap_server exception: %s", e.what());
     return -1;
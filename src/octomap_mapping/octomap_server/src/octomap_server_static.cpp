@@ -32,19 +32,48 @@
 #include <octomap/octomap.h>
 #include <fstream>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <vector>
+
 #include <octomap_msgs/GetOctomap.h>
 using octomap_msgs::GetOctomap;
 
-#define USAGE "\nUSAGE: octomap_server_static <mapfile.[bt|ot]>\n" \
-		"  mapfile.bt: OctoMap filename to be loaded (.bt: binary tree, .ot: general octree)\n"
+#define USAGE "\nUSAGE: octomap_server_static <mapfile.[bt|ot|om]>\n" \
+		"  mapfile.bt: OctoMap filename to be loaded (.bt: binary tree, .ot: general octree)\n" \
+		"  mapfile.om: mmap-served map (serves requests straight from the mapped file)\n" \
+		"       octomap_server_static <mapfile.[bt|ot]> <out.om>\n" \
+		"  convert a map into the mmap format and exit\n"
 
 using namespace std;
 using namespace octomap;
 
+// On-disk layout of the mmap-served map format: a header and the tree id
+// string, then the pre-serialized octomap message payload starting on its
+// own page so the kernel can fault it in lazily.
+struct MmapMapHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint8_t binary;
+  uint8_t pad[7];
+  double resolution;
+  uint64_t id_length;
+  uint64_t data_offset;
+  uint64_t data_length;
+};
+
+static const uint32_t kMmapMapMagic = 0x464d4d4f; // "OMMF"
+static const uint32_t kMmapMapVersion = 1;
+static const uint64_t kMmapMapAlignment = 4096;
+
 class OctomapServerStatic{
 public:
   OctomapServerStatic(const std::string& filename)
-    : m_octree(NULL), m_worldFrameId("/map")
+    : m_octree(NULL), m_worldFrameId("/map"),
+      m_mapped(NULL), m_mappedSize(0)
   {
 
     ros::NodeHandle private_nh("~");
@@ -59,8 +88,17 @@ public:
 
     std::string suffix = filename.substr(filename.length()-3, 3);
 
+    // .om files are mapped read-only and served without reconstruction:
+    if (suffix == ".om"){
+      if (!openMmapFile(filename)){
+        ROS_ERROR("Could not map octree file %s", filename.c_str());
+        exit(1);
+      }
+      ROS_INFO("Mapped octree type \"%s\" from file %s (%zu payload bytes)",
+               m_mappedId.c_str(), filename.c_str(), (size_t) m_mappedHeader->data_length);
+    }
     // .bt files only as OcTree, all other classes need to be in .ot files:
-    if (suffix == ".bt"){
+    else if (suffix == ".bt"){
       OcTree* octree = new OcTree(filename);
 
       m_octree = octree;
@@ -74,18 +112,19 @@ public:
       m_octree = dynamic_cast<AbstractOccupancyOcTree*>(tree);
 
     } else{
-      ROS_ERROR("Octree file does not have .bt or .ot extension");
+      ROS_ERROR("Octree file does not have .bt, .ot or .om extension");
       exit(1);
     }
 
-    if (!m_octree ){
-      ROS_ERROR("Could not read right octree class in file");
-      exit(1);
-    }
-
-    ROS_INFO("Read octree type \"%s\" from file %s", m_octree->getTreeType().c_str(), filename.c_str());
-    ROS_INFO("Octree resultion: %f, size: %zu", m_octree->getResolution(), m_octree->size());
+    if (!m_mapped){
+      if (!m_octree ){
+        ROS_ERROR("Could not read right octree class in file");
+        exit(1);
+      }
 
+      ROS_INFO("Read octree type \"%s\" from file %s", m_octree->getTreeType().c_str(), filename.c_str());
+      ROS_INFO("Octree resultion: %f, size: %zu", m_octree->getResolution(), m_octree->size());
+    }
 
     m_octomapBinaryService = m_nh.advertiseService("octomap_binary", &OctomapServerStatic::octomapBinarySrv, this);
     m_octomapFullService = m_nh.advertiseService("octomap_full", &OctomapServerStatic::octomapFullSrv, this);
@@ -93,8 +132,57 @@ public:
   }
 
   ~OctomapServerStatic(){
+    if (m_mapped)
+      munmap(const_cast<uint8_t*>(m_mapped), m_mappedSize);
+  }
+
+  /// Convert a loaded tree into the mmap-served format.
+  static bool writeMmapFile(const AbstractOccupancyOcTree* octree,
+                            bool binary, const std::string& outname){
+    if (!octree)
+      return false;
 
+    const OcTree* binaryTree = dynamic_cast<const OcTree*>(octree);
+    if (binary && !binaryTree)
+      return false;
 
+    std::vector<int8_t> data;
+    bool ok;
+    if (binary)
+      ok = octomap_msgs::binaryMapToMsgData(*binaryTree, data);
+    else
+      ok = octomap_msgs::fullMapToMsgData(*octree, data);
+    if (!ok)
+      return false;
+
+    const std::string id = binary ? "OcTree" : octree->getTreeType();
+
+    MmapMapHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kMmapMapMagic;
+    header.version = kMmapMapVersion;
+    header.binary = binary ? 1 : 0;
+    header.resolution = octree->getResolution();
+    header.id_length = id.size();
+    header.data_offset =
+      ((sizeof(header) + id.size() + kMmapMapAlignment - 1)
+       / kMmapMapAlignment) * kMmapMapAlignment;
+    header.data_length = data.size();
+
+    std::ofstream file(outname.c_str(), std::ios::binary);
+    if (!file)
+      return false;
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(id.c_str(), id.size());
+
+    // pad the payload out to its own page:
+    std::vector<char> padding(header.data_offset - sizeof(header) - id.size(), 0);
+    file.write(padding.empty() ? "" : &padding[0], padding.size());
+    if (!data.empty())
+      file.write(reinterpret_cast<const char*>(&data[0]), data.size());
+
+    return file.good();
   }
 
   bool octomapBinarySrv(GetOctomap::Request  &req,
@@ -103,6 +191,10 @@ public:
     ROS_INFO("Sending binary map data on service request");
     res.map.header.frame_id = m_worldFrameId;
     res.map.header.stamp = ros::Time::now();
+
+    if (m_mapped)
+      return fillFromMapped(res, true);
+
     if (!octomap_msgs::binaryMapToMsg(*m_octree, res.map))
       return false;
 
@@ -116,6 +208,8 @@ public:
     res.map.header.frame_id = m_worldFrameId;
     res.map.header.stamp = ros::Time::now();
 
+    if (m_mapped)
+      return fillFromMapped(res, false);
 
     if (!octomap_msgs::fullMapToMsg(*m_octree, res.map))
       return false;
@@ -124,11 +218,77 @@ public:
   }
 
 private:
+  bool openMmapFile(const std::string& filename){
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0
+        || static_cast<size_t>(file_stat.st_size) < sizeof(MmapMapHeader)){
+      close(fd);
+      return false;
+    }
+
+    void* mapped = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+      return false;
+
+    m_mapped = static_cast<const uint8_t*>(mapped);
+    m_mappedSize = file_stat.st_size;
+    m_mappedHeader = reinterpret_cast<const MmapMapHeader*>(m_mapped);
+
+    // subtraction-style bounds checks, so corrupt offsets cannot wrap:
+    if (m_mappedHeader->magic != kMmapMapMagic
+        || m_mappedHeader->version != kMmapMapVersion
+        || m_mappedHeader->data_offset > m_mappedSize
+        || m_mappedHeader->data_length > m_mappedSize - m_mappedHeader->data_offset
+        || m_mappedHeader->id_length > m_mappedSize - sizeof(MmapMapHeader)){
+      munmap(mapped, m_mappedSize);
+      m_mapped = NULL;
+      return false;
+    }
+
+    m_mappedId.assign(reinterpret_cast<const char*>(m_mapped) + sizeof(MmapMapHeader),
+                      m_mappedHeader->id_length);
+    return true;
+  }
+
+  /// Serve a map request by copying the pre-serialized payload out of the
+  /// mapping; no octree is ever reconstructed.
+  bool fillFromMapped(GetOctomap::Response& res, bool wantBinary){
+    if ((m_mappedHeader->binary != 0) != wantBinary){
+      ROS_ERROR("Mapped file stores a %s map, cannot serve the %s service",
+                m_mappedHeader->binary ? "binary" : "full",
+                wantBinary ? "binary" : "full");
+      return false;
+    }
+
+    res.map.id = m_mappedId;
+    res.map.resolution = m_mappedHeader->resolution;
+    res.map.binary = m_mappedHeader->binary != 0;
+
+    const int8_t* payload =
+      reinterpret_cast<const int8_t*>(m_mapped + m_mappedHeader->data_offset);
+    res.map.data.assign(payload, payload + m_mappedHeader->data_length);
+    return true;
+  }
+
   ros::ServiceServer m_octomapBinaryService, m_octomapFullService;
   ros::NodeHandle m_nh;
   std::string m_worldFrameId;
   AbstractOccupancyOcTree* m_octree;
 
+  // mmap-served map state:
+  const uint8_t* m_mapped;
+  size_t m_mappedSize;
+  const MmapMapHeader* m_mappedHeader;
+  std::string m_mappedId;
+
+public:
+  /// Expose conversion for the command-line convert mode.
+  const AbstractOccupancyOcTree* octree() const { return m_octree; }
 };
 
 int main(int argc, char** argv){
@@ -137,6 +297,27 @@ int main(int argc, char** argv){
 
   if (argc == 2)
     mapFilename = std::string(argv[1]);
+  else if (argc == 3){
+    // convert mode: load the map, write the mmap format, exit.
+    mapFilename = std::string(argv[1]);
+    const std::string outFilename(argv[2]);
+    const bool binary =
+      mapFilename.length() > 3
+      && mapFilename.substr(mapFilename.length()-3, 3) == ".bt";
+
+    try{
+      OctomapServerStatic ms(mapFilename);
+      if (!OctomapServerStatic::writeMmapFile(ms.octree(), binary, outFilename)){
+        ROS_ERROR("Could not write mmap map file %s", outFilename.c_str());
+        exit(2);
+      }
+      ROS_INFO("Wrote mmap map file %s", outFilename.c_str());
+    }catch(std::runtime_error& e){
+      ROS_ERROR("octomap_server_static exception: %s", e.what());
+      exit(2);
+    }
+    exit(0);
+  }
   else{
     ROS_ERROR("%s", USAGE);
     exit(1);
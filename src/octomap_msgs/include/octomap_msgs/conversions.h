@@ -41,25 +41,209 @@
 #include <octomap/octomap.h>
 #include <octomap_msgs/Octomap.h>
 
-// new conversion functions  
+#include <streambuf>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <zlib.h>
+
+// new conversion functions
 namespace octomap_msgs{
-  // Note: fullMsgDataToMap() deleted, potentially causes confusion 
+  // Note: fullMsgDataToMap() deleted, potentially causes confusion
   // and (silent) errors in deserialization
-  
+
+  /**
+   * @brief Stream buffer reading the message byte vector in place, so the
+   * octree deserializer consumes msg.data directly instead of through a
+   * stringstream copy (which doubles peak memory on multi-MB maps).
+   */
+  class VectorInStream : public std::streambuf {
+  public:
+    VectorInStream(const std::vector<int8_t>& data) {
+      if (data.empty())
+        return;
+
+      char* begin = const_cast<char*>(reinterpret_cast<const char*>(&data[0]));
+      setg(begin, begin, begin + data.size());
+    }
+  };
+
+  /**
+   * @brief Stream buffer appending directly into the outgoing message
+   * buffer; std::vector growth is exponential, so serialization never
+   * round-trips through a stringstream plus a full copy.
+   */
+  class VectorOutStream : public std::streambuf {
+  public:
+    VectorOutStream(std::vector<int8_t>& data) : data_(data) {
+      data_.clear();
+    }
+
+  protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) {
+      data_.insert(data_.end(), s, s + n);
+      return n;
+    }
+
+    int overflow(int c) {
+      if (c != traits_type::eof())
+        data_.push_back(static_cast<int8_t>(c));
+      return c;
+    }
+
+  private:
+    std::vector<int8_t>& data_;
+  };
+
+  /// Marker appended to msg.id when msg.data carries a zlib stream.
+  static const char kCompressedIdSuffix[] = ";zlib";
+
+  /// Strip the compression marker from a message id, if present.
+  static inline bool idIsCompressed(const std::string& id, std::string& bare_id){
+    const std::string suffix(kCompressedIdSuffix);
+    if (id.size() > suffix.size()
+        && id.compare(id.size() - suffix.size(), suffix.size(), suffix) == 0){
+      bare_id = id.substr(0, id.size() - suffix.size());
+      return true;
+    }
+    bare_id = id;
+    return false;
+  }
+
+  /**
+   * @brief Stream buffer deflating straight into the outgoing message
+   * buffer: the serializer's writes are compressed as they stream, with
+   * no uncompressed intermediate buffer. Call Finish() before using the
+   * output.
+   */
+  class ZlibOutStream : public std::streambuf {
+  public:
+    ZlibOutStream(std::vector<int8_t>& data) : data_(data), finished_(false) {
+      data_.clear();
+      memset(&stream_, 0, sizeof(stream_));
+      deflateInit(&stream_, Z_DEFAULT_COMPRESSION);
+    }
+
+    ~ZlibOutStream() {
+      Finish();
+      deflateEnd(&stream_);
+    }
+
+    /// Flush the trailing compressed bytes. Returns false on codec error.
+    bool Finish() {
+      if (finished_)
+        return true;
+      finished_ = true;
+
+      int ret = Z_OK;
+      do {
+        ret = Pump(NULL, 0, Z_FINISH);
+      } while (ret == Z_OK);
+      return ret == Z_STREAM_END;
+    }
+
+  protected:
+    std::streamsize xsputn(const char* s, std::streamsize n) {
+      Pump(s, static_cast<size_t>(n), Z_NO_FLUSH);
+      return n;
+    }
+
+    int overflow(int c) {
+      if (c != traits_type::eof()) {
+        const char byte = static_cast<char>(c);
+        Pump(&byte, 1, Z_NO_FLUSH);
+      }
+      return c;
+    }
+
+  private:
+    int Pump(const char* input, size_t length, int flush) {
+      stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+      stream_.avail_in = static_cast<uInt>(length);
+
+      int ret = Z_OK;
+      do {
+        char chunk[16384];
+        stream_.next_out = reinterpret_cast<Bytef*>(chunk);
+        stream_.avail_out = sizeof(chunk);
+        ret = deflate(&stream_, flush);
+        data_.insert(data_.end(), chunk,
+                     chunk + sizeof(chunk) - stream_.avail_out);
+      } while (stream_.avail_out == 0);
+
+      return ret;
+    }
+
+    std::vector<int8_t>& data_;
+    z_stream stream_;
+    bool finished_;
+  };
+
+  /**
+   * @brief Stream buffer inflating the message byte vector on the fly:
+   * the octree deserializer reads decompressed bytes chunk by chunk, with
+   * no fully-inflated second buffer.
+   */
+  class ZlibInStream : public std::streambuf {
+  public:
+    ZlibInStream(const std::vector<int8_t>& data) {
+      memset(&stream_, 0, sizeof(stream_));
+      inflateInit(&stream_);
+      stream_.next_in = data.empty() ? NULL :
+        reinterpret_cast<Bytef*>(const_cast<int8_t*>(&data[0]));
+      stream_.avail_in = static_cast<uInt>(data.size());
+    }
+
+    ~ZlibInStream() {
+      inflateEnd(&stream_);
+    }
+
+  protected:
+    int underflow() {
+      if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+      stream_.next_out = reinterpret_cast<Bytef*>(chunk_);
+      stream_.avail_out = sizeof(chunk_);
+      const int ret = inflate(&stream_, Z_NO_FLUSH);
+      if ((ret != Z_OK && ret != Z_STREAM_END)
+          || stream_.avail_out == sizeof(chunk_))
+        return traits_type::eof();
+
+      setg(chunk_, chunk_, chunk_ + sizeof(chunk_) - stream_.avail_out);
+      return traits_type::to_int_type(*gptr());
+    }
+
+  private:
+    z_stream stream_;
+    char chunk_[16384];
+  };
+
   /**
    * @brief Creates a new octree by deserializing from a message that contains the
    * full map information (i.e., binary is false) and returns an AbstractOcTree*
    * to it. You will need to free the memory when you're done.
    */  
   static inline octomap::AbstractOcTree* fullMsgToMap(const Octomap& msg){
-    octomap::AbstractOcTree* tree = octomap::AbstractOcTree::createTree(msg.id, msg.resolution);    
+    std::string bare_id;
+    const bool compressed = idIsCompressed(msg.id, bare_id);
+
+    octomap::AbstractOcTree* tree = octomap::AbstractOcTree::createTree(bare_id, msg.resolution);
     if (tree){
-      std::stringstream datastream;
       assert(msg.data.size() > 0);
-      datastream.write((const char*) &msg.data[0], msg.data.size());
-      tree->readData(datastream);          
+      if (compressed){
+        ZlibInStream buffer(msg.data);
+        std::istream datastream(&buffer);
+        tree->readData(datastream);
+      } else {
+        VectorInStream buffer(msg.data);
+        std::istream datastream(&buffer);
+        tree->readData(datastream);
+      }
     }
-    
+
     return tree;      
   }
   
@@ -70,15 +254,23 @@ namespace octomap_msgs{
    * You will need to free the memory when you're done.
    */
   static inline octomap::OcTree* binaryMsgToMap(const Octomap& msg){
-    if (msg.id != "OcTree" || !msg.binary)
+    std::string bare_id;
+    const bool compressed = idIsCompressed(msg.id, bare_id);
+    if (bare_id != "OcTree" || !msg.binary)
       return NULL;
     
-    octomap::OcTree* octree = new octomap::OcTree(msg.resolution);    
-    std::stringstream datastream;
+    octomap::OcTree* octree = new octomap::OcTree(msg.resolution);
     assert(msg.data.size() > 0);
-    datastream.write((const char*) &msg.data[0], msg.data.size());
-    octree->readBinaryData(datastream);          
-    
+    if (compressed){
+      ZlibInStream buffer(msg.data);
+      std::istream datastream(&buffer);
+      octree->readBinaryData(datastream);
+    } else {
+      VectorInStream buffer(msg.data);
+      std::istream datastream(&buffer);
+      octree->readBinaryData(datastream);
+    }
+
     return octree;      
   }
 
@@ -97,11 +289,8 @@ namespace octomap_msgs{
       return fullMsgToMap(msg);
   }
 
-  // conversions via stringstream
-  
-  // TODO: read directly into buffer? see
-  // http://stackoverflow.com/questions/132358/how-to-read-file-content-into-istringstream
-  
+  // conversions directly into / out of the message buffer
+
   /**
    * @brief Serialization of an octree into binary data e.g. for messages and services.
    * Compact binary version (stores only max-likelihood free or occupied, .bt file format).
@@ -111,13 +300,9 @@ namespace octomap_msgs{
    */
   template <class OctomapT>
   static inline bool binaryMapToMsgData(const OctomapT& octomap, std::vector<int8_t>& mapData){
-    std::stringstream datastream;
-    if (!octomap.writeBinaryConst(datastream))
-      return false;
-    
-    std::string datastring = datastream.str();
-    mapData = std::vector<int8_t>(datastring.begin(), datastring.end());
-    return true;
+    VectorOutStream buffer(mapData);
+    std::ostream datastream(&buffer);
+    return octomap.writeBinaryConst(datastream);
   }
   
   /**
@@ -129,13 +314,9 @@ namespace octomap_msgs{
    */
   template <class OctomapT>
   static inline bool fullMapToMsgData(const OctomapT& octomap, std::vector<int8_t>& mapData){
-    std::stringstream datastream;
-    if (!octomap.write(datastream))
-      return false;
-    
-    std::string datastring = datastream.str();
-    mapData = std::vector<int8_t>(datastring.begin(), datastring.end());
-    return true;
+    VectorOutStream buffer(mapData);
+    std::ostream datastream(&buffer);
+    return octomap.write(datastream);
   }
   
   /**
@@ -151,13 +332,9 @@ namespace octomap_msgs{
     msg.id = octomap.getTreeType();
     msg.binary = true;
     
-    std::stringstream datastream;
-    if (!octomap.writeBinaryData(datastream))
-      return false;
-    
-    std::string datastring = datastream.str();
-    msg.data = std::vector<int8_t>(datastring.begin(), datastring.end());
-    return true;
+    VectorOutStream buffer(msg.data);
+    std::ostream datastream(&buffer);
+    return octomap.writeBinaryData(datastream);
   }
   
   /**
@@ -173,13 +350,47 @@ namespace octomap_msgs{
     msg.id = octomap.getTreeType();
     msg.binary = false;
     
-    std::stringstream datastream;
+    VectorOutStream buffer(msg.data);
+    std::ostream datastream(&buffer);
+    return octomap.writeData(datastream);
+  }
+
+  /**
+   * @brief As binaryMapToMsg, but with the payload compressed in a single
+   * streaming pass. The compression is flagged by a suffix on msg.id, and
+   * binaryMsgToMap decompresses transparently. Octree streams typically
+   * shrink 5-10x, far cheaper than the link bandwidth they save.
+   * @return success of serialization
+   */
+  template <class OctomapT>
+  static inline bool binaryMapToMsgCompressed(const OctomapT& octomap, Octomap& msg){
+    msg.resolution = octomap.getResolution();
+    msg.id = octomap.getTreeType() + kCompressedIdSuffix;
+    msg.binary = true;
+
+    ZlibOutStream buffer(msg.data);
+    std::ostream datastream(&buffer);
+    if (!octomap.writeBinaryData(datastream))
+      return false;
+    return buffer.Finish();
+  }
+
+  /**
+   * @brief As fullMapToMsg, but with the payload compressed in a single
+   * streaming pass; fullMsgToMap decompresses transparently.
+   * @return success of serialization
+   */
+  template <class OctomapT>
+  static inline bool fullMapToMsgCompressed(const OctomapT& octomap, Octomap& msg){
+    msg.resolution = octomap.getResolution();
+    msg.id = octomap.getTreeType() + kCompressedIdSuffix;
+    msg.binary = false;
+
+    ZlibOutStream buffer(msg.data);
+    std::ostream datastream(&buffer);
     if (!octomap.writeData(datastream))
       return false;
-    
-    std::string datastring = datastream.str();
-    msg.data = std::vector<int8_t>(datastring.begin(), datastring.end());
-    return true;
+    return buffer.Finish();
   }
 
 }
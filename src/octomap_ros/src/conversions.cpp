@@ -50,18 +50,30 @@ namespace octomap {
    * @param cloud
    */
   void pointsOctomapToPointCloud2(const point3d_list& points, sensor_msgs::PointCloud2& cloud){
-    // make sure the channel is valid
+    // make sure the channel is valid, and record the field layout
     std::vector<sensor_msgs::PointField>::const_iterator field_iter = cloud.fields.begin(), field_end =
         cloud.fields.end();
     bool has_x, has_y, has_z;
     has_x = has_y = has_z = false;
+    int offset_x, offset_y, offset_z;
+    offset_x = offset_y = offset_z = -1;
+    bool xyz_float = true;
     while (field_iter != field_end) {
-      if ((field_iter->name == "x") || (field_iter->name == "X"))
+      if ((field_iter->name == "x") || (field_iter->name == "X")) {
         has_x = true;
-      if ((field_iter->name == "y") || (field_iter->name == "Y"))
+        offset_x = field_iter->offset;
+        xyz_float = xyz_float && (field_iter->datatype == sensor_msgs::PointField::FLOAT32);
+      }
+      if ((field_iter->name == "y") || (field_iter->name == "Y")) {
         has_y = true;
-      if ((field_iter->name == "z") || (field_iter->name == "Z"))
+        offset_y = field_iter->offset;
+        xyz_float = xyz_float && (field_iter->datatype == sensor_msgs::PointField::FLOAT32);
+      }
+      if ((field_iter->name == "z") || (field_iter->name == "Z")) {
         has_z = true;
+        offset_z = field_iter->offset;
+        xyz_float = xyz_float && (field_iter->datatype == sensor_msgs::PointField::FLOAT32);
+      }
       ++field_iter;
     }
 
@@ -71,6 +83,21 @@ namespace octomap {
     sensor_msgs::PointCloud2Modifier pcd_modifier(cloud);
     pcd_modifier.resize(points.size());
 
+    // fast path: float32 xyz lets us write through raw pointers into the
+    // contiguous message buffer instead of three field iterators
+    if (xyz_float && !cloud.data.empty()) {
+      uint8_t* data = &cloud.data[0];
+      const uint32_t step = cloud.point_step;
+      size_t idx = 0;
+      for (point3d_list::const_iterator it = points.begin(); it != points.end(); ++it, ++idx) {
+        uint8_t* base = data + idx * step;
+        *reinterpret_cast<float*>(base + offset_x) = it->x();
+        *reinterpret_cast<float*>(base + offset_y) = it->y();
+        *reinterpret_cast<float*>(base + offset_z) = it->z();
+      }
+      return;
+    }
+
     sensor_msgs::PointCloud2Iterator<float> iter_x(cloud, "x");
     sensor_msgs::PointCloud2Iterator<float> iter_y(cloud, "y");
     sensor_msgs::PointCloud2Iterator<float> iter_z(cloud, "z");
@@ -90,7 +117,42 @@ namespace octomap {
    * @param octomapCloud
    */
   void pointCloud2ToOctomap(const sensor_msgs::PointCloud2& cloud, Pointcloud& octomapCloud){
-    octomapCloud.reserve(cloud.data.size() / cloud.point_step);
+    // exact size up front; invalid points only ever shrink it
+    octomapCloud.reserve(static_cast<size_t>(cloud.width) * cloud.height);
+
+    // fast path: float32 xyz read through raw pointers
+    int offset_x, offset_y, offset_z;
+    offset_x = offset_y = offset_z = -1;
+    bool xyz_float = true;
+    for (size_t i = 0; i < cloud.fields.size(); ++i) {
+      const sensor_msgs::PointField& field = cloud.fields[i];
+      if (field.name == "x") {
+        offset_x = field.offset;
+        xyz_float = xyz_float && (field.datatype == sensor_msgs::PointField::FLOAT32);
+      } else if (field.name == "y") {
+        offset_y = field.offset;
+        xyz_float = xyz_float && (field.datatype == sensor_msgs::PointField::FLOAT32);
+      } else if (field.name == "z") {
+        offset_z = field.offset;
+        xyz_float = xyz_float && (field.datatype == sensor_msgs::PointField::FLOAT32);
+      }
+    }
+
+    if (xyz_float && offset_x >= 0 && offset_y >= 0 && offset_z >= 0
+        && !cloud.data.empty()) {
+      const uint8_t* data = &cloud.data[0];
+      const uint32_t step = cloud.point_step;
+      const size_t num_points = static_cast<size_t>(cloud.width) * cloud.height;
+      for (size_t i = 0; i < num_points; ++i) {
+        const uint8_t* base = data + i * step;
+        const float x = *reinterpret_cast<const float*>(base + offset_x);
+        const float y = *reinterpret_cast<const float*>(base + offset_y);
+        const float z = *reinterpret_cast<const float*>(base + offset_z);
+        if (!std::isnan(x) && !std::isnan(y) && !std::isnan(z))
+          octomapCloud.push_back(x, y, z);
+      }
+      return;
+    }
 
     sensor_msgs::PointCloud2ConstIterator<float> iter_x(cloud, "x");
     sensor_msgs::PointCloud2ConstIterator<float> iter_y(cloud, "y");
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Microbenchmark suite for the path_planning hot paths: FLANN tree
+// insert/query throughput vs tree size, scene feasibility cost vs
+// obstacle count, RRT time-to-first-solution on a standardized scene,
+// and trajectory upsampling. Each result prints as one JSON line so runs
+// can be diffed between releases.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <path_planning/flann/flann_point_2dtree.h>
+#include <path_planning/geometry/point_2d.h>
+#include <path_planning/geometry/trajectory_2d.h>
+#include <path_planning/planning/rrt_planner_2d.h>
+#include <path_planning/robot/robot_2d_circular.h>
+#include <path_planning/scene/scene_2d_continuous.h>
+#include <path_planning/scene/obstacle_2d.h>
+#include <utils/math/random_generator.h>
+#include <utils/types/types.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <gflags/gflags.h>
+#include <glog/logging.h>
+
+namespace {
+  double NowSeconds() {
+    return std::chrono::duration_cast< std::chrono::duration<double> >(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void Report(const char* name, const char* parameter, int value,
+              double seconds, long iterations) {
+    printf("{\"benchmark\": \"%s\", \"%s\": %d, "
+           "\"iterations\": %ld, \"total_s\": %.6f, \"per_op_us\": %.3f}\n",
+           name, parameter, value, iterations, seconds,
+           1e6 * seconds / static_cast<double>(iterations));
+  }
+
+  // FLANN insert and query throughput at several tree sizes.
+  void BenchmarkFlannTree() {
+    math::RandomGenerator rng(0);
+    const int kTreeSizes[] = {1000, 10000, 100000};
+
+    for (size_t ii = 0; ii < sizeof(kTreeSizes) / sizeof(int); ii++) {
+      const int size = kTreeSizes[ii];
+
+      FlannPoint2DTree tree;
+      double start = NowSeconds();
+      for (int jj = 0; jj < size; jj++)
+        tree.AddPoint(Point2D::Create(rng.Double(), rng.Double()));
+      Report("flann_insert", "tree_size", size, NowSeconds() - start, size);
+
+      const int kNumQueries = 10000;
+      Point2D::Ptr nearest;
+      float nn_distance;
+      start = NowSeconds();
+      for (int jj = 0; jj < kNumQueries; jj++) {
+        Point2D::Ptr query = Point2D::Create(rng.Double(), rng.Double());
+        tree.NearestNeighbor(query, nearest, nn_distance);
+      }
+      Report("flann_query", "tree_size", size, NowSeconds() - start,
+             kNumQueries);
+    }
+  }
+
+  // Scene feasibility cost at several obstacle counts.
+  void BenchmarkSceneFeasibility() {
+    math::RandomGenerator rng(0);
+    const int kObstacleCounts[] = {100, 1000, 10000};
+
+    for (size_t ii = 0; ii < sizeof(kObstacleCounts) / sizeof(int); ii++) {
+      const int count = kObstacleCounts[ii];
+
+      std::vector<Obstacle2D::Ptr> obstacles;
+      for (int jj = 0; jj < count; jj++)
+        obstacles.push_back(Obstacle2D::Create(rng.Double(), rng.Double(),
+                                               0.005));
+      Scene2DContinuous scene(0.0, 1.0, 0.0, 1.0, obstacles);
+
+      const int kNumQueries = 100000;
+      double start = NowSeconds();
+      int feasible = 0;
+      for (int jj = 0; jj < kNumQueries; jj++) {
+        Point2D::Ptr query = Point2D::Create(rng.Double(), rng.Double());
+        feasible += scene.IsFeasible(query) ? 1 : 0;
+      }
+      Report("scene_is_feasible", "obstacle_count", count,
+             NowSeconds() - start, kNumQueries);
+      VLOG(1) << feasible << " feasible queries.";
+    }
+  }
+
+  // RRT time-to-first-solution on a standardized scene (fixed seed).
+  void BenchmarkRRTPlanner() {
+    math::RandomGenerator rng(12345);
+
+    std::vector<Obstacle2D::Ptr> obstacles;
+    for (int jj = 0; jj < 200; jj++)
+      obstacles.push_back(Obstacle2D::Create(rng.Double(), rng.Double(),
+                                             0.01));
+    Scene2DContinuous scene(0.0, 1.0, 0.0, 1.0, obstacles);
+    Robot2DCircular robot(scene, 0.005);
+
+    Point2D::Ptr origin = Point2D::Create(0.02, 0.02);
+    Point2D::Ptr goal = Point2D::Create(0.98, 0.98);
+
+    const int kNumPlans = 10;
+    double start = NowSeconds();
+    for (int jj = 0; jj < kNumPlans; jj++) {
+      RRTPlanner2D planner(robot, scene, origin, goal, 0.05);
+      planner.PlanTrajectory();
+    }
+    Report("rrt_first_solution", "num_obstacles", 200, NowSeconds() - start,
+           kNumPlans);
+  }
+
+  // Trajectory upsampling throughput.
+  void BenchmarkUpsample() {
+    math::RandomGenerator rng(0);
+
+    std::vector<Point2D::Ptr> points;
+    for (int jj = 0; jj < 100; jj++)
+      points.push_back(Point2D::Create(rng.Double(), rng.Double()));
+
+    const int kNumUpsamples = 1000;
+    double start = NowSeconds();
+    for (int jj = 0; jj < kNumUpsamples; jj++) {
+      Trajectory2D::Ptr path = Trajectory2D::Create(points);
+      path->Upsample(4);
+    }
+    Report("trajectory_upsample", "num_points", 100, NowSeconds() - start,
+           kNumUpsamples);
+  }
+} //\ namespace
+
+int main(int argc, char** argv) {
+  FLAGS_logtostderr = true;
+  FLAGS_minloglevel = 1;
+  google::InitGoogleLogging(argv[0]);
+
+  BenchmarkFlannTree();
+  BenchmarkSceneFeasibility();
+  BenchmarkRRTPlanner();
+  BenchmarkUpsample();
+
+  return 0;
+}
@@ -50,17 +50,34 @@
 #include <path_planning/scene/obstacle_2d.h>
 
 #include <flann/flann.h>
+#include <memory>
 #include <unordered_map>
+#include <unordered_set>
 
 class FlannObstacle2DTree {
  public:
-  FlannObstacle2DTree() {}
+  FlannObstacle2DTree() : kd_tree_(new FlannPoint2DTree()), generation_(0) {}
   ~FlannObstacle2DTree() {}
 
   // Add obstacles to the index.
   void AddObstacle(Obstacle2D::Ptr obstacle);
   void AddObstacles(std::vector<Obstacle2D::Ptr>& obstacles);
 
+  // Dynamic-scene support. Removal is lazy: a marker filters query
+  // results immediately, and the kd tree itself is only rebuilt (from
+  // the live set) once more than a quarter of its entries are dead, so
+  // rebuild cost amortizes over many updates.
+  bool RemoveObstacle(Obstacle2D::Ptr obstacle);
+
+  // Move = lazy removal plus re-registration at the new location.
+  // Returns the replacement obstacle (null when 'obstacle' was unknown).
+  Obstacle2D::Ptr MoveObstacle(Obstacle2D::Ptr obstacle, float new_x,
+                               float new_y);
+
+  // Incremented on every mutation. Cached results (e.g. a scene's
+  // broad-phase structures) built at an older generation are stale.
+  unsigned int Generation() const { return generation_; }
+
   // Queries the kd tree for the nearest neighbor of 'query'. Returns whether or
   // not a nearest neighbor was found, and if it was found, the nearest neighbor
   // and distance to the nearest neighbor.
@@ -73,8 +90,13 @@ class FlannObstacle2DTree {
                     float radius) const;
 
  private:
-  FlannPoint2DTree kd_tree_;
+  // Rebuild from the live set once too much of the index is dead.
+  void MaybeRebuild();
+
+  std::shared_ptr<FlannPoint2DTree> kd_tree_;
   std::unordered_map<Point2D::Ptr, Obstacle2D::Ptr> registry_; // to retrieve obstacle
+  std::unordered_set<Obstacle2D*> removed_; // lazy deletion markers
+  unsigned int generation_;
 };  //\class FlannObstacle2DTree
 
 // ------------------------ IMPLEMENTATION ------------------------------------ //
@@ -84,8 +106,58 @@ void FlannObstacle2DTree::AddObstacle(Obstacle2D::Ptr obstacle) {
   CHECK_NOTNULL(obstacle.get());
 
   Point2D::Ptr location = obstacle->GetLocation();
-  kd_tree_.AddPoint(location);
+  kd_tree_->AddPoint(location);
   registry_.emplace(location, obstacle);
+  generation_++;
+}
+
+// Mark an obstacle dead; queries skip it immediately.
+bool FlannObstacle2DTree::RemoveObstacle(Obstacle2D::Ptr obstacle) {
+  CHECK_NOTNULL(obstacle.get());
+
+  if (registry_.count(obstacle->GetLocation()) == 0 ||
+      removed_.count(obstacle.get()) > 0)
+    return false;
+
+  removed_.insert(obstacle.get());
+  generation_++;
+  MaybeRebuild();
+  return true;
+}
+
+// Move = lazy removal plus re-registration at the new location.
+Obstacle2D::Ptr FlannObstacle2DTree::MoveObstacle(Obstacle2D::Ptr obstacle,
+                                                  float new_x, float new_y) {
+  if (!RemoveObstacle(obstacle))
+    return Obstacle2D::Ptr();
+
+  Obstacle2D::Ptr moved =
+    Obstacle2D::Create(new_x, new_y, obstacle->GetRadius());
+  AddObstacle(moved);
+  return moved;
+}
+
+// Rebuild the kd tree from the live set once a quarter of it is dead.
+void FlannObstacle2DTree::MaybeRebuild() {
+  if (4 * removed_.size() <= registry_.size())
+    return;
+
+  std::vector<Obstacle2D::Ptr> live;
+  live.reserve(registry_.size() - removed_.size());
+  for (const auto& entry : registry_) {
+    if (removed_.count(entry.second.get()) == 0)
+      live.push_back(entry.second);
+  }
+
+  kd_tree_.reset(new FlannPoint2DTree());
+  registry_.clear();
+  removed_.clear();
+
+  for (auto& obstacle : live) {
+    Point2D::Ptr location = obstacle->GetLocation();
+    kd_tree_->AddPoint(location);
+    registry_.emplace(location, obstacle);
+  }
 }
 
 void FlannObstacle2DTree::AddObstacles(std::vector<Obstacle2D::Ptr>& obstacles) {
@@ -104,12 +176,45 @@ bool FlannObstacle2DTree::NearestNeighbor(Point2D::Ptr query,
 
   // Query kd_tree_.
   Point2D::Ptr nearest_point;
-  if (!kd_tree_.NearestNeighbor(query, nearest_point, nn_distance))
+  if (!kd_tree_->NearestNeighbor(query, nearest_point, nn_distance))
     return false;
 
   // Map from point back to obstacle.
   nearest = registry_.at(nearest_point);
-  return true;
+  if (removed_.count(nearest.get()) == 0)
+    return true;
+
+  // The nearest entry is lazily deleted: widen a radius search until a
+  // live obstacle appears (dead entries are bounded at a quarter of the
+  // index, so this terminates quickly in practice).
+  float radius = std::max(2.0f * nn_distance, 1e-3f);
+  const int kMaxDoublings = 16;
+  for (int attempt = 0; attempt < kMaxDoublings; ++attempt) {
+    std::vector<Obstacle2D::Ptr> candidates;
+    if (!RadiusSearch(query, candidates, radius))
+      return false;
+
+    float best_distance = -1.0;
+    Obstacle2D::Ptr best;
+    for (const auto& candidate : candidates) {
+      const float distance =
+        Point2D::DistancePointToPoint(query, candidate->GetLocation());
+      if (best == nullptr || distance < best_distance) {
+        best = candidate;
+        best_distance = distance;
+      }
+    }
+
+    if (best != nullptr) {
+      nearest = best;
+      nn_distance = best_distance;
+      return true;
+    }
+
+    radius *= 2.0f;
+  }
+
+  return false;
 }
 
 // Queries the kd tree for all neighbors of 'query' within the specified radius.
@@ -121,13 +226,16 @@ bool FlannObstacle2DTree::RadiusSearch(Point2D::Ptr query,
 
   // Query kd_tree_.
   std::vector<Point2D::Ptr> nearest_points;
-  if (!kd_tree_.RadiusSearch(query, nearest_points, radius))
+  if (!kd_tree_->RadiusSearch(query, nearest_points, radius))
     return false;
 
-  // Map from point back to obstacle.
+  // Map from point back to obstacle, skipping lazily-deleted entries.
   neighbors.clear();
-  for (size_t ii = 0; ii < nearest_points.size(); ii++)
-    neighbors.push_back(registry_.at(nearest_points[ii]));
+  for (size_t ii = 0; ii < nearest_points.size(); ii++) {
+    Obstacle2D::Ptr obstacle = registry_.at(nearest_points[ii]);
+    if (removed_.count(obstacle.get()) == 0)
+      neighbors.push_back(obstacle);
+  }
 
   return true;
 }
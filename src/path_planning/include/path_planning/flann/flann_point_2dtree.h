@@ -52,17 +52,24 @@
 #include <flann/flann.h>
 #include <glog/logging.h>
 #include <iostream>
+#include <memory>
+#include <algorithm>
 #include <cmath>
 
 class FlannPoint2DTree {
  public:
-  FlannPoint2DTree() {}
-  ~FlannPoint2DTree();
+  // The rebuild threshold controls how much the index may grow before
+  // FLANN rebalances the kd tree (e.g. 2 rebuilds at every doubling).
+  explicit FlannPoint2DTree(float rebuild_threshold = 2.0)
+    : rebuild_threshold_(rebuild_threshold),
+      block_capacity_(0), block_used_(0) {}
+  ~FlannPoint2DTree() {}
 
   // Number of points in the tree.
   int Size() const;
 
-  // Add points to the index.
+  // Add points to the index. AddPoints() inserts the whole batch through
+  // one FLANN call instead of one per point.
   void AddPoint(Point2D::Ptr point);
   void AddPoints(std::vector<Point2D::Ptr>& points);
 
@@ -72,27 +79,58 @@ class FlannPoint2DTree {
   bool NearestNeighbor(Point2D::Ptr query, Point2D::Ptr& nearest,
                        float& nn_distance) const;
 
+  // Answer a whole batch of nearest-neighbor queries through a single
+  // FLANN invocation.
+  bool NearestNeighbors(const std::vector<Point2D::Ptr>& queries,
+                        std::vector<Point2D::Ptr>& nearest,
+                        std::vector<float>& nn_distances) const;
+
   // Queries the kd tree for all neighbors of 'query' within the specified radius.
   // Returns whether or not the search exited successfully.
   bool RadiusSearch(Point2D::Ptr query, std::vector<Point2D::Ptr>& neighbors,
                     float radius) const;
 
  private:
+  // Reserve contiguous storage for 'count' points in the arena. FLANN
+  // keeps pointers into the rows it is given, so blocks are never
+  // reallocated or freed until the tree itself is destroyed.
+  double* AllocateRows(size_t count);
+
   std::shared_ptr< flann::Index< flann::L2<double> > > index_;
   std::vector<Point2D::Ptr> registry_; // to retrieve original points
 
+  // Query-context buffers reused across const queries, so the planner's
+  // steady-state lookups stop allocating.
+  mutable std::vector<double> query_buffer_;
+  mutable std::vector< std::vector<int> > nn_indices_;
+  mutable std::vector< std::vector<double> > nn_distances_;
+
+  // Arena blocks owning the point storage.
+  std::vector< std::unique_ptr<double[]> > blocks_;
+  size_t block_capacity_, block_used_; // doubles in the current block
+  float rebuild_threshold_;
+
 };  //\class FlannPoint2DTree
 
 // -------------------------- IMPLEMENTATION ------------------------------------ //
 
-FlannPoint2DTree::~FlannPoint2DTree() {
-  // Free memory from points in the kd tree.
-  if (index_ != nullptr) {
-    for (size_t ii = 0; ii < index_->size(); ++ii) {
-      double* point = index_->getPoint(ii);
-      delete[] point;
-    }
+// Reserve contiguous arena rows.
+double* FlannPoint2DTree::AllocateRows(size_t count) {
+  const size_t kNumColumns = 2;
+  const size_t needed = kNumColumns * count;
+
+  if (blocks_.empty() || block_used_ + needed > block_capacity_) {
+    // A new block: at least 1024 points, or the whole batch.
+    const size_t kMinBlockPoints = 1024;
+    block_capacity_ = kNumColumns * std::max(kMinBlockPoints, count);
+    block_used_ = 0;
+    blocks_.push_back(
+      std::unique_ptr<double[]>(new double[block_capacity_]));
   }
+
+  double* rows = blocks_.back().get() + block_used_;
+  block_used_ += needed;
+  return rows;
 }
 
 // Number of points in the tree.
@@ -107,11 +145,12 @@ void FlannPoint2DTree::AddPoint(Point2D::Ptr point) {
   // Add point to registry.
   registry_.push_back(point);
 
-  // Copy the input point into FLANN's Matrix type.
+  // Copy the input point into arena-backed rows.
   const int kNumColumns = 2;
-  flann::Matrix<double> flann_point(new double[kNumColumns], 1, kNumColumns);
-  flann_point[0][0] = point->x;
-  flann_point[0][1] = point->y;
+  double* row = AllocateRows(1);
+  row[0] = point->x;
+  row[1] = point->y;
+  flann::Matrix<double> flann_point(row, 1, kNumColumns);
 
   // If this is the first point in the index, create the index and exit.
   if (index_ == nullptr) {
@@ -123,17 +162,36 @@ void FlannPoint2DTree::AddPoint(Point2D::Ptr point) {
     return;
   }
 
-  // If the index is already created, add the data point to the index. Rebuild
-  // every time the index doubles in size to occasionally rebalance the kd tree.
-  const int kRebuildThreshold = 2;
-  index_->addPoints(flann_point, kRebuildThreshold);
+  // If the index is already created, add the data point to the index,
+  // rebalancing the kd tree whenever it grows past the rebuild threshold.
+  index_->addPoints(flann_point, rebuild_threshold_);
 }
 
-// Add points to the index.
+// Add a whole batch of points through a single FLANN insertion.
 void FlannPoint2DTree::AddPoints(std::vector<Point2D::Ptr>& points) {
-  for (auto& point : points) {
-    AddPoint(point);
+  if (points.empty())
+    return;
+
+  const int kNumColumns = 2;
+  double* rows = AllocateRows(points.size());
+  for (size_t ii = 0; ii < points.size(); ++ii) {
+    CHECK_NOTNULL(points[ii].get());
+    rows[kNumColumns * ii] = points[ii]->x;
+    rows[kNumColumns * ii + 1] = points[ii]->y;
+    registry_.push_back(points[ii]);
   }
+
+  flann::Matrix<double> flann_points(rows, points.size(), kNumColumns);
+
+  if (index_ == nullptr) {
+    const int kNumRandomizedKDTrees = 1;
+    index_.reset(new flann::Index< flann::L2<double> >(
+                 flann_points, flann::KDTreeIndexParams(kNumRandomizedKDTrees)));
+    index_->buildIndex();
+    return;
+  }
+
+  index_->addPoints(flann_points, rebuild_threshold_);
 }
 
 // Queries the kd tree for the nearest neighbor of 'query'.
@@ -147,31 +205,75 @@ bool FlannPoint2DTree::NearestNeighbor(Point2D::Ptr query, Point2D::Ptr& nearest
     return false;
   }
 
-  // Convert the input point to the FLANN format.
+  // Convert the input point to the FLANN format, through the reused
+  // query buffer (the old per-call matrix was also never freed).
   const int kNumColumns = 2;
-  flann::Matrix<double> flann_query(new double[kNumColumns], 1, kNumColumns);
-  flann_query[0][0] = query->x;
-  flann_query[0][1] = query->y;
-
-  // Search the kd tree for the nearest neighbor to the query.
-  std::vector< std::vector<int> > query_match_indices;
-  std::vector< std::vector<double> > query_distances;
+  query_buffer_.resize(kNumColumns);
+  query_buffer_[0] = query->x;
+  query_buffer_[1] = query->y;
+  flann::Matrix<double> flann_query(&query_buffer_[0], 1, kNumColumns);
 
+  // Search the kd tree for the nearest neighbor to the query. The result
+  // containers keep their capacity between calls.
   const int kOneNearestNeighbor = 1;
   int num_neighbors_found = index_->knnSearch(
-         flann_query, query_match_indices, query_distances, kOneNearestNeighbor,
+         flann_query, nn_indices_, nn_distances_, kOneNearestNeighbor,
          flann::SearchParams(flann::FLANN_CHECKS_UNLIMITED) /* no approx */);
 
   // If we found a nearest neighbor, assign output.
   if (num_neighbors_found > 0) {
-    nearest = registry_[ query_match_indices[0][0] ];
-    nn_distance = std::sqrt(query_distances[0][0]);
+    nearest = registry_[ nn_indices_[0][0] ];
+    nn_distance = std::sqrt(nn_distances_[0][0]);
     return true;
   }
 
   return false;
 }
 
+// Answer a whole batch of queries in one FLANN invocation.
+bool FlannPoint2DTree::NearestNeighbors(const std::vector<Point2D::Ptr>& queries,
+                                        std::vector<Point2D::Ptr>& nearest,
+                                        std::vector<float>& nn_distances) const {
+  nearest.clear();
+  nn_distances.clear();
+
+  if (index_ == nullptr) {
+    VLOG(1) << "Index has not been built. Points must be added before "
+            <<  "querying the kd tree";
+    return false;
+  }
+
+  if (queries.empty())
+    return true;
+
+  const int kNumColumns = 2;
+  query_buffer_.resize(kNumColumns * queries.size());
+  for (size_t ii = 0; ii < queries.size(); ++ii) {
+    CHECK_NOTNULL(queries[ii].get());
+    query_buffer_[kNumColumns * ii] = queries[ii]->x;
+    query_buffer_[kNumColumns * ii + 1] = queries[ii]->y;
+  }
+  flann::Matrix<double> flann_queries(&query_buffer_[0], queries.size(),
+                                      kNumColumns);
+
+  const int kOneNearestNeighbor = 1;
+  index_->knnSearch(flann_queries, nn_indices_, nn_distances_,
+                    kOneNearestNeighbor,
+                    flann::SearchParams(flann::FLANN_CHECKS_UNLIMITED));
+
+  nearest.reserve(queries.size());
+  nn_distances.reserve(queries.size());
+  for (size_t ii = 0; ii < queries.size(); ++ii) {
+    if (nn_indices_[ii].empty())
+      return false;
+
+    nearest.push_back(registry_[ nn_indices_[ii][0] ]);
+    nn_distances.push_back(std::sqrt(nn_distances_[ii][0]));
+  }
+
+  return true;
+}
+
 // Queries the kd tree for all neighbors of 'query' within the specified radius.
 // Returns whether or not the search exited successfully.
 bool FlannPoint2DTree::RadiusSearch(Point2D::Ptr query,
@@ -185,25 +287,24 @@ bool FlannPoint2DTree::RadiusSearch(Point2D::Ptr query,
     return false;
   }
 
-  // Convert the input point to the FLANN format.
+  // Convert the input point to the FLANN format, through the reused
+  // query buffer.
   const int kNumColumns = 2;
-  flann::Matrix<double> flann_query(new double[kNumColumns], 1, kNumColumns);
-  flann_query[0][0] = query->x;
-  flann_query[0][1] = query->y;
-
-  // Search the kd tree for the nearest neighbor to the query.
-  std::vector< std::vector<int> > query_match_indices;
-  std::vector< std::vector<double> > query_distances;
+  query_buffer_.resize(kNumColumns);
+  query_buffer_[0] = query->x;
+  query_buffer_[1] = query->y;
+  flann::Matrix<double> flann_query(&query_buffer_[0], 1, kNumColumns);
 
+  // Search the kd tree for all neighbors within the radius.
   int num_neighbors_found =
-    index_->radiusSearch(flann_query, query_match_indices,
-                         query_distances, static_cast<float>(radius),
+    index_->radiusSearch(flann_query, nn_indices_,
+                         nn_distances_, static_cast<float>(radius),
                          flann::SearchParams(flann::FLANN_CHECKS_UNLIMITED));
 
   // If we found a nearest neighbor, assign output.
   neighbors.clear();
   for (size_t ii = 0; ii < num_neighbors_found; ii++)
-    neighbors.push_back(registry_[ query_match_indices[0][ii] ]);
+    neighbors.push_back(registry_[ nn_indices_[0][ii] ]);
 
   return true;
 }
@@ -48,11 +48,95 @@
 
 #include <pcl/point_types.h>
 #include <glog/logging.h>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
 #include <cmath>
 
 // Helper functions for Point2D.
 namespace Point2D {
 
+  // Recycling pool behind Create(). Freed shared_ptr nodes go on a
+  // size-bucketed free list and are handed back out, so steady-state
+  // planning loops stop paying heap allocations and frees per sample.
+  // One shared, mutex-protected pool: short-lived planner worker threads
+  // (e.g. the bidirectional planner's) return every block they recycle,
+  // rather than stranding a per-thread free list at thread exit, and the
+  // uncontended lock is noise next to the collision checks each sample
+  // already pays for.
+  class Pool {
+  public:
+    static Pool& Instance() {
+      // Intentionally leaked: points released during static destruction
+      // must still find a live pool to return their blocks to.
+      static Pool* pool = new Pool();
+      return *pool;
+    }
+
+    void* Allocate(size_t size) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<void*>& free_list = free_lists_[size];
+        if (!free_list.empty()) {
+          void* block = free_list.back();
+          free_list.pop_back();
+          return block;
+        }
+      }
+
+      // Cold path: hit the heap outside the lock.
+      return ::operator new(size);
+    }
+
+    void Free(void* block, size_t size) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_lists_[size].push_back(block);
+    }
+
+  private:
+    Pool() {}
+
+    std::mutex mutex_;
+    std::unordered_map< size_t, std::vector<void*> > free_lists_;
+  };
+
+  // Minimal allocator routing single-object allocations (in particular
+  // the fused allocate_shared control-block-plus-point node) through the
+  // pool.
+  template<typename T>
+  class PoolAllocator {
+  public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    PoolAllocator() {}
+    template<typename U> PoolAllocator(const PoolAllocator<U>&) {}
+    template<typename U> struct rebind { typedef PoolAllocator<U> other; };
+
+    T* allocate(size_t n) {
+      if (n != 1)
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+      return static_cast<T*>(Pool::Instance().Allocate(sizeof(T)));
+    }
+
+    void deallocate(T* block, size_t n) {
+      if (n != 1) {
+        ::operator delete(block);
+        return;
+      }
+      Pool::Instance().Free(block, sizeof(T));
+    }
+
+    bool operator==(const PoolAllocator&) const { return true; }
+    bool operator!=(const PoolAllocator&) const { return false; }
+  };
+
   // Create a Point2D.
   Point2D::Ptr Create(float x, float y);
 
@@ -79,9 +163,12 @@ namespace Point2D {
 
 // --------------------------- IMPLEMENTATION ------------------------------ //
 
-// Create a Point2D.
+// Create a Point2D. allocate_shared fuses the control block and the
+// point into one pool node: one pooled allocation instead of two heap
+// allocations per point.
 Point2D::Ptr Point2D::Create(float x, float y) {
-  Point2D::Ptr point(new pcl::PointXY());
+  Point2D::Ptr point =
+    std::allocate_shared<pcl::PointXY>(PoolAllocator<pcl::PointXY>());
   point->x = x;
   point->y = y;
   return point;
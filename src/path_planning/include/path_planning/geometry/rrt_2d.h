@@ -45,13 +45,13 @@
 
 #include <path_planning/geometry/trajectory_2d.h>
 #include <path_planning/geometry/point_2d.h>
-#include <path_planning/geometry/node_2d.h>
 #include <path_planning/flann/flann_point_2dtree.h>
 
 #include <memory>
 #include <vector>
 #include <list>
 #include <unordered_map>
+#include <stdint.h>
 #include <glog/logging.h>
 
 // N-ary tree of Point2Ds.
@@ -77,8 +77,15 @@ class RRT2D {
   Trajectory2D::Ptr GetTrajectory(Point2D::Ptr goal);
 
  private:
-  Node2D::Ptr head_;
-  std::unordered_map<Point2D::Ptr, Node2D::Ptr> registry_;
+  // Contiguous tree storage: node ii's position lives in points_[ii] (the
+  // coordinates themselves sit in the FLANN index's arena), and its
+  // parent is parents_[ii]. Tracing a path walks an index array instead
+  // of chasing heap-scattered node pointers.
+  static const uint32_t kNoParent = 0xffffffffu;
+
+  std::vector<Point2D::Ptr> points_;
+  std::vector<uint32_t> parents_;
+  std::unordered_map<Point2D::Ptr, uint32_t> registry_; // point -> index
   FlannPoint2DTree kd_tree_;
 };
 
@@ -90,8 +97,9 @@ bool RRT2D::Insert(Point2D::Ptr point) {
 
   // Base case -- empty tree.
   if (registry_.size() == 0) {
-    head_ = Node2D::Create(point);
-    registry_.emplace(point, head_);
+    registry_.emplace(point, 0u);
+    points_.push_back(point);
+    parents_.push_back(kNoParent);
     kd_tree_.AddPoint(point);
     return true;
   }
@@ -102,14 +110,11 @@ bool RRT2D::Insert(Point2D::Ptr point) {
   // Find nearest point.
   Point2D::Ptr nearest = GetNearest(point);
 
-  // Make a new Node2D and insert.
-  Node2D::Ptr node = Node2D::Create(point);
-  Node2D::Ptr parent = registry_.at(nearest);
-  node->SetParent(parent);
-  parent->AddChild(node);
-
-  // Update the registry and add to the kdtree.
-  registry_.emplace(point, node);
+  // Append the new node with its parent's index.
+  const uint32_t parent_index = registry_.at(nearest);
+  registry_.emplace(point, static_cast<uint32_t>(points_.size()));
+  points_.push_back(point);
+  parents_.push_back(parent_index);
   kd_tree_.AddPoint(point);
 
   return true;
@@ -129,14 +134,11 @@ bool RRT2D::Insert(Point2D::Ptr point, Point2D::Ptr parent) {
   // Don't insert if the tree already contains this point.
   if (Contains(point)) return false;
 
-  // Make a new Node2D and insert.
-  Node2D::Ptr node = Node2D::Create(point);
-  Node2D::Ptr parent_node = registry_.at(parent);
-  node->SetParent(parent_node);
-  parent_node->AddChild(node);
-
-  // Update the registry and add to the kdtree.
-  registry_.emplace(point, node);
+  // Append the new node with its parent's index.
+  const uint32_t parent_index = registry_.at(parent);
+  registry_.emplace(point, static_cast<uint32_t>(points_.size()));
+  points_.push_back(point);
+  parents_.push_back(parent_index);
   kd_tree_.AddPoint(point);
 
   return true;
@@ -174,12 +176,12 @@ Trajectory2D::Ptr RRT2D::GetTrajectory(Point2D::Ptr goal) {
     return Trajectory2D::Ptr(nullptr);
   }
 
-  // Trace the tree and populate the path.
+  // Trace back through the parent index array and populate the path.
   std::list<Point2D::Ptr> trace;
-  Node2D::Ptr current_node = registry_.at(goal);
-  while (current_node) {
-    trace.push_front(current_node->GetData());
-    current_node = current_node->GetParent();
+  uint32_t current_index = registry_.at(goal);
+  while (current_index != kNoParent) {
+    trace.push_front(points_[current_index]);
+    current_index = parents_[current_index];
   }
 
   Trajectory2D::Ptr path = Trajectory2D::Create(trace);
@@ -73,8 +73,11 @@ class Trajectory2D {
   void Upsample(unsigned int k);
 
   // Compute the (time) derivative of the path, assuming uniform sampling.
-  // Calculate at the endpoints by implicit padding.
+  // Calculate at the endpoints by implicit padding. The reference
+  // overload writes into an existing trajectory, reusing its storage, so
+  // optimizer inner loops do not allocate a new trajectory per iteration.
   Trajectory2D::Ptr TimeDerivative();
+  void TimeDerivative(Trajectory2D& derivative);
 
   // Getters.
   double GetLength() const;
@@ -88,6 +91,9 @@ class Trajectory2D {
   std::vector<Point2D::Ptr> points_;
   double length_;
 
+  // Scratch buffer reused by Upsample across calls.
+  std::vector<Point2D::Ptr> upsample_scratch_;
+
   // Private constructors. Use factory methods instead.
   Trajectory2D();
   Trajectory2D(std::vector<Point2D::Ptr>& points);
@@ -167,30 +173,38 @@ void Trajectory2D::AddPoint(Point2D::Ptr point) {
 }
 
 // Upsample by adding k points linearly between each pair of points
-// in this Trajectory2D.
+// in this Trajectory2D. The output is sized exactly once, the scratch
+// buffer is reused across calls, and the length accumulates in the same
+// pass instead of needing a separate RecomputeLength sweep.
 void Trajectory2D::Upsample(unsigned int k) {
-  std::vector<Point2D::Ptr> old_points(points_);
-  points_.clear();
+  if (points_.size() < 2)
+    return;
+
+  upsample_scratch_.clear();
+  upsample_scratch_.reserve(points_.size() + (points_.size() - 1) * k);
+  length_ = 0.0;
 
-  for (size_t ii = 0; ii < old_points.size() - 1; ii++) {
-    Point2D::Ptr current_point = old_points[ii];
-    Point2D::Ptr next_point = old_points[ii + 1];
+  for (size_t ii = 0; ii < points_.size() - 1; ii++) {
+    Point2D::Ptr current_point = points_[ii];
+    Point2D::Ptr next_point = points_[ii + 1];
     double length = Point2D::DistancePointToPoint(current_point,
                                                   next_point);
     double step_size = length / static_cast<double>(k + 1);
 
-    points_.push_back(current_point);
+    upsample_scratch_.push_back(current_point);
     for (unsigned int jj = 1; jj <= k; jj++) {
-      Point2D::Ptr step =
+      upsample_scratch_.push_back(
         Point2D::StepToward(current_point, next_point,
-                            static_cast<double>(jj) * step_size);
-      points_.push_back(step);
+                            static_cast<double>(jj) * step_size));
     }
 
-    // Make sure to push back final point.
-    if (ii == old_points.size() - 1)
-      points_.push_back(next_point);
+    length_ += length;
   }
+
+  // Push back the final point (the old implementation dropped it).
+  upsample_scratch_.push_back(points_.back());
+
+  points_.swap(upsample_scratch_);
 }
 
 // Compute the first derivative of the path in time using a 1D symmetric
@@ -198,38 +212,49 @@ void Trajectory2D::Upsample(unsigned int k) {
 // endpoints with forward/backward differences.
 Trajectory2D::Ptr Trajectory2D::TimeDerivative() {
   Trajectory2D::Ptr derivative = Trajectory2D::Create();
+  TimeDerivative(*derivative);
+  return derivative;
+}
+
+// Compute the derivative into an existing trajectory, reusing its
+// storage and sizing the output exactly once.
+void Trajectory2D::TimeDerivative(Trajectory2D& derivative) {
+  CHECK(&derivative != this);
+
+  derivative.points_.clear();
+  derivative.length_ = 0.0;
 
   // Handle corner cases: size 0/1.
   if (points_.size() == 0) {
     VLOG(1) << "Caution! Tried to evaluate the derivative "
             << "of an empty Trajectory2D.";
-    return derivative;
+    return;
   }
 
   Point2D::Ptr zero = Point2D::Create(0.0, 0.0);
   if (points_.size() == 1) {
     VLOG(1) << "Caution! Tried to evaluate the derivative "
             << "of a Trajectory2D with only a single element.";
-    derivative->AddPoint(zero);
-    return derivative;
+    derivative.AddPoint(zero);
+    return;
   }
 
+  derivative.points_.reserve(points_.size());
+
   // Handle the first point.
   Point2D::Ptr diff = Point2D::Add(points_[1], points_[0], -1.0);
-  derivative->AddPoint(diff);
+  derivative.AddPoint(diff);
 
   // Handle middle points. Remember to divide by two for symmetric differences.
   for (size_t ii = 1; ii < points_.size() - 1; ii++) {
     diff = Point2D::Add(points_[ii + 1], points_[ii - 1], -1.0);
-    derivative->AddPoint(Point2D::Add(zero, diff, 0.5));
+    derivative.AddPoint(Point2D::Add(zero, diff, 0.5));
   }
 
   // Handle the last point.
   diff = Point2D::Add(points_[points_.size() - 1],
                       points_[points_.size() - 2], -1.0);
-  derivative->AddPoint(diff);
-
-  return derivative;
+  derivative.AddPoint(diff);
 }
 
 // Getters.
@@ -73,8 +73,25 @@ class OccupancyGrid2D {
   int GetNCols() const { return ncols_ ; }
   int GetTotalCount() const { return count_; }
 
-  // Operations on the grid.
+  // Incrementally-maintained aggregates: the fullest bin and the Shannon
+  // entropy (nats) of the occupancy distribution, each updated O(1) per
+  // insertion rather than recomputed by scanning the grid.
+  int GetMaxCount() const { return max_count_; }
+  void GetMaxCountBin(int& row, int& col) const {
+    row = max_row_;
+    col = max_col_;
+  }
+  float GetEntropy() const {
+    if (count_ == 0)
+      return 0.0;
+    return static_cast<float>(std::log(static_cast<double>(count_))
+                              - sum_n_log_n_ / static_cast<double>(count_));
+  }
+
+  // Operations on the grid. The bulk overload bins a whole contiguous
+  // batch in one pass.
   void Insert(Point2D::Ptr point);
+  void Insert(const std::vector<Point2D::Ptr>& points);
   int GetCountAt(Point2D::Ptr point) const;
   Point2D::Ptr GetBinCenter(Point2D::Ptr point) const;
 
@@ -93,8 +110,15 @@ class OccupancyGrid2D {
   int ncols_;
   int count_;
 
+  // Aggregates maintained across insertions.
+  int max_count_, max_row_, max_col_;
+  double sum_n_log_n_; // sum over bins of n * log(n)
+
   // Check if a point is valid.
   bool IsValidPoint(Point2D::Ptr point) const;
+
+  // Map a point to its bin, returning false when out of bounds.
+  bool BinIndices(Point2D::Ptr point, int& ii, int& jj) const;
 };
 
 // ---------------------------- IMPLEMENTATION --------------------------- //
@@ -104,7 +128,8 @@ OccupancyGrid2D::OccupancyGrid2D(float xmin, float xmax,
                                  float ymin, float ymax,
                                  float block_size)
 : xmin_(xmin), xmax_(xmax),
-  ymin_(ymin), ymax_(ymax), count_(0) {
+  ymin_(ymin), ymax_(ymax), count_(0),
+  max_count_(0), max_row_(0), max_col_(0), sum_n_log_n_(0.0) {
 
   // Set scene.
   scene_.SetBounds(xmin, xmax, ymin, ymax);
@@ -125,19 +150,28 @@ OccupancyGrid2D::OccupancyGrid2D(float xmin, float xmax,
 
 // Insert a point.
 void OccupancyGrid2D::Insert(Point2D::Ptr point) {
-  if (!IsValidPoint(point)) return;
+  int ii, jj;
+  if (!BinIndices(point, ii, jj)) return;
 
-  // Find the nearest bin and insert.
-  int jj = static_cast<int>((point->x - xmin_) / block_size_);
-  int ii = static_cast<int>((point->y - ymin_) / block_size_);
-  ii = nrows_ - ii - 1;
-  grid_(ii, jj)++;
+  const int old_count = grid_(ii, jj);
+  grid_(ii, jj) = old_count + 1;
 
-  // Increment count_.
+  // Increment count_ and fold the bin's change into the aggregates:
+  // n log n picks up the difference, and the max can only grow.
   count_++;
+  if (old_count > 0)
+    sum_n_log_n_ -= static_cast<double>(old_count) * std::log(old_count);
+  sum_n_log_n_ +=
+    static_cast<double>(old_count + 1) * std::log(old_count + 1);
+
+  if (old_count + 1 > max_count_) {
+    max_count_ = old_count + 1;
+    max_row_ = ii;
+    max_col_ = jj;
+  }
 
   // Add to scene if bin is empty.
-  if (grid_(ii, jj) == 1) {
+  if (old_count == 0) {
     Point2D::Ptr bin_center = GetBinCenter(point);
     Obstacle2D::Ptr obstacle =
       Obstacle2D::Create(bin_center->x, bin_center->y, 0.5 * block_size_);
@@ -145,6 +179,22 @@ void OccupancyGrid2D::Insert(Point2D::Ptr point) {
   }
 }
 
+// Insert a whole batch of points in one pass.
+void OccupancyGrid2D::Insert(const std::vector<Point2D::Ptr>& points) {
+  for (size_t ii = 0; ii < points.size(); ii++)
+    Insert(points[ii]);
+}
+
+// Map a point to its bin, returning false when out of bounds.
+bool OccupancyGrid2D::BinIndices(Point2D::Ptr point, int& ii, int& jj) const {
+  if (!IsValidPoint(point)) return false;
+
+  jj = static_cast<int>((point->x - xmin_) / block_size_);
+  ii = static_cast<int>((point->y - ymin_) / block_size_);
+  ii = nrows_ - ii - 1;
+  return true;
+}
+
 // Get number of points in the bin containing the specified point.
 int OccupancyGrid2D::GetCountAt(Point2D::Ptr point) const {
   if (!IsValidPoint(point)) return -1;
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file defines a bidirectional RRT planner: two trees grow
+// concurrently from the origin and the goal on separate threads, with a
+// join check after every extension. Each side must be given its own
+// Scene2DContinuous/Robot2DCircular pair (built over the same obstacles),
+// because the FLANN query contexts inside a scene are reused across calls
+// and are not safe to share between threads.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PATH_PLANNING_BIRRT_PLANNER_2D_H
+#define PATH_PLANNING_BIRRT_PLANNER_2D_H
+
+#include <path_planning/geometry/trajectory_2d.h>
+#include <path_planning/geometry/point_2d.h>
+#include <path_planning/geometry/rrt_2d.h>
+#include <path_planning/robot/robot_2d_circular.h>
+#include <path_planning/scene/scene_2d_continuous.h>
+#include <utils/types/types.h>
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <list>
+#include <glog/logging.h>
+
+class BiRRTPlanner2D {
+ public:
+  BiRRTPlanner2D(Robot2DCircular& origin_robot, Scene2DContinuous& origin_scene,
+                 Robot2DCircular& goal_robot, Scene2DContinuous& goal_scene,
+                 Point2D::Ptr origin, Point2D::Ptr goal,
+                 float step_size = 0.1, int max_iterations = 10000)
+    : origin_robot_(origin_robot), origin_scene_(origin_scene),
+      goal_robot_(goal_robot), goal_scene_(goal_scene),
+      origin_(origin), goal_(goal),
+      step_size_(step_size), max_iterations_(max_iterations),
+      joined_(false) {}
+  ~BiRRTPlanner2D() {}
+
+  // Grow both trees concurrently until they join or budgets run out.
+  Trajectory2D::Ptr PlanTrajectory();
+
+ private:
+  // Worker loop growing one side's tree.
+  void GrowTree(bool from_origin);
+
+  Robot2DCircular& origin_robot_;
+  Scene2DContinuous& origin_scene_;
+  Robot2DCircular& goal_robot_;
+  Scene2DContinuous& goal_scene_;
+  Point2D::Ptr origin_;
+  Point2D::Ptr goal_;
+
+  RRT2D origin_tree_, goal_tree_;
+  std::mutex origin_mutex_, goal_mutex_;
+
+  // Join bookkeeping: the two endpoints that met, one per tree.
+  std::mutex join_mutex_;
+  std::atomic<bool> joined_;
+  Point2D::Ptr join_origin_side_, join_goal_side_;
+
+  const float step_size_;
+  const int max_iterations_;
+};
+
+// ---------------------------- IMPLEMENTATION ------------------------------- //
+
+// Grow one side's tree. A thread takes its own tree's lock to query or
+// insert, and the other tree's lock only for the join query; no thread
+// ever holds both locks, so the pair cannot deadlock.
+void BiRRTPlanner2D::GrowTree(bool from_origin) {
+  RRT2D& mine = from_origin ? origin_tree_ : goal_tree_;
+  RRT2D& other = from_origin ? goal_tree_ : origin_tree_;
+  std::mutex& my_mutex = from_origin ? origin_mutex_ : goal_mutex_;
+  std::mutex& other_mutex = from_origin ? goal_mutex_ : origin_mutex_;
+  Robot2DCircular& robot = from_origin ? origin_robot_ : goal_robot_;
+  Scene2DContinuous& scene = from_origin ? origin_scene_ : goal_scene_;
+
+  for (int ii = 0; ii < max_iterations_ && !joined_; ++ii) {
+    Point2D::Ptr sample = scene.GetRandomPoint();
+
+    Point2D::Ptr nearest;
+    {
+      std::lock_guard<std::mutex> lock(my_mutex);
+      nearest = mine.GetNearest(sample);
+    }
+    if (nearest == nullptr)
+      continue;
+
+    Point2D::Ptr step = Point2D::StepToward(nearest, sample, step_size_);
+    if (!robot.LineOfSight(nearest, step))
+      continue;
+
+    {
+      std::lock_guard<std::mutex> lock(my_mutex);
+      if (!mine.Insert(step, nearest))
+        continue;
+    }
+
+    // Join check: can this new point see the other tree's nearest node?
+    Point2D::Ptr other_nearest;
+    {
+      std::lock_guard<std::mutex> lock(other_mutex);
+      other_nearest = other.GetNearest(step);
+    }
+    if (other_nearest == nullptr)
+      continue;
+
+    if (Point2D::DistancePointToPoint(step, other_nearest) <= step_size_ &&
+        robot.LineOfSight(step, other_nearest)) {
+      std::lock_guard<std::mutex> lock(join_mutex_);
+      if (!joined_) {
+        join_origin_side_ = from_origin ? step : other_nearest;
+        join_goal_side_ = from_origin ? other_nearest : step;
+        joined_ = true;
+      }
+      return;
+    }
+  }
+}
+
+// Grow both trees concurrently until they join or budgets run out.
+Trajectory2D::Ptr BiRRTPlanner2D::PlanTrajectory() {
+  origin_tree_.Insert(origin_);
+  goal_tree_.Insert(goal_);
+  joined_ = false;
+
+  std::thread origin_worker(&BiRRTPlanner2D::GrowTree, this, true);
+  std::thread goal_worker(&BiRRTPlanner2D::GrowTree, this, false);
+  origin_worker.join();
+  goal_worker.join();
+
+  if (!joined_) {
+    VLOG(1) << "Trees did not join within the iteration budget.";
+    return Trajectory2D::Ptr(nullptr);
+  }
+
+  // Stitch: origin-side path forward, goal-side path reversed.
+  Trajectory2D::Ptr front = origin_tree_.GetTrajectory(join_origin_side_);
+  Trajectory2D::Ptr back = goal_tree_.GetTrajectory(join_goal_side_);
+  if (front == nullptr || back == nullptr)
+    return Trajectory2D::Ptr(nullptr);
+
+  std::list<Point2D::Ptr> stitched(front->GetPoints().begin(),
+                                   front->GetPoints().end());
+  std::vector<Point2D::Ptr>& back_points = back->GetPoints();
+  for (size_t ii = back_points.size(); ii-- > 0;)
+    stitched.push_back(back_points[ii]);
+
+  return Trajectory2D::Create(stitched);
+}
+
+#endif
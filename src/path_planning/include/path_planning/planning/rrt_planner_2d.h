@@ -49,6 +49,7 @@
 #include <path_planning/geometry/trajectory_2d.h>
 #include <path_planning/geometry/point_2d.h>
 #include <path_planning/geometry/rrt_2d.h>
+#include <path_planning/planning/sampling_strategy_2d.h>
 #include <path_planning/robot/robot_2d_circular.h>
 #include <path_planning/scene/scene_2d_continuous.h>
 #include <utils/types/types.h>
@@ -59,11 +60,14 @@
 // Derived from base class Planner.
 class RRTPlanner2D {
  public:
+ // Pass a sampling strategy to bias or restrict sampling; the planner
+ // does not own it. With none given, sampling is uniform over the scene.
  RRTPlanner2D(Robot2DCircular& robot, Scene2DContinuous& scene,
-              Point2D::Ptr origin, Point2D::Ptr goal, float step_size = 0.1)
+              Point2D::Ptr origin, Point2D::Ptr goal, float step_size = 0.1,
+              SamplingStrategy2D* sampler = nullptr)
    : robot_(robot), scene_(scene),
     origin_(origin), goal_(goal),
-    step_size_(step_size) {}
+    step_size_(step_size), sampler_(sampler) {}
   ~RRTPlanner2D() {}
 
   // The algorithm. See header for references.
@@ -77,6 +81,7 @@ class RRTPlanner2D {
 
   RRT2D tree_;
   const float step_size_;
+  SamplingStrategy2D* sampler_;
 };
 
 // ---------------------------- IMPLEMENTATION ------------------------------- //
@@ -96,8 +101,9 @@ Trajectory2D::Ptr RRTPlanner2D::PlanTrajectory() {
   // 2. Take a step toward that point if possible.
   Point2D::Ptr last_point;
   while (!tree_.Contains(goal_) && tree_.Size() < 10000) {
-    // Pick a random point in the scene.
-    Point2D::Ptr random_point = scene_.GetRandomPoint();
+    // Draw the next sample (uniform, goal-biased, or informed).
+    Point2D::Ptr random_point =
+      (sampler_ != nullptr) ? sampler_->Sample() : scene_.GetRandomPoint();
 
     // Find nearest point in the tree.
     Point2D::Ptr nearest = tree_.GetNearest(random_point);
@@ -133,8 +139,14 @@ Trajectory2D::Ptr RRTPlanner2D::PlanTrajectory() {
     }
   }
 
-  // Return the trajectory.
-  return tree_.GetTrajectory(last_point);
+  // Return the trajectory, telling the sampler about the solution so a
+  // replan can sample the informed subset.
+  Trajectory2D::Ptr trajectory = tree_.GetTrajectory(last_point);
+  if (sampler_ != nullptr && trajectory != nullptr && last_point == goal_)
+    sampler_->NotifySolution(origin_, goal_,
+                             static_cast<float>(trajectory->GetLength()));
+
+  return trajectory;
 }
 
 #endif
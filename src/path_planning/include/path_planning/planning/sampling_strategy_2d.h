@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file defines pluggable sampling strategies for the RRT planner:
+// uniform, goal-biased, and informed (ellipsoidal) sampling.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef PATH_PLANNING_SAMPLING_STRATEGY_2D_H
+#define PATH_PLANNING_SAMPLING_STRATEGY_2D_H
+
+#include <path_planning/geometry/point_2d.h>
+#include <path_planning/scene/scene_2d_continuous.h>
+#include <utils/math/random_generator.h>
+#include <utils/types/types.h>
+
+#include <glog/logging.h>
+
+// Base strategy: uniform sampling over the scene.
+class SamplingStrategy2D {
+ public:
+  explicit SamplingStrategy2D(Scene2DContinuous& scene)
+    : scene_(scene) {}
+  virtual ~SamplingStrategy2D() {}
+
+  // Draw the next sample.
+  virtual Point2D::Ptr Sample() {
+    return scene_.GetRandomPoint();
+  }
+
+  // Planner feedback: a solution of the given cost was found between
+  // origin and goal. The base strategy ignores it.
+  virtual void NotifySolution(Point2D::Ptr origin, Point2D::Ptr goal,
+                              float cost) {}
+
+ protected:
+  Scene2DContinuous& scene_;
+};  //\class SamplingStrategy2D
+
+// Mix goal samples into the stream with fixed probability, pulling the
+// tree toward the goal instead of relying on chance.
+class GoalBiasedSampling2D : public SamplingStrategy2D {
+ public:
+  GoalBiasedSampling2D(Scene2DContinuous& scene, Point2D::Ptr goal,
+                       float goal_bias = 0.1)
+    : SamplingStrategy2D(scene), goal_(goal), goal_bias_(goal_bias) {}
+
+  Point2D::Ptr Sample() {
+    if (rng_.Double() < goal_bias_)
+      return goal_;
+    return scene_.GetRandomPoint();
+  }
+
+ protected:
+  Point2D::Ptr goal_;
+  float goal_bias_;
+  math::RandomGenerator rng_;
+};  //\class GoalBiasedSampling2D
+
+// Informed sampling (the L2 ellipse of Gammell et al.): once a solution
+// exists, reject samples whose best possible origin-sample-goal path is
+// already longer than the best known solution -- they cannot improve it.
+class InformedSampling2D : public GoalBiasedSampling2D {
+ public:
+  InformedSampling2D(Scene2DContinuous& scene, Point2D::Ptr goal,
+                     float goal_bias = 0.1)
+    : GoalBiasedSampling2D(scene, goal, goal_bias), best_cost_(-1.0) {}
+
+  Point2D::Ptr Sample() {
+    Point2D::Ptr sample = GoalBiasedSampling2D::Sample();
+    if (best_cost_ <= 0.0 || origin_ == nullptr)
+      return sample;
+
+    // Rejection-sample into the informed ellipse; bail out after a
+    // bounded number of tries so a tight ellipse cannot stall sampling.
+    const int kMaxTries = 100;
+    for (int ii = 0; ii < kMaxTries; ++ii) {
+      const float bound =
+        Point2D::DistancePointToPoint(origin_, sample) +
+        Point2D::DistancePointToPoint(sample, goal_);
+      if (bound <= best_cost_)
+        return sample;
+
+      sample = GoalBiasedSampling2D::Sample();
+    }
+
+    return sample;
+  }
+
+  void NotifySolution(Point2D::Ptr origin, Point2D::Ptr goal, float cost) {
+    origin_ = origin;
+    if (best_cost_ < 0.0 || cost < best_cost_)
+      best_cost_ = cost;
+  }
+
+ private:
+  Point2D::Ptr origin_;
+  float best_cost_;
+};  //\class InformedSampling2D
+
+#endif
@@ -81,33 +81,15 @@ bool Robot2DCircular::IsFeasible(Point2D::Ptr location) {
 }
 
 // Check if there is a valid linear trajectory between these two points.
+// The scene runs exact segment-vs-circle tests against its broad phase,
+// padded by the robot radius, so long extensions are checked in one sweep
+// with no per-call radius search.
 bool Robot2DCircular::LineOfSight(Point2D::Ptr point1,
                                   Point2D::Ptr point2) const {
   CHECK_NOTNULL(point1.get());
   CHECK_NOTNULL(point2.get());
 
-  // Check if line segment intersects any nearby obstacle.
-  Point2D::Ptr midpoint = Point2D::MidPoint(point1, point2);
-  float max_distance =
-    radius_ + scene_.GetLargestObstacleRadius() +
-    0.5 * Point2D::DistancePointToPoint(point1, point2);
-
-  FlannObstacle2DTree& obstacle_tree = scene_.GetObstacleTree();
-  std::vector<Obstacle2D::Ptr> obstacles;
-  if (!obstacle_tree.RadiusSearch(midpoint, obstacles, max_distance)) {
-    VLOG(1) << "Radius search failed during LineOfSight() test. "
-            << "Returning false.";
-    return false;
-  }
-
-  for (const auto& obstacle : obstacles) {
-    if (Point2D::DistanceLineToPoint(point1, point2,
-                                     obstacle->GetLocation()) <
-        obstacle->GetRadius() + radius_)
-      return false;
-  }
-
-  return true;
+  return scene_.IsSegmentFeasible(point1, point2, radius_);
 }
 
 #endif
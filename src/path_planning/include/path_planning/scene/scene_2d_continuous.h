@@ -53,6 +53,8 @@
 
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <glog/logging.h>
 #include <Eigen/Dense>
 #include <iostream>
@@ -87,6 +89,12 @@ class Scene2DContinuous {
   // Is this point feasible?
   bool IsFeasible(Point2D::Ptr point) const;
 
+  // Is the straight segment between these points feasible? Exact
+  // segment-vs-circle tests against every nearby obstacle, padded by an
+  // optional robot radius, so planners can take large strides safely.
+  bool IsSegmentFeasible(Point2D::Ptr point1, Point2D::Ptr point2,
+                         float padding = 0.0) const;
+
   // What is the cost of occupying this point?
   float Cost(Point2D::Ptr point) const;
 
@@ -116,11 +124,35 @@ class Scene2DContinuous {
                  Trajectory2D::Ptr path, int xsize = 500) const;
 
  private:
+  // Broad-phase spatial hash over obstacle bounding circles, maintained
+  // as obstacles are added. An obstacle is registered in every cell its
+  // circle overlaps, so a point query indexes exactly one cell and never
+  // builds a fresh result vector.
+  inline long long BroadPhaseKey(int cx, int cy) const {
+    return (static_cast<long long>(cx) << 32)
+      ^ static_cast<unsigned int>(cy);
+  }
+  inline int CellCoord(float value) const {
+    return static_cast<int>(std::floor(value / cell_size_));
+  }
+  void InsertIntoBroadPhase(Obstacle2D::Ptr obstacle);
+  void RebuildBroadPhase();
+
+  // Collect the unique obstacles whose centers lie within range of point
+  // into a scratch vector reused across calls.
+  const std::vector<Obstacle2D::Ptr>& CollectInRange(Point2D::Ptr point,
+                                                     float range) const;
+
   std::vector<Obstacle2D::Ptr> obstacles_;
   FlannObstacle2DTree obstacle_tree_;
   math::RandomGenerator rng_;
   float largest_obstacle_radius_;
 
+  std::unordered_map< long long, std::vector<Obstacle2D::Ptr> > broad_phase_;
+  mutable std::vector<Obstacle2D::Ptr> range_scratch_;
+  mutable std::unordered_set<Obstacle2D*> visited_scratch_;
+  float cell_size_;
+
   float xmin_;
   float xmax_;
   float ymin_;
@@ -131,21 +163,21 @@ class Scene2DContinuous {
 
   // Dummy constructor. MUST call SetBounds after this.
   Scene2DContinuous::Scene2DContinuous()
-    : largest_obstacle_radius_(0.0),
+    : largest_obstacle_radius_(0.0), cell_size_(1.0),
       xmin_(0.0), xmax_(0.0),
       ymin_(0.0), ymax_(0.0) {}
 
   // Better to use these constructors if possible.
   Scene2DContinuous::Scene2DContinuous(float xmin, float xmax,
                                        float ymin, float ymax)
-    : largest_obstacle_radius_(0.0),
+    : largest_obstacle_radius_(0.0), cell_size_(1.0),
       xmin_(xmin), xmax_(xmax),
       ymin_(ymin), ymax_(ymax) {}
 
   Scene2DContinuous::Scene2DContinuous(float xmin, float xmax,
                                        float ymin, float ymax,
                                        std::vector<Obstacle2D::Ptr>& obstacles)
-    : obstacles_(obstacles),
+    : obstacles_(obstacles), cell_size_(1.0),
       xmin_(xmin), xmax_(xmax),
       ymin_(ymin), ymax_(ymax) {
 
@@ -158,8 +190,9 @@ class Scene2DContinuous {
         largest_obstacle_radius_ = obstacle->GetRadius();
     }
 
-    // Obstacle tree.
+    // Obstacle tree and broad phase.
     obstacle_tree_.AddObstacles(obstacles);
+    RebuildBroadPhase();
   }
 
   // Add an obstacle.
@@ -168,6 +201,71 @@ class Scene2DContinuous {
 
     obstacles_.push_back(obstacle);
     obstacle_tree_.AddObstacle(obstacle);
+
+    // A larger obstacle than any seen so far changes the cell size, so
+    // the hash must be rebuilt; otherwise just register the newcomer.
+    if (obstacle->GetRadius() > largest_obstacle_radius_) {
+      largest_obstacle_radius_ = obstacle->GetRadius();
+      RebuildBroadPhase();
+    } else {
+      InsertIntoBroadPhase(obstacle);
+    }
+  }
+
+  // Register one obstacle in every broad-phase cell its circle overlaps.
+  void Scene2DContinuous::InsertIntoBroadPhase(Obstacle2D::Ptr obstacle) {
+    const Point2D::Ptr center = obstacle->GetLocation();
+    const float radius = obstacle->GetRadius();
+
+    const int cx0 = CellCoord(center->x - radius);
+    const int cx1 = CellCoord(center->x + radius);
+    const int cy0 = CellCoord(center->y - radius);
+    const int cy1 = CellCoord(center->y + radius);
+
+    for (int cx = cx0; cx <= cx1; ++cx)
+      for (int cy = cy0; cy <= cy1; ++cy)
+        broad_phase_[BroadPhaseKey(cx, cy)].push_back(obstacle);
+  }
+
+  // Resize the cells to the largest obstacle and re-register everything.
+  void Scene2DContinuous::RebuildBroadPhase() {
+    cell_size_ = std::max(2.0f * largest_obstacle_radius_, 1e-3f);
+    broad_phase_.clear();
+    for (const auto& obstacle : obstacles_)
+      InsertIntoBroadPhase(obstacle);
+  }
+
+  // Collect the unique obstacles whose centers lie within range of point.
+  const std::vector<Obstacle2D::Ptr>& Scene2DContinuous::CollectInRange(
+      Point2D::Ptr point, float range) const {
+    range_scratch_.clear();
+    visited_scratch_.clear();
+
+    const int cx0 = CellCoord(point->x - range);
+    const int cx1 = CellCoord(point->x + range);
+    const int cy0 = CellCoord(point->y - range);
+    const int cy1 = CellCoord(point->y + range);
+    const float range_sq = range * range;
+
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      for (int cy = cy0; cy <= cy1; ++cy) {
+        const auto cell = broad_phase_.find(BroadPhaseKey(cx, cy));
+        if (cell == broad_phase_.end())
+          continue;
+
+        for (const auto& obstacle : cell->second) {
+          if (!visited_scratch_.insert(obstacle.get()).second)
+            continue;
+
+          const float dx = obstacle->GetLocation()->x - point->x;
+          const float dy = obstacle->GetLocation()->y - point->y;
+          if (dx * dx + dy * dy <= range_sq)
+            range_scratch_.push_back(obstacle);
+        }
+      }
+    }
+
+    return range_scratch_;
   }
 
   // Get obstacles.
@@ -196,21 +294,18 @@ class Scene2DContinuous {
     ymax_ = ymax;
   }
 
-  // Is this point feasible?
+  // Is this point feasible? Any obstacle covering the point overlaps the
+  // point's broad-phase cell, so one cell lookup suffices.
   bool Scene2DContinuous::IsFeasible(Point2D::Ptr point) const {
     CHECK_NOTNULL(point.get());
 
-    // Get a list of all obstacles in range.
-    std::vector<Obstacle2D::Ptr> obstacles_in_range;
-    if (!obstacle_tree_.RadiusSearch(point, obstacles_in_range,
-                                     largest_obstacle_radius_)) {
-      VLOG(1) << "Radius search failed during feasibility test. "
-              << "Returning false.";
-      return false;
-    }
+    const auto cell = broad_phase_.find(
+      BroadPhaseKey(CellCoord(point->x), CellCoord(point->y)));
+    if (cell == broad_phase_.end())
+      return true;
 
-    // Check each obstacle.
-    for (const auto& obstacle : obstacles_in_range) {
+    // Check each obstacle registered in this cell.
+    for (const auto& obstacle : cell->second) {
       if (!obstacle->IsFeasible(point))
         return false;
     }
@@ -218,21 +313,59 @@ class Scene2DContinuous {
     return true;
   }
 
+  // Is the straight segment between these points feasible? Candidate
+  // cells come from the segment's bounding box grown by the largest
+  // obstacle radius plus the padding; each candidate gets an exact
+  // segment-vs-circle test.
+  bool Scene2DContinuous::IsSegmentFeasible(Point2D::Ptr point1,
+                                            Point2D::Ptr point2,
+                                            float padding) const {
+    CHECK_NOTNULL(point1.get());
+    CHECK_NOTNULL(point2.get());
+
+    // Degenerate segment: fall back to a point test.
+    const float kMinSegmentLength = 1e-8;
+    if (Point2D::DistancePointToPoint(point1, point2) < kMinSegmentLength)
+      return IsFeasible(point1);
+
+    const float margin = largest_obstacle_radius_ + padding;
+    const int cx0 = CellCoord(std::min(point1->x, point2->x) - margin);
+    const int cx1 = CellCoord(std::max(point1->x, point2->x) + margin);
+    const int cy0 = CellCoord(std::min(point1->y, point2->y) - margin);
+    const int cy1 = CellCoord(std::max(point1->y, point2->y) + margin);
+
+    visited_scratch_.clear();
+    for (int cx = cx0; cx <= cx1; ++cx) {
+      for (int cy = cy0; cy <= cy1; ++cy) {
+        const auto cell = broad_phase_.find(BroadPhaseKey(cx, cy));
+        if (cell == broad_phase_.end())
+          continue;
+
+        for (const auto& obstacle : cell->second) {
+          if (!visited_scratch_.insert(obstacle.get()).second)
+            continue;
+
+          if (Point2D::DistanceLineToPoint(point1, point2,
+                                           obstacle->GetLocation()) <
+              obstacle->GetRadius() + padding)
+            return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
   // What is the cost of occupying this point? For speed, only compute
   // cost from obstacles within a specific radius.
   float Scene2DContinuous::Cost(Point2D::Ptr point) const {
     CHECK_NOTNULL(point.get());
 
-    // Get a list of all obstacles in range.
-    std::vector<Obstacle2D::Ptr> obstacles_in_range;
-    if (!obstacle_tree_.RadiusSearch(point, obstacles_in_range,
-                                     10.0 * largest_obstacle_radius_)) {
-      VLOG(1) << "Radius search failed during cost evaluation. "
-              << "Returning infinite cost.";
-      return std::numeric_limits<float>::infinity();
-    }
+    // Iterate over all obstacles in range, straight out of the broad
+    // phase.
+    const std::vector<Obstacle2D::Ptr>& obstacles_in_range =
+      CollectInRange(point, 10.0 * largest_obstacle_radius_);
 
-    // Iterate over all obstacles in range.
     float total_cost = 0.0;
     for (const auto& obstacle : obstacles_in_range)
       total_cost += obstacle->Cost(point);
@@ -245,16 +378,11 @@ class Scene2DContinuous {
   Point2D::Ptr Scene2DContinuous::CostDerivative(Point2D::Ptr point) const {
     CHECK_NOTNULL(point.get());
 
-    // Get a list of all obstacles in range.
-    std::vector<Obstacle2D::Ptr> obstacles_in_range;
-    if (!obstacle_tree_.RadiusSearch(point, obstacles_in_range,
-                                     10.0 * largest_obstacle_radius_)) {
-      VLOG(1) << "Radius search failed during derivative evaluation. "
-              << "Returning zero derivative.";
-      return Point2D::Create(0.0, 0.0);
-    }
+    // Iterate over all obstacles in range, straight out of the broad
+    // phase.
+    const std::vector<Obstacle2D::Ptr>& obstacles_in_range =
+      CollectInRange(point, 10.0 * largest_obstacle_radius_);
 
-    // Iterate over all obstacles in range.
     Vector2d total_derivative = Vector2d::Zero();
     for (const auto& obstacle : obstacles_in_range) {
       Point2D::Ptr derivative = obstacle->Derivative(point);
@@ -272,7 +400,11 @@ class Scene2DContinuous {
     return Point2D::Create(x, y);
   }
 
-  // Optimize the given trajectory to minimize cost.
+  // Optimize the given trajectory to minimize cost. The waypoints live
+  // in one contiguous (N x 2) matrix: obstacle gradients are gathered
+  // through one broad-phase pass per iteration, the curvature penalty is
+  // applied as a single vectorized second-difference expression, and the
+  // loop exits early once the gradient norm goes quiet.
   Trajectory2D::Ptr Scene2DContinuous::OptimizeTrajectory(
                                                  Trajectory2D::Ptr path,
                                                  float gradient_weight,
@@ -282,49 +414,84 @@ class Scene2DContinuous {
                                                  size_t max_iters) const {
     CHECK_NOTNULL(path.get());
 
-    // Extract points from the given trajectory.
-    std::vector<Point2D::Ptr> points(path->GetPoints());
-    float num_points = static_cast<float>(points.size());
-
-    // Create a new trajectory from these soon-to-be-optimized points.
-    Trajectory2D::Ptr optimized = Trajectory2D::Create(points);
-
-    // While the average displacement of all points is large and the total
-    // number of iterations does not exceed the threshold, iterate over
-    // all points and move each point a small distance in the direction
-    // of the negative gradient.
-    float total_displacement = std::numeric_limits<float>::infinity();
-    size_t num_iters = 0;
-    while (total_displacement / num_points > min_avg_displacement &&
-           num_iters < max_iters) {
-      total_displacement = 0.0;
-
-      // Compute second time derivative of the trajectory.
-      Trajectory2D::Ptr time_derivative1 = optimized->TimeDerivative();
-      Trajectory2D::Ptr time_derivative2 = time_derivative1->TimeDerivative();
-
-      for (size_t ii = 1; ii < points.size() - 1; ii++) {
-        Point2D::Ptr point = optimized->GetAt(ii);
-        Point2D::Ptr cost_derivative = CostDerivative(point);
-        Point2D::Ptr time_derivative = time_derivative2->GetAt(ii);
-
-        Point2D::Ptr derivative = Point2D::Add(cost_derivative, time_derivative,
-                                               -curvature_penalty);
-        float step_x = point->x - gradient_weight * derivative->x;
-        float step_y = point->y - gradient_weight * derivative->y;
-        Point2D::Ptr initial_step = Point2D::Create(step_x, step_y);
-        Point2D::Ptr truncated_step = Point2D::StepToward(point, initial_step,
-                                                          max_point_displacement);
-        total_displacement += Point2D::DistancePointToPoint(point,
-                                                            truncated_step);
-
-        optimized->SetAt(truncated_step, ii);
+    std::vector<Point2D::Ptr>& input_points = path->GetPoints();
+    const size_t num_points = input_points.size();
+    if (num_points < 3)
+      return Trajectory2D::Create(input_points);
+
+    // Pack the trajectory into contiguous storage.
+    MatrixXf waypoints(num_points, 2);
+    for (size_t ii = 0; ii < num_points; ii++) {
+      waypoints(ii, 0) = input_points[ii]->x;
+      waypoints(ii, 1) = input_points[ii]->y;
+    }
+
+    MatrixXf gradient(num_points, 2);
+    Point2D::Ptr query = Point2D::Create(0.0, 0.0);
+    const size_t interior = num_points - 2;
+    const float kGradientNormTolerance = 1e-8;
+
+    for (size_t num_iters = 0; num_iters < max_iters; num_iters++) {
+      gradient.setZero();
+
+      // Obstacle gradients: one broad-phase collection per waypoint,
+      // reusing the scene's scratch buffers and a single query point.
+      for (size_t ii = 1; ii + 1 < num_points; ii++) {
+        query->x = waypoints(ii, 0);
+        query->y = waypoints(ii, 1);
+
+        const std::vector<Obstacle2D::Ptr>& obstacles_in_range =
+          CollectInRange(query, 10.0 * largest_obstacle_radius_);
+        for (const auto& obstacle : obstacles_in_range) {
+          Point2D::Ptr derivative = obstacle->Derivative(query);
+          gradient(ii, 0) += derivative->x;
+          gradient(ii, 1) += derivative->y;
+        }
+      }
+
+      // Curvature penalty: one vectorized second difference over the
+      // interior rows.
+      gradient.block(1, 0, interior, 2) -= curvature_penalty *
+        (waypoints.block(2, 0, interior, 2)
+         - 2.0f * waypoints.block(1, 0, interior, 2)
+         + waypoints.block(0, 0, interior, 2));
+
+      // Quiet gradient: nothing left to gain.
+      if (gradient.norm() < kGradientNormTolerance)
+        break;
+
+      // Gradient step with a per-point displacement clamp.
+      float total_displacement = 0.0;
+      for (size_t ii = 1; ii + 1 < num_points; ii++) {
+        float step_x = -gradient_weight * gradient(ii, 0);
+        float step_y = -gradient_weight * gradient(ii, 1);
+
+        const float step_norm =
+          std::sqrt(step_x * step_x + step_y * step_y);
+        if (step_norm > max_point_displacement) {
+          const float scale = max_point_displacement / step_norm;
+          step_x *= scale;
+          step_y *= scale;
+        }
+
+        waypoints(ii, 0) += step_x;
+        waypoints(ii, 1) += step_y;
+        total_displacement += std::min(step_norm, max_point_displacement);
       }
 
-      num_iters++;
+      if (total_displacement / static_cast<float>(num_points) <
+          min_avg_displacement)
+        break;
     }
 
-    return optimized;
+    // Unpack into a fresh trajectory.
+    std::vector<Point2D::Ptr> optimized_points;
+    optimized_points.reserve(num_points);
+    for (size_t ii = 0; ii < num_points; ii++)
+      optimized_points.push_back(
+        Point2D::Create(waypoints(ii, 0), waypoints(ii, 1)));
+
+    return Trajectory2D::Create(optimized_points);
   }
 
   // Visualize this scene. Optionally pass in the number of pixels
@@ -51,6 +51,8 @@
 #include <utils/types/types.h>
 
 #include <glog/logging.h>
+#include <stdint.h>
+#include <vector>
 
 using Eigen::MatrixXi;
 
@@ -63,6 +65,14 @@ class Sensor2DRadial {
   // How many known obstacles are visible to the robot?
   int GetObstacleCount(Orientation2D::Ptr pose) const;
 
+  // Batch visibility for one pose: targets are a contiguous (N x 2)
+  // matrix, and bit ii of the mask is set when target ii is within range
+  // and has line of sight. The squared-distance range test runs as one
+  // vectorized expression over the whole batch, and only in-range
+  // survivors pay for an occlusion test.
+  void VisibilityMask(Orientation2D::Ptr pose, const Eigen::MatrixXf& targets,
+                      std::vector<uint64_t>& mask) const;
+
   // Visualize which voxels are visible to this robot.
   void Visualize(Orientation2D::Ptr pose,
                  const std::string& title = std::string()) const;
@@ -126,6 +136,43 @@ int Sensor2DRadial::GetObstacleCount(Orientation2D::Ptr pose) const {
   return obstacle_count;
 }
 
+// Batch visibility for one pose.
+void Sensor2DRadial::VisibilityMask(Orientation2D::Ptr pose,
+                                    const Eigen::MatrixXf& targets,
+                                    std::vector<uint64_t>& mask) const {
+  CHECK_NOTNULL(pose.get());
+
+  const size_t num_targets = static_cast<size_t>(targets.rows());
+  mask.assign((num_targets + 63) / 64, 0);
+  if (num_targets == 0)
+    return;
+
+  Robot2DCircular robot(grid_.GetScene(), 0.0 /* radius */);
+  Point2D::Ptr location = pose->GetPoint2D();
+
+  // Broad phase: vectorized squared-distance range test over the batch.
+  Eigen::ArrayXf dx = targets.col(0).array() - location->x;
+  Eigen::ArrayXf dy = targets.col(1).array() - location->y;
+  Eigen::ArrayXf range_sq = dx * dx + dy * dy;
+  const float radius_sq = radius_ * radius_;
+
+  // Narrow phase: occlusion tests for in-range targets only, reusing one
+  // query point across the sweep.
+  Point2D::Ptr target = Point2D::Create(0.0, 0.0);
+  for (size_t ii = 0; ii < num_targets; ii++) {
+    if (range_sq(ii) > radius_sq)
+      continue;
+
+    target->x = targets(ii, 0);
+    target->y = targets(ii, 1);
+
+    Point2D::Ptr close =
+      Point2D::StepToward(target, location, grid_.GetBlockSize());
+    if (robot.LineOfSight(location, close))
+      mask[ii / 64] |= (static_cast<uint64_t>(1) << (ii % 64));
+  }
+}
+
 // Visualize which voxels are visible to this robot.
 void Sensor2DRadial::Visualize(Orientation2D::Ptr pose,
                                const std::string& title) const {
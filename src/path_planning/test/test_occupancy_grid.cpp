@@ -56,13 +56,30 @@ TEST(OccupancyGrid, TestOccupancyGrid2D) {
   // Create an empty occupancy grid.
   OccupancyGrid2D grid(0.0, 1.0, 0.0, 1.0, 0.005);
 
-  // Create a bunch of points and add to the grid.
+  // Create a bunch of points and add to the grid in one batch.
+  std::vector<Point2D::Ptr> points;
   for (size_t ii = 0; ii < 1000; ii++) {
     float x = static_cast<float>(rng.Double());
     float y = static_cast<float>(rng.Double());
-    Point2D::Ptr point = Point2D::Create(x, y);
-    grid.Insert(point);
+    points.push_back(Point2D::Create(x, y));
+  }
+  grid.Insert(points);
+
+  EXPECT_EQ(grid.GetTotalCount(), 1000);
+  EXPECT_GE(grid.GetMaxCount(), 1);
+
+  // The incrementally-maintained max must match the fullest bin.
+  int max_row = -1, max_col = -1;
+  grid.GetMaxCountBin(max_row, max_col);
+  Point2D::Ptr fullest = nullptr;
+  for (const auto& point : points) {
+    if (grid.GetCountAt(point) == grid.GetMaxCount())
+      fullest = point;
   }
+  EXPECT_NE(fullest, nullptr);
+
+  // Entropy of a spread-out distribution should be positive.
+  EXPECT_GT(grid.GetEntropy(), 0.0);
 
   if (VISUALIZE)
     grid.Visualize("Test grid.");
@@ -37,6 +37,7 @@
 #include <path_planning/geometry/trajectory_2d.h>
 #include <path_planning/geometry/point_2d.h>
 #include <path_planning/planning/rrt_planner_2d.h>
+#include <path_planning/planning/birrt_planner_2d.h>
 #include <path_planning/robot/robot_2d_circular.h>
 #include <utils/math/random_generator.h>
 #include <path_planning/scene/scene_2d_continuous.h>
@@ -101,6 +102,24 @@ TEST(RRTPlanner2D, TestRRTPlanner2D) {
   if (VISUALIZE) {
     scene.Visualize("RRT route", route);
   }
+
+  // Plan the same problem bidirectionally. Each side gets its own scene
+  // and robot over the same obstacles.
+  Scene2DContinuous goal_side_scene(0.0, 1.0, 0.0, 1.0, obstacles);
+  Robot2DCircular goal_side_robot(goal_side_scene, 0.01);
+
+  BiRRTPlanner2D biplanner(robot, scene, goal_side_robot, goal_side_scene,
+                           origin, goal, 0.05);
+  Trajectory2D::Ptr biroute = biplanner.PlanTrajectory();
+
+  if (biroute != nullptr) {
+    // The stitched path must run from the origin to the goal.
+    EXPECT_NEAR(Point2D::DistancePointToPoint(biroute->GetAt(0), origin),
+                0.0, 1e-8);
+    EXPECT_NEAR(Point2D::DistancePointToPoint(
+                  biroute->GetAt(biroute->GetPoints().size() - 1), goal),
+                0.0, 1e-8);
+  }
 }
 
 // Test that we can construct and destroy a scene.
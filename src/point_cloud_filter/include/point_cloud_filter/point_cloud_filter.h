@@ -44,11 +44,13 @@
 #define POINT_CLOUD_FILTER_H
 
 #include <ros/ros.h>
+#include <utils/timing/stage_timer.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <pcl/point_types.h>
 #include <pcl_ros/point_cloud.h>
 #include <pcl/filters/voxel_grid.h>
 #include <pcl/filters/statistical_outlier_removal.h>
+#include <unordered_map>
 #include <cmath>
 
 typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
@@ -60,15 +62,28 @@ class PointCloudFilter {
 
   bool Initialize(const ros::NodeHandle& n);
 
-  // Filter the incoming point cloud.
+  // Filter the incoming point cloud. The returned cloud is a buffer reused
+  // across calls, and is only valid until the next call to Filter().
   PointCloud::Ptr Filter(const PointCloud::ConstPtr& cloud);
 
  private:
   bool LoadParameters(const ros::NodeHandle& n);
   bool RegisterCallbacks(const ros::NodeHandle& n);
 
+  // Approximate outlier removal: drop downsampled points whose voxel leaf
+  // holds fewer than min_leaf_points_ raw returns.
+  void RemoveSparseLeaves(const PointCloud::ConstPtr& cloud);
+
+  // Filters and output buffer live across calls so the per-scan hot path
+  // does not allocate.
+  pcl::VoxelGrid<pcl::PointXYZ> grid_filter_;
+  pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor_filter_;
+  PointCloud::Ptr filtered_cloud_;
+  std::unordered_map<long long, int> leaf_counts_;
+
   double voxel_leaf_size_, sor_zscore_;
-  int sor_knn_;
+  int sor_knn_, min_leaf_points_;
+  bool fast_outlier_mode_;
   bool initialized_;
   std::string name_;
 };
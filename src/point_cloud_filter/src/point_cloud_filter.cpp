@@ -43,7 +43,10 @@
 #include <point_cloud_filter/point_cloud_filter.h>
 
 // Constructor/destructor.
-PointCloudFilter::PointCloudFilter() : initialized_(false) {}
+PointCloudFilter::PointCloudFilter() : initialized_(false) {
+  filtered_cloud_.reset(new PointCloud);
+}
+
 PointCloudFilter::~PointCloudFilter() {}
 
 // Initialize.
@@ -60,6 +63,12 @@ bool PointCloudFilter::Initialize(const ros::NodeHandle& n) {
     return false;
   }
 
+  // Configure the persistent filters once, up front.
+  grid_filter_.setLeafSize(voxel_leaf_size_, voxel_leaf_size_,
+                           voxel_leaf_size_);
+  sor_filter_.setMeanK(sor_knn_);
+  sor_filter_.setStddevMulThresh(sor_zscore_);
+
   initialized_ = true;
   return true;
 }
@@ -72,6 +81,11 @@ bool PointCloudFilter::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!ros::param::get("/uav_slam/filter/sor_zscore", sor_zscore_))
     return false;
+  if (!ros::param::get("/uav_slam/filter/fast_outlier_mode",
+                       fast_outlier_mode_))
+    return false;
+  if (!ros::param::get("/uav_slam/filter/min_leaf_points", min_leaf_points_))
+    return false;
 
   return true;
 }
@@ -81,22 +95,65 @@ bool PointCloudFilter::RegisterCallbacks(const ros::NodeHandle& n) {
   return true;
 }
 
-// Filter the incoming point cloud.
+// Filter the incoming point cloud into a buffer reused across calls.
 PointCloud::Ptr PointCloudFilter::Filter(const PointCloud::ConstPtr& cloud) {
-  PointCloud::Ptr filtered_cloud(new PointCloud);
+  timing::ScopedTimer timer("point_cloud_filter/filter");
 
   // Voxel grid filter.
-  pcl::VoxelGrid<pcl::PointXYZ> grid_filter;
-  grid_filter.setInputCloud(cloud);
-  grid_filter.setLeafSize(voxel_leaf_size_, voxel_leaf_size_, voxel_leaf_size_);
-  grid_filter.filter(*filtered_cloud);
-
-  // Statistical outlier removal.
-  pcl::StatisticalOutlierRemoval<pcl::PointXYZ> sor_filter;
-  sor_filter.setInputCloud(filtered_cloud);
-  sor_filter.setMeanK(sor_knn_);
-  sor_filter.setStddevMulThresh(sor_zscore_);
-  sor_filter.filter(*filtered_cloud);
-
-  return filtered_cloud;
+  grid_filter_.setInputCloud(cloud);
+  grid_filter_.filter(*filtered_cloud_);
+
+  if (fast_outlier_mode_) {
+    // Approximate outlier removal from voxel-leaf populations.
+    RemoveSparseLeaves(cloud);
+  } else {
+    // Statistical outlier removal, in place.
+    sor_filter_.setInputCloud(filtered_cloud_);
+    sor_filter_.filter(*filtered_cloud_);
+  }
+
+  return filtered_cloud_;
+}
+
+// Hash a point's voxel leaf coordinates into a single key.
+namespace {
+  long long LeafKey(const pcl::PointXYZ& point, double inv_leaf) {
+    const long long xi = static_cast<long long>(std::floor(point.x * inv_leaf));
+    const long long yi = static_cast<long long>(std::floor(point.y * inv_leaf));
+    const long long zi = static_cast<long long>(std::floor(point.z * inv_leaf));
+    return (xi * 73856093) ^ (yi * 19349663) ^ (zi * 83492791);
+  }
+} //\ namespace
+
+// Approximate outlier removal. Count the raw returns falling into each
+// voxel leaf (one hash pass, no kd-tree) and drop downsampled points whose
+// leaf population is too small: isolated returns only ever put a point or
+// two in a leaf, while real surfaces fill it.
+void PointCloudFilter::RemoveSparseLeaves(const PointCloud::ConstPtr& cloud) {
+  const double inv_leaf = 1.0 / voxel_leaf_size_;
+
+  leaf_counts_.clear();
+  for (size_t ii = 0; ii < cloud->points.size(); ii++) {
+    const pcl::PointXYZ& point = cloud->points[ii];
+    if (std::isnan(point.x) || std::isnan(point.y) || std::isnan(point.z))
+      continue;
+
+    leaf_counts_[LeafKey(point, inv_leaf)]++;
+  }
+
+  // Compact the downsampled cloud in place. Each centroid lies inside the
+  // leaf its raw points came from, so its key looks up the right count.
+  size_t kept = 0;
+  for (size_t ii = 0; ii < filtered_cloud_->points.size(); ii++) {
+    const pcl::PointXYZ& point = filtered_cloud_->points[ii];
+
+    std::unordered_map<long long, int>::const_iterator entry =
+      leaf_counts_.find(LeafKey(point, inv_leaf));
+    if (entry != leaf_counts_.end() && entry->second >= min_leaf_points_)
+      filtered_cloud_->points[kept++] = point;
+  }
+
+  filtered_cloud_->points.resize(kept);
+  filtered_cloud_->width = static_cast<uint32_t>(kept);
+  filtered_cloud_->height = 1;
 }
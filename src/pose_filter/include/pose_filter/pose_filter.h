@@ -51,6 +51,7 @@
 #include <ros/ros.h>
 #include <utils/math/transform_3d.h>
 #include <utils/math/acceleration_filter_1d.h>
+#include <utils/math/rotation.h>
 
 class PoseFilter {
  public:
@@ -61,6 +62,13 @@ class PoseFilter {
   void SetPose(Transform3D& pose);
   Transform3D GetPose() const;
 
+  // Predictive output: constant-acceleration extrapolation of the state
+  // by dt, straight from the state vector. No covariance propagation
+  // happens here -- corrections (UpdateICP/UpdateVO) keep doing the full
+  // bookkeeping -- so a publisher can call this at IMU rate between
+  // scan-match corrections for a low-latency pose stream.
+  Transform3D PredictPose(double dt) const;
+
   // Propagate and update steps.
   void Propagate(double dt);
   void UpdateIMU(double ax, double ay, double az,
@@ -100,6 +108,30 @@ Transform3D PoseFilter::GetPose() const {
   return pose;
 }
 
+// Predict the pose dt seconds ahead without touching the filter state.
+Transform3D PoseFilter::PredictPose(double dt) const {
+  const double half_dt_sq = 0.5 * dt * dt;
+
+  Eigen::Vector3d position(
+    x_.GetPosition() + x_.GetVelocity() * dt
+      + x_.GetAcceleration() * half_dt_sq,
+    y_.GetPosition() + y_.GetVelocity() * dt
+      + y_.GetAcceleration() * half_dt_sq,
+    z_.GetPosition() + z_.GetVelocity() * dt
+      + z_.GetAcceleration() * half_dt_sq);
+
+  Eigen::Matrix3d rotation = math::EulerAnglesToMatrix(
+    yaw_.GetPosition() + yaw_.GetVelocity() * dt
+      + yaw_.GetAcceleration() * half_dt_sq,
+    pitch_.GetPosition() + pitch_.GetVelocity() * dt
+      + pitch_.GetAcceleration() * half_dt_sq,
+    roll_.GetPosition() + roll_.GetVelocity() * dt
+      + roll_.GetAcceleration() * half_dt_sq);
+
+  Transform3D pose(rotation, position);
+  return pose;
+}
+
 // Propagate and update steps.
 // TODO -- Estimate actual noise characteristics!
 void PoseFilter::Propagate(double dt) {
@@ -47,16 +47,28 @@
 
 #include <ros/ros.h>
 #include <utils/map/array_3d.h>
+#include <utils/timing/trace.h>
+#include <utils/map/packed_array_3d.h>
 #include <octomap_msgs/conversions.h>
 #include <octomap_msgs/Octomap.h>
 #include <octomap/OcTree.h>
 #include <octomap/AbstractOcTree.h>
 
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl/point_types.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl_conversions/pcl_conversions.h>
+
 #include <Eigen/Dense>
 #include <cmath>
+#include <algorithm>
 #include <unordered_set>
 #include <limits>
 #include <tuple>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 
 class ShadeNewmanExploration {
 public:
@@ -72,54 +84,133 @@ public:
 
 
 private:
+  // Dirty-region tracking. The potential field is retained across solves
+  // as a warm start, so relaxation only needs to revisit the box whose
+  // boundary conditions changed (plus a halo), not the whole grid.
+  void MarkDirty(size_t ii, size_t jj, size_t kk);
+  void MarkAllDirty();
+  void ClearDirty();
   bool LoadParameters(const ros::NodeHandle& n);
   bool RegisterCallbacks(const ros::NodeHandle& n);
 
   // Main callback. For each new map update, choose a direction.
   void MapCallback(const octomap_msgs::Octomap& msg);
 
+  // Incremental callback: patch only the cells listed in a changeset
+  // message, leaving the rest of the grid untouched.
+  void ChangesCallback(const sensor_msgs::PointCloud2::ConstPtr& msg);
+
+  // Solver thread: deserialize and rasterize only the newest pending map.
+  void SolverThread();
+
   // Convert an Octomap octree to a regular grid.
   bool GenerateOccupancyGrid(octomap::OcTree* octree);
   bool IndicesToCoordinates(size_t ii, size_t jj, size_t kk,
                             double& x, double& y, double& z) const;
   bool CoordinatesToIndices(double x, double y, double z,
                             size_t& ii, size_t& jj, size_t& kk) const;
+  void ClampToIndices(double x, double y, double z,
+                      size_t& ii, size_t& jj, size_t& kk) const;
   bool IndicesToIndex(size_t ii, size_t jj, size_t kk, size_t& idx) const;
   bool IndexToIndices(size_t idx, size_t& ii, size_t& jj, size_t& kk) const;
 
   // Helper LaplaceIteration() does one iteration of Laplace solving, and
-  // returns the maximum relative error.
+  // returns the maximum absolute update. Each iteration is a red-black
+  // successive over-relaxation sweep: cells of one parity only read cells
+  // of the other, so each color relaxes in parallel slabs.
   double LaplaceIteration(size_t pose_ii, size_t pose_jj, size_t pose_kk);
+  double RelaxColor(size_t color, size_t pose_ii, size_t pose_jj,
+                    size_t pose_kk);
+  void RelaxSlab(size_t color, size_t begin, size_t end, size_t pose_ii,
+                 size_t pose_jj, size_t pose_kk, double* max_delta);
   double GetLocalMean(size_t ii, size_t jj, size_t kk) const;
 
+  // Geometric multigrid. Restrict the occupancy mask into a pyramid of
+  // 2x-coarsened levels, solve coarsest first, and prolong each solution
+  // down as the next level's warm start, finishing with full-resolution
+  // sweeps. One grid level used by the multigrid solver:
+  struct GridLevel {
+    size_t length, width, height;
+    PackedArray3D* occupancy;
+    Array3D<double>* potential;
+  };
+
+  void SolveMultigrid(size_t pose_ii, size_t pose_jj, size_t pose_kk);
+  double RelaxLevel(const GridLevel& level, size_t pose_ii, size_t pose_jj,
+                    size_t pose_kk);
+  double GetLevelMean(const GridLevel& level, size_t ii, size_t jj,
+                      size_t kk) const;
+
   // Helper GetSteepestDescent() finds the direction of steepest descent
-  // from the robot's current position.
+  // from the robot's current position. When the cached gradient field is
+  // valid it is a trilinear interpolation -- O(1) per query pose -- so
+  // multiple lookahead poses can be scored per planning tick.
   bool GetSteepestDescent(double pose_x, double pose_y, double pose_z,
                           double& dir_x, double& dir_y, double& dir_z) const;
+
+  // One pass over the solve box after the converged sweep writes the
+  // packed gradient field consumed by GetSteepestDescent.
+  void UpdateGradientField();
   bool GetGradient(size_t ii, size_t jj, size_t kk,
                    double& dir_x, double& dir_y, double& dir_z) const;
 
-  // Update list of frontier voxels.
+  // Update list of frontier voxels. FindFrontiers() rebuilds the whole
+  // index; UpdateFrontierAt() reclassifies a single cell, so incremental
+  // occupancy changes cost O(changed cells) instead of O(grid).
   bool FindFrontiers();
+  void UpdateFrontierAt(size_t ii, size_t jj, size_t kk);
+  bool HasFreeNeighbor(size_t ii, size_t jj, size_t kk) const;
 
   // Types for occupancy grid.
   typedef enum OccupancyEnum {OCCUPIED, FREE, UNKNOWN} OccupancyType;
 
-  // Member variables.
+  // Member variables. Occupancy packs three states into 2 bits per cell,
+  // 32 cells to a word.
   Array3D<double>* potential_;
-  Array3D<OccupancyType>* occupancy_;
+  PackedArray3D* occupancy_;
+
+  // Cached gradient field of the converged potential (zero outside free
+  // cells), interpolated trilinearly at query poses.
+  Array3D<float>* gradient_x_;
+  Array3D<float>* gradient_y_;
+  Array3D<float>* gradient_z_;
+  bool gradient_valid_;
   std::unordered_set<size_t> frontiers_, obstacles_;
   ros::Subscriber octomap_subscriber_;
+  ros::Subscriber changes_subscriber_;
+  timing::TraceEmitter trace_;
+
+  // Latest-wins map mailbox: the subscriber callback only deposits the
+  // newest serialized map, and the solver thread drops any map that was
+  // superseded before it got processed.
+  std::mutex mailbox_mutex_;
+  std::condition_variable mailbox_ready_;
+  octomap_msgs::Octomap pending_map_;
+  bool map_pending_, solver_running_;
+  size_t dropped_maps_;
+  std::thread solver_thread_;
+  std::mutex grid_mutex_;
 
   double occupied_lower_threshold_; // lower bound on occupied likelihood
   double free_upper_threshold_;     // upper bound on free likelihood
   double xmin_, xmax_, ymin_, ymax_, zmin_, zmax_; // bounding box
   size_t length_, width_, height_;
+  // Dirty bounding box and the sub-box the current solve sweeps over.
+  size_t dirty_ii0_, dirty_jj0_, dirty_kk0_;
+  size_t dirty_ii1_, dirty_jj1_, dirty_kk1_;
+  size_t solve_ii0_, solve_jj0_, solve_kk0_;
+  size_t solve_ii1_, solve_jj1_, solve_kk1_;
+  bool dirty_any_, dirty_all_;
+
   double resolution_; // grid resolution
   double tolerance_;  // tolerance for Laplace solver
+  double sor_omega_;  // over-relaxation factor
   int niter_;         // number of interations in Laplace solver
+  int solver_threads_; // worker threads per relaxation color
+  bool multigrid_mode_; // solve coarse-to-fine over a grid pyramid
   bool initialized_;
   std::string octomap_topic_;
+  std::string changes_topic_;
   std::string goal_topic_;
   std::string name_;
 };
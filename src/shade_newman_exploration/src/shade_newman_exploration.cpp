@@ -45,8 +45,21 @@
 #include <shade_newman_exploration/shade_newman_exploration.h>
 
 // Constructor/destructor.
-ShadeNewmanExploration::ShadeNewmanExploration() : initialized_(false) {}
-ShadeNewmanExploration::~ShadeNewmanExploration() {}
+ShadeNewmanExploration::ShadeNewmanExploration()
+  : initialized_(false), map_pending_(false), solver_running_(false),
+    dropped_maps_(0) {}
+
+ShadeNewmanExploration::~ShadeNewmanExploration() {
+  // Unblock and join the solver thread.
+  {
+    std::lock_guard<std::mutex> lock(mailbox_mutex_);
+    solver_running_ = false;
+  }
+  mailbox_ready_.notify_all();
+
+  if (solver_thread_.joinable())
+    solver_thread_.join();
+}
 
 // Initialize.
 bool ShadeNewmanExploration::Initialize(const ros::NodeHandle& n) {
@@ -68,12 +81,53 @@ bool ShadeNewmanExploration::Initialize(const ros::NodeHandle& n) {
   height_ = static_cast<size_t>((zmax_ - zmin_) / resolution_);
 
   potential_ = new Array3D<double>(length_, width_, height_);
-  occupancy_ = new Array3D<OccupancyType>(length_, width_, height_);
+  occupancy_ = new PackedArray3D(length_, width_, height_);
+  gradient_x_ = new Array3D<float>(length_, width_, height_);
+  gradient_y_ = new Array3D<float>(length_, width_, height_);
+  gradient_z_ = new Array3D<float>(length_, width_, height_);
+  gradient_valid_ = false;
+  MarkAllDirty();
+
+  // Spin up the solver thread.
+  solver_running_ = true;
+  solver_thread_ = std::thread(&ShadeNewmanExploration::SolverThread, this);
 
   initialized_ = true;
   return true;
 }
 
+// Expand the dirty box to include a changed cell.
+void ShadeNewmanExploration::MarkDirty(size_t ii, size_t jj, size_t kk) {
+  if (!dirty_any_) {
+    dirty_ii0_ = dirty_ii1_ = ii;
+    dirty_jj0_ = dirty_jj1_ = jj;
+    dirty_kk0_ = dirty_kk1_ = kk;
+    dirty_any_ = true;
+    return;
+  }
+
+  dirty_ii0_ = std::min(dirty_ii0_, ii);
+  dirty_jj0_ = std::min(dirty_jj0_, jj);
+  dirty_kk0_ = std::min(dirty_kk0_, kk);
+  dirty_ii1_ = std::max(dirty_ii1_, ii);
+  dirty_jj1_ = std::max(dirty_jj1_, jj);
+  dirty_kk1_ = std::max(dirty_kk1_, kk);
+}
+
+void ShadeNewmanExploration::MarkAllDirty() {
+  dirty_ii0_ = dirty_jj0_ = dirty_kk0_ = 0;
+  dirty_ii1_ = length_ - 1;
+  dirty_jj1_ = width_ - 1;
+  dirty_kk1_ = height_ - 1;
+  dirty_any_ = true;
+  dirty_all_ = true;
+}
+
+void ShadeNewmanExploration::ClearDirty() {
+  dirty_any_ = false;
+  dirty_all_ = false;
+}
+
 // Load parameters.
 bool ShadeNewmanExploration::LoadParameters(const ros::NodeHandle& n) {
   // Bounding box and resolution.
@@ -97,10 +151,20 @@ bool ShadeNewmanExploration::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!ros::param::get("/uav_slam/shade_newman/niter", niter_))
     return false;
+  if (!ros::param::get("/uav_slam/shade_newman/sor_omega", sor_omega_))
+    return false;
+  if (!ros::param::get("/uav_slam/shade_newman/solver_threads",
+                       solver_threads_))
+    return false;
+  if (!ros::param::get("/uav_slam/shade_newman/multigrid_mode",
+                       multigrid_mode_))
+    return false;
 
   // I/O.
   if (!ros::param::get("/uav_slam/shade_newman/octomap_topic", octomap_topic_))
     return false;
+  if (!ros::param::get("/uav_slam/shade_newman/changes_topic", changes_topic_))
+    return false;
   if (!ros::param::get("/uav_slam/shade_newman/goal_topic", goal_topic_))
     return false;
 
@@ -116,19 +180,109 @@ bool ShadeNewmanExploration::RegisterCallbacks(const ros::NodeHandle& n) {
     node.subscribe<const octomap_msgs::Octomap&>(octomap_topic_.c_str(), 20,
                                           &ShadeNewmanExploration::MapCallback, this);
 
+  // Changeset subscriber, for incremental grid updates between full maps.
+  changes_subscriber_ =
+    node.subscribe(changes_topic_.c_str(), 20,
+                   &ShadeNewmanExploration::ChangesCallback, this);
+
+  // Cross-node trace sidecar.
+  trace_.Advertise(node);
+
   return true;
 }
 
-// Main callback. For each new map update, choose a direction.
+// Incremental callback. TrackingOctomapServer publishes the centers of
+// changed cells with occupancy encoded in the intensity channel, so only
+// the affected cells are patched and the rest of the grid is untouched.
+void ShadeNewmanExploration::ChangesCallback(
+  const sensor_msgs::PointCloud2::ConstPtr& msg) {
+  pcl::PointCloud<pcl::PointXYZI> changes;
+  pcl::fromROSMsg(*msg, changes);
+
+  std::lock_guard<std::mutex> lock(grid_mutex_);
+
+  for (size_t ii = 0; ii < changes.points.size(); ii++) {
+    const pcl::PointXYZI& point = changes.points[ii];
+
+    // Quietly skip changes outside the exploration volume.
+    if (point.x <= xmin_ || point.x >= xmax_ ||
+        point.y <= ymin_ || point.y >= ymax_ ||
+        point.z <= zmin_ || point.z >= zmax_)
+      continue;
+
+    size_t gi, gj, gk;
+    ClampToIndices(point.x, point.y, point.z, gi, gj, gk);
+    occupancy_->Set(gi, gj, gk, (point.intensity > 0.0f) ? OCCUPIED : FREE);
+    MarkDirty(gi, gj, gk);
+
+    // Reclassify the changed cell and its neighbors in the frontier
+    // index, instead of rescanning the grid later.
+    UpdateFrontierAt(gi, gj, gk);
+    if (gi > 0)
+      UpdateFrontierAt(gi - 1, gj, gk);
+    if (gi + 1 < length_)
+      UpdateFrontierAt(gi + 1, gj, gk);
+    if (gj > 0)
+      UpdateFrontierAt(gi, gj - 1, gk);
+    if (gj + 1 < width_)
+      UpdateFrontierAt(gi, gj + 1, gk);
+    if (gk > 0)
+      UpdateFrontierAt(gi, gj, gk - 1);
+    if (gk + 1 < height_)
+      UpdateFrontierAt(gi, gj, gk + 1);
+  }
+}
+
+// Main callback. Deposit the newest map in the mailbox: a map still
+// waiting there is obsolete the moment a fresher one arrives, so it is
+// dropped instead of processed.
 void ShadeNewmanExploration::MapCallback(const octomap_msgs::Octomap& msg) {
-  // Deserialize octree.
-  octomap::AbstractOcTree* abstract_octree = octomap_msgs::fullMsgToMap(msg);
-  octomap::OcTree* octree = dynamic_cast<octomap::OcTree*>(abstract_octree);
+  // Correlate the goal computation with the map's stamp: "how old is the
+  // map this goal came from" becomes a timeline lookup.
+  trace_.Emit(msg.header.stamp.toNSec(), "shade_newman/map_receive");
 
-  // Generate a dense, regular occupancy grid.
-  if (!GenerateOccupancyGrid(octree)) {
-    ROS_ERROR("%s: Failed to generate a regular occupancy grid.", name_.c_str());
-    return;
+  {
+    std::lock_guard<std::mutex> lock(mailbox_mutex_);
+    if (map_pending_)
+      dropped_maps_++;
+
+    pending_map_ = msg;
+    map_pending_ = true;
+  }
+
+  mailbox_ready_.notify_one();
+}
+
+// Solver thread. Deserialization and rasterization happen here, off the
+// subscriber thread, and always against only the newest map.
+void ShadeNewmanExploration::SolverThread() {
+  while (true) {
+    octomap_msgs::Octomap msg;
+    {
+      std::unique_lock<std::mutex> lock(mailbox_mutex_);
+      while (!map_pending_ && solver_running_)
+        mailbox_ready_.wait(lock);
+
+      if (!solver_running_)
+        return;
+
+      msg = pending_map_;
+      map_pending_ = false;
+    }
+
+    // Deserialize octree.
+    octomap::AbstractOcTree* abstract_octree = octomap_msgs::fullMsgToMap(msg);
+    octomap::OcTree* octree = dynamic_cast<octomap::OcTree*>(abstract_octree);
+
+    // Generate a dense, regular occupancy grid.
+    {
+      std::lock_guard<std::mutex> grid_lock(grid_mutex_);
+      if (!GenerateOccupancyGrid(octree))
+        ROS_ERROR("%s: Failed to generate a regular occupancy grid.",
+                  name_.c_str());
+    }
+
+    delete abstract_octree;
   }
 }
 
@@ -169,31 +323,75 @@ bool ShadeNewmanExploration::CoordinatesToIndices(double x, double y, double z,
 }
 
 
-// Convert an Octomap octree to a regular grid.
+// Convert an Octomap octree to a regular grid. Rather than descending the
+// octree once per grid cell, walk the leaves once and paint each leaf's
+// whole extent; cells under no leaf stay UNKNOWN by default, which also
+// covers the null returns octree->search() used to produce.
 bool ShadeNewmanExploration::GenerateOccupancyGrid(octomap::OcTree* octree) {
-  double x, y, z;
-
-  // Iterate over voxels.
-  for (size_t ii = 0; ii < length_; ii++) {
-    for (size_t jj = 0; jj < width_; jj++) {
-      for (size_t kk = 0; kk < height_; kk++) {
-        if (!IndicesToCoordinates(ii, jj, kk, x, y, z)) {
-          ROS_WARN("%s: Indices out of bounds.", name_.c_str());
-          continue;
-        }
+  if (octree == NULL) {
+    ROS_ERROR("%s: Octree is null.", name_.c_str());
+    return false;
+  }
 
-        // Query octree and set voxel grid.
-        double occupancy_probability = octree->search(x, y, z)->getOccupancy();
-        if (occupancy_probability > occupied_lower_threshold_)
-          occupancy_->At(ii, jj, kk) = OCCUPIED;
-        else if (occupancy_probability < free_upper_threshold_)
-          occupancy_->At(ii, jj, kk) = FREE;
-        else
-          occupancy_->At(ii, jj, kk) = UNKNOWN;
-      }
-    }
+  // Unknown space is the cheap default. A full rebuild invalidates the
+  // whole retained potential field.
+  MarkAllDirty();
+  occupancy_->Fill(UNKNOWN);
+
+  // Single pass over the leaves intersecting the grid's bounding box.
+  const octomap::point3d bbx_min(xmin_, ymin_, zmin_);
+  const octomap::point3d bbx_max(xmax_, ymax_, zmax_);
+  for (octomap::OcTree::leaf_bbx_iterator it =
+         octree->begin_leafs_bbx(bbx_min, bbx_max),
+         end = octree->end_leafs_bbx(); it != end; ++it) {
+    const double occupancy_probability = it->getOccupancy();
+
+    OccupancyType type;
+    if (occupancy_probability > occupied_lower_threshold_)
+      type = OCCUPIED;
+    else if (occupancy_probability < free_upper_threshold_)
+      type = FREE;
+    else
+      continue;
+
+    // Paint the leaf's full extent in one shot. Coarse leaves cover many
+    // grid cells, so this touches each cell exactly once.
+    const double half_size = 0.5 * it.getSize();
+    size_t ii0, jj0, kk0, ii1, jj1, kk1;
+    ClampToIndices(it.getX() - half_size, it.getY() - half_size,
+                   it.getZ() - half_size, ii0, jj0, kk0);
+    ClampToIndices(it.getX() + half_size - 0.5 * resolution_,
+                   it.getY() + half_size - 0.5 * resolution_,
+                   it.getZ() + half_size - 0.5 * resolution_, ii1, jj1, kk1);
+
+    // Leaves finer than the grid still paint the cell they fall in.
+    ii1 = std::max(ii0, ii1);
+    jj1 = std::max(jj0, jj1);
+    kk1 = std::max(kk0, kk1);
+
+    for (size_t ii = ii0; ii <= ii1; ii++)
+      for (size_t jj = jj0; jj <= jj1; jj++)
+        for (size_t kk = kk0; kk <= kk1; kk++)
+          occupancy_->Set(ii, jj, kk, type);
   }
 
+  // A full rebuild invalidates the incremental frontier index.
+  FindFrontiers();
+
+  return true;
+}
+
+// Clamp world coordinates into grid indices, saturating at the box edges.
+void ShadeNewmanExploration::ClampToIndices(double x, double y, double z,
+                                            size_t& ii, size_t& jj,
+                                            size_t& kk) const {
+  const double cx = std::min(std::max(x, xmin_), xmax_ - 0.5 * resolution_);
+  const double cy = std::min(std::max(y, ymin_), ymax_ - 0.5 * resolution_);
+  const double cz = std::min(std::max(z, zmin_), zmax_ - 0.5 * resolution_);
+
+  ii = std::min(static_cast<size_t>((cx - xmin_) / resolution_), length_ - 1);
+  jj = std::min(static_cast<size_t>((cy - ymin_) / resolution_), width_ - 1);
+  kk = std::min(static_cast<size_t>((cz - zmin_) / resolution_), height_ - 1);
 }
 
 // Solve Laplace's equation on the grid. SolveLaplace() sets its arguments to
@@ -209,6 +407,10 @@ bool ShadeNewmanExploration::SolveLaplace(double pose_x, double pose_y,
   }
 #endif
 
+  // Hold the grid lock for the whole solve, so the solver thread cannot
+  // re-rasterize underneath the relaxation sweeps.
+  std::lock_guard<std::mutex> lock(grid_mutex_);
+
   // Get robot pose indices.
   size_t pose_ii, pose_jj, pose_kk;
   if (!CoordinatesToIndices(pose_x, pose_y, pose_z, pose_ii, pose_jj, pose_kk)) {
@@ -216,9 +418,31 @@ bool ShadeNewmanExploration::SolveLaplace(double pose_x, double pose_y,
     return false;
   }
 
+  // The moving Dirichlet condition at the robot dirties its cell too.
+  MarkDirty(pose_ii, pose_jj, pose_kk);
+
+  // Concentrate relaxation on the dirty box plus a halo: the retained
+  // potential field is still converged everywhere else.
+  const size_t kDirtyHalo = 8;
+  solve_ii0_ = (dirty_ii0_ > kDirtyHalo) ? dirty_ii0_ - kDirtyHalo : 0;
+  solve_jj0_ = (dirty_jj0_ > kDirtyHalo) ? dirty_jj0_ - kDirtyHalo : 0;
+  solve_kk0_ = (dirty_kk0_ > kDirtyHalo) ? dirty_kk0_ - kDirtyHalo : 0;
+  solve_ii1_ = std::min(dirty_ii1_ + kDirtyHalo, length_ - 1);
+  solve_jj1_ = std::min(dirty_jj1_ + kDirtyHalo, width_ - 1);
+  solve_kk1_ = std::min(dirty_kk1_ + kDirtyHalo, height_ - 1);
+
+  // Seed the fine grid from a coarse-to-fine multigrid cascade on full
+  // rebuilds, so the sweeps below only polish an already-close field.
+  if (multigrid_mode_ && dirty_all_)
+    SolveMultigrid(pose_ii, pose_jj, pose_kk);
+
   // Solve the Laplace equation on this regular grid.
   for (size_t ii = 0; ii < niter_; ii++) {
     if (LaplaceIteration(pose_ii, pose_jj, pose_kk) < tolerance_) {
+      // Refresh the cached gradient field over the region just solved.
+      UpdateGradientField();
+      ClearDirty();
+
       double x, y, z;
       if (!GetSteepestDescent(pose_x, pose_y, pose_z, dir_x, dir_y, dir_z)) {
         ROS_ERROR("%s: Error finding direction of steepest descent.",
@@ -237,6 +461,26 @@ bool ShadeNewmanExploration::SolveLaplace(double pose_x, double pose_y,
   return false;
 }
 
+// One pass over the solve box writes the gradient of the converged
+// potential for every free cell (zero elsewhere).
+void ShadeNewmanExploration::UpdateGradientField() {
+  for (size_t ii = solve_ii0_; ii <= solve_ii1_; ii++) {
+    for (size_t jj = solve_jj0_; jj <= solve_jj1_; jj++) {
+      for (size_t kk = solve_kk0_; kk <= solve_kk1_; kk++) {
+        double gx = 0.0, gy = 0.0, gz = 0.0;
+        if (occupancy_->At(ii, jj, kk) == FREE)
+          GetGradient(ii, jj, kk, gx, gy, gz);
+
+        gradient_x_->At(ii, jj, kk) = static_cast<float>(gx);
+        gradient_y_->At(ii, jj, kk) = static_cast<float>(gy);
+        gradient_z_->At(ii, jj, kk) = static_cast<float>(gz);
+      }
+    }
+  }
+
+  gradient_valid_ = true;
+}
+
 // Helper GetSteepestDescent() finds the direction of steepest descent
 // from the robot's current position. If there's an out of bounds error,
 // return dir_x/y/z = 0.
@@ -251,6 +495,47 @@ bool ShadeNewmanExploration::GetSteepestDescent(double pose_x, double pose_y,
     return false;
   }
 
+  // Fast path: trilinear interpolation of the cached gradient field.
+  if (gradient_valid_ && length_ >= 2 && width_ >= 2 && height_ >= 2) {
+    const double fx = (pose_x - xmin_) / resolution_ - 0.5;
+    const double fy = (pose_y - ymin_) / resolution_ - 0.5;
+    const double fz = (pose_z - zmin_) / resolution_ - 0.5;
+
+    const double cx = std::min(std::max(fx, 0.0),
+                               static_cast<double>(length_ - 2));
+    const double cy = std::min(std::max(fy, 0.0),
+                               static_cast<double>(width_ - 2));
+    const double cz = std::min(std::max(fz, 0.0),
+                               static_cast<double>(height_ - 2));
+
+    const size_t i0 = static_cast<size_t>(cx);
+    const size_t j0 = static_cast<size_t>(cy);
+    const size_t k0 = static_cast<size_t>(cz);
+    const double wx = cx - i0;
+    const double wy = cy - j0;
+    const double wz = cz - k0;
+
+    dir_x = dir_y = dir_z = 0.0;
+    for (size_t di = 0; di < 2; di++) {
+      for (size_t dj = 0; dj < 2; dj++) {
+        for (size_t dk = 0; dk < 2; dk++) {
+          const double weight =
+            (di ? wx : 1.0 - wx) * (dj ? wy : 1.0 - wy) *
+            (dk ? wz : 1.0 - wz);
+          dir_x += weight * gradient_x_->At(i0 + di, j0 + dj, k0 + dk);
+          dir_y += weight * gradient_y_->At(i0 + di, j0 + dj, k0 + dk);
+          dir_z += weight * gradient_z_->At(i0 + di, j0 + dj, k0 + dk);
+        }
+      }
+    }
+
+    if (dir_x * dir_x + dir_y * dir_y + dir_z * dir_z > 0.0)
+      return true;
+
+    // Interpolated gradient vanished (e.g. surrounded by blocked cells):
+    // fall through to the neighborhood search below.
+  }
+
   // Find the local gradient in the 26-connected neighborhood.
   double best_dir_x, best_dir_y, best_dir_z;
   double best_dir_mag = -1.0;
@@ -378,91 +663,322 @@ bool ShadeNewmanExploration::GetGradient(size_t ii, size_t jj, size_t kk,
   return true;
 }
 
-// Helper LaplaceIteration() does one iteration of Laplace solving, and
-// returns the maximum relative change.
+// Helper LaplaceIteration() does one red-black SOR iteration and returns
+// the maximum absolute update.
 double ShadeNewmanExploration::LaplaceIteration(size_t pose_ii, size_t pose_jj,
                                                 size_t pose_kk) {
-  double max_delta = -std::numeric_limits<double>::infinity();
-
   // Set robot pose potential to unity.
   potential_->At(pose_ii, pose_jj, pose_kk) = 1.0;
 
-  // Iterate over all free voxels and update.
-  for (size_t ii = 0; ii < length_; ii++) {
-    for (size_t jj = 0; jj < width_; jj++) {
-      for (size_t kk = 0; kk < height_; kk++) {
-        if (!occupancy_->At(ii, jj, kk) == FREE)
+  // Relax red cells, then black cells.
+  double max_delta = RelaxColor(0, pose_ii, pose_jj, pose_kk);
+  max_delta = std::max(max_delta, RelaxColor(1, pose_ii, pose_jj, pose_kk));
+  return max_delta;
+}
+
+// Relax every cell of one parity. The six-neighbor stencil only reads
+// cells of the opposite parity, so slabs of a single color can update in
+// parallel without ever racing.
+double ShadeNewmanExploration::RelaxColor(size_t color, size_t pose_ii,
+                                          size_t pose_jj, size_t pose_kk) {
+  const size_t num_workers =
+    std::max(static_cast<size_t>(solver_threads_), static_cast<size_t>(1));
+
+  const size_t span = solve_ii1_ - solve_ii0_ + 1;
+
+  if (num_workers == 1) {
+    double max_delta = -std::numeric_limits<double>::infinity();
+    RelaxSlab(color, solve_ii0_, solve_ii1_ + 1, pose_ii, pose_jj, pose_kk,
+              &max_delta);
+    return max_delta;
+  }
+
+  std::vector<double> deltas(num_workers,
+                             -std::numeric_limits<double>::infinity());
+  std::vector<std::thread> workers;
+  const size_t stride = (span + num_workers - 1) / num_workers;
+  for (size_t tt = 0; tt < num_workers; tt++) {
+    const size_t begin = solve_ii0_ + tt * stride;
+    if (begin > solve_ii1_)
+      break;
+
+    workers.push_back(std::thread(&ShadeNewmanExploration::RelaxSlab, this,
+                                  color, begin,
+                                  std::min(begin + stride, solve_ii1_ + 1),
+                                  pose_ii, pose_jj, pose_kk, &deltas[tt]));
+  }
+
+  double max_delta = -std::numeric_limits<double>::infinity();
+  for (size_t tt = 0; tt < workers.size(); tt++) {
+    workers[tt].join();
+    max_delta = std::max(max_delta, deltas[tt]);
+  }
+
+  return max_delta;
+}
+
+// Geometric multigrid cascade. Each level halves every dimension; a cell
+// is FREE on the coarse level when any of its children is FREE (keeping
+// corridors open), else OCCUPIED when any child is OCCUPIED. Solving the
+// coarsest level first and prolonging down gives each finer level a warm
+// start, so convergence iterations no longer scale with grid dimension.
+void ShadeNewmanExploration::SolveMultigrid(size_t pose_ii, size_t pose_jj,
+                                            size_t pose_kk) {
+  // Build the pyramid, fine to coarse. Level 0 aliases the live grids.
+  std::vector<GridLevel> levels;
+  GridLevel fine;
+  fine.length = length_; fine.width = width_; fine.height = height_;
+  fine.occupancy = occupancy_;
+  fine.potential = potential_;
+  levels.push_back(fine);
+
+  while (levels.back().length >= 16 && levels.back().width >= 16 &&
+         levels.back().height >= 16 && levels.size() < 4) {
+    const GridLevel& child = levels.back();
+
+    GridLevel parent;
+    parent.length = child.length / 2;
+    parent.width = child.width / 2;
+    parent.height = child.height / 2;
+    parent.occupancy =
+      new PackedArray3D(parent.length, parent.width, parent.height);
+    parent.potential =
+      new Array3D<double>(parent.length, parent.width, parent.height);
+
+    // Restrict occupancy: any FREE child keeps the coarse cell FREE.
+    for (size_t ii = 0; ii < parent.length; ii++) {
+      for (size_t jj = 0; jj < parent.width; jj++) {
+        for (size_t kk = 0; kk < parent.height; kk++) {
+          bool any_free = false, any_occupied = false;
+          for (size_t di = 0; di < 2; di++) {
+            for (size_t dj = 0; dj < 2; dj++) {
+              for (size_t dk = 0; dk < 2; dk++) {
+                const uint8_t type =
+                  child.occupancy->At(2 * ii + di, 2 * jj + dj, 2 * kk + dk);
+                any_free |= (type == FREE);
+                any_occupied |= (type == OCCUPIED);
+              }
+            }
+          }
+
+          if (any_free)
+            parent.occupancy->Set(ii, jj, kk, FREE);
+          else if (any_occupied)
+            parent.occupancy->Set(ii, jj, kk, OCCUPIED);
+          else
+            parent.occupancy->Set(ii, jj, kk, UNKNOWN);
+
+          parent.potential->At(ii, jj, kk) = 0.0;
+        }
+      }
+    }
+
+    levels.push_back(parent);
+  }
+
+  // Solve coarse to fine, prolonging each solution down as a warm start.
+  for (size_t level = levels.size() - 1; level > 0; level--) {
+    const GridLevel& coarse = levels[level];
+    const GridLevel& finer = levels[level - 1];
+
+    const size_t scale = static_cast<size_t>(1) << level;
+    const size_t cp_ii = std::min(pose_ii / scale, coarse.length - 1);
+    const size_t cp_jj = std::min(pose_jj / scale, coarse.width - 1);
+    const size_t cp_kk = std::min(pose_kk / scale, coarse.height - 1);
+
+    for (int iter = 0; iter < niter_; iter++) {
+      if (RelaxLevel(coarse, cp_ii, cp_jj, cp_kk) < tolerance_)
+        break;
+    }
+
+    // Prolong by injection into FREE cells of the finer level.
+    for (size_t ii = 0; ii < finer.length; ii++) {
+      for (size_t jj = 0; jj < finer.width; jj++) {
+        for (size_t kk = 0; kk < finer.height; kk++) {
+          if (finer.occupancy->At(ii, jj, kk) != FREE)
+            continue;
+
+          const size_t ci = std::min(ii / 2, coarse.length - 1);
+          const size_t cj = std::min(jj / 2, coarse.width - 1);
+          const size_t ck = std::min(kk / 2, coarse.height - 1);
+          finer.potential->At(ii, jj, kk) = coarse.potential->At(ci, cj, ck);
+        }
+      }
+    }
+  }
+
+  // Free everything but the live fine level.
+  for (size_t level = 1; level < levels.size(); level++) {
+    delete levels[level].occupancy;
+    delete levels[level].potential;
+  }
+}
+
+// One serial red-black SOR iteration on an arbitrary pyramid level.
+// Coarse levels are tiny, so threading them is not worth the spawns.
+double ShadeNewmanExploration::RelaxLevel(const GridLevel& level,
+                                          size_t pose_ii, size_t pose_jj,
+                                          size_t pose_kk) {
+  level.potential->At(pose_ii, pose_jj, pose_kk) = 1.0;
+
+  double max_delta = -std::numeric_limits<double>::infinity();
+  for (size_t color = 0; color < 2; color++) {
+    for (size_t ii = 0; ii < level.length; ii++) {
+      for (size_t jj = 0; jj < level.width; jj++) {
+        for (size_t kk = 0; kk < level.height; kk++) {
+          if ((ii + jj + kk) % 2 != color)
+            continue;
+
+          if (level.occupancy->At(ii, jj, kk) != FREE)
+            continue;
+
+          if (ii == pose_ii && jj == pose_jj && kk == pose_kk)
+            continue;
+
+          const double mean = GetLevelMean(level, ii, jj, kk);
+          const double delta = mean - level.potential->At(ii, jj, kk);
+          level.potential->At(ii, jj, kk) += sor_omega_ * delta;
+
+          if (std::abs(delta) > max_delta)
+            max_delta = std::abs(delta);
+        }
+      }
+    }
+  }
+
+  return max_delta;
+}
+
+// Local mean with boundary conditions on an arbitrary pyramid level,
+// through the same stride-based loads as the fine grid.
+double ShadeNewmanExploration::GetLevelMean(const GridLevel& level, size_t ii,
+                                            size_t jj, size_t kk) const {
+  const double* potential = level.potential->Data();
+  const size_t idx = level.potential->Index(ii, jj, kk);
+  const size_t x_stride = level.potential->XStride();
+  const size_t y_stride = level.potential->YStride();
+
+  size_t num_neighbors = 6;
+  double left, right, front, back, up, down;
+  left = right = front = back = up = down = 0.0;
+
+  if (ii == 0 || ii + 1 >= level.length ||
+      level.occupancy->Get(idx - x_stride) == OCCUPIED ||
+      level.occupancy->Get(idx + x_stride) == OCCUPIED) {
+    num_neighbors -= 2;
+  } else {
+    left = potential[idx - x_stride];
+    right = potential[idx + x_stride];
+  }
+
+  if (jj == 0 || jj + 1 >= level.width ||
+      level.occupancy->Get(idx - y_stride) == OCCUPIED ||
+      level.occupancy->Get(idx + y_stride) == OCCUPIED) {
+    num_neighbors -= 2;
+  } else {
+    back = potential[idx - y_stride];
+    front = potential[idx + y_stride];
+  }
+
+  if (kk == 0 || kk + 1 >= level.height ||
+      level.occupancy->Get(idx - 1) == OCCUPIED ||
+      level.occupancy->Get(idx + 1) == OCCUPIED) {
+    num_neighbors -= 2;
+  } else {
+    down = potential[idx - 1];
+    up = potential[idx + 1];
+  }
+
+  return (num_neighbors > 0) ?
+    (left + right + front + back + up + down) /
+      static_cast<double>(num_neighbors) : 0.0;
+}
+
+// Relax a contiguous slab of one color with successive over-relaxation.
+void ShadeNewmanExploration::RelaxSlab(size_t color, size_t begin, size_t end,
+                                       size_t pose_ii, size_t pose_jj,
+                                       size_t pose_kk, double* max_delta) {
+  double local_max = -std::numeric_limits<double>::infinity();
+
+  for (size_t ii = begin; ii < end; ii++) {
+    for (size_t jj = solve_jj0_; jj <= solve_jj1_; jj++) {
+      for (size_t kk = solve_kk0_; kk <= solve_kk1_; kk++) {
+        if ((ii + jj + kk) % 2 != color)
           continue;
 
-        if (ii == pose_ii && jj == pose_jj && kk == pose_kk)
+        if (occupancy_->At(ii, jj, kk) != FREE)
           continue;
 
-        // Calculate mean with boundary conditions.
-        double mean = GetLocalMean(ii, jj, kk);
+        if (ii == pose_ii && jj == pose_jj && kk == pose_kk)
+          continue;
 
-        // Update delta.
-        double delta = mean - potential_->At(ii, jj, kk);
-        if (delta > max_delta)
-          max_delta = delta;
+        // Calculate mean with boundary conditions and over-relax.
+        const double mean = GetLocalMean(ii, jj, kk);
+        const double delta = mean - potential_->At(ii, jj, kk);
+        potential_->At(ii, jj, kk) += sor_omega_ * delta;
 
-        // Update voxel.
-        potential_->At(ii, jj, kk) = mean;
+        if (std::abs(delta) > local_max)
+          local_max = std::abs(delta);
       }
     }
   }
 
-  return max_delta;
+  *max_delta = local_max;
 }
 
 // GetLocalMean() finds the local mean (including boundary conditions)
-// on the potential field.
+// on the potential field. Neighbors sit at fixed strides in the flat
+// slab, so each is one load instead of a recomputed 3D index.
 double ShadeNewmanExploration::GetLocalMean(size_t ii, size_t jj, size_t kk) const {
   if (!potential_->IsValid(ii, jj, kk)) {
     ROS_ERROR("%s: Out of bounds error.", name_.c_str());
     return std::numeric_limits<double>::infinity();
   }
 
+  const double* potential = potential_->Data();
+  const size_t idx = potential_->Index(ii, jj, kk);
+  const size_t x_stride = potential_->XStride();
+  const size_t y_stride = potential_->YStride();
+
   // Handle object boundaries.
   size_t num_neighbors = 6;
   double left, right, front, back, up, down;
   left = right = front = back = up = down = 0.0;
 
   // Check left/right.
-  if (!potential_->IsValid(ii - 1, jj, kk) ||
-      occupancy_->At(ii - 1, jj, kk) == OCCUPIED ||
-      !potential_->IsValid(ii + 1, jj, kk) ||
-      occupancy_->At(ii + 1, jj, kk) == OCCUPIED) {
+  if (ii == 0 || ii + 1 >= length_ ||
+      occupancy_->Get(idx - x_stride) == OCCUPIED ||
+      occupancy_->Get(idx + x_stride) == OCCUPIED) {
     num_neighbors -= 2;
   } else {
-    left = potential_->At(ii - 1, jj, kk);
-    right = potential_->At(ii + 1, jj, kk);
+    left = potential[idx - x_stride];
+    right = potential[idx + x_stride];
   }
 
   // Check back/front.
-  if (!potential_->IsValid(ii, jj - 1, kk) ||
-      occupancy_->At(ii, jj - 1, kk) == OCCUPIED ||
-      !potential_->IsValid(ii, jj + 1, kk) ||
-      occupancy_->At(ii, jj + 1, kk) == OCCUPIED) {
+  if (jj == 0 || jj + 1 >= width_ ||
+      occupancy_->Get(idx - y_stride) == OCCUPIED ||
+      occupancy_->Get(idx + y_stride) == OCCUPIED) {
     num_neighbors -= 2;
   } else {
-    back = potential_->At(ii, jj - 1, kk);
-    front = potential_->At(ii, jj + 1, kk);
+    back = potential[idx - y_stride];
+    front = potential[idx + y_stride];
   }
 
   // Check dwn/up.
-  if (!potential_->IsValid(ii, jj, kk - 1) ||
-      occupancy_->At(ii, jj, kk - 1) == OCCUPIED ||
-      !potential_->IsValid(ii, jj, kk + 1) ||
-      occupancy_->At(ii, jj, kk + 1) == OCCUPIED) {
+  if (kk == 0 || kk + 1 >= height_ ||
+      occupancy_->Get(idx - 1) == OCCUPIED ||
+      occupancy_->Get(idx + 1) == OCCUPIED) {
     num_neighbors -= 2;
   } else {
-    down = potential_->At(ii, jj, kk - 1);
-    up = potential_->At(ii, jj, kk + 1);
+    down = potential[idx - 1];
+    up = potential[idx + 1];
   }
 
   // Set mean and return.
   double mean = (num_neighbors > 0) ?
-    (left + right + front + back + up + down) : 0.0;
+    (left + right + front + back + up + down) /
+      static_cast<double>(num_neighbors) : 0.0;
   return mean;
 }
 
@@ -474,60 +990,73 @@ bool ShadeNewmanExploration::FindFrontiers() {
   frontiers_.clear();
   obstacles_.clear();
 
-  // Iterate over all voxels.
-  for (size_t ii = 0; ii < length_; ii++) {
-    for (size_t jj = 0; jj < width_; jj++) {
-      for (size_t kk = 0; kk < height_; kk++) {
-        // Frontier identification.
-        if (occupancy_->At(ii, jj, kk) == UNKNOWN) {
-          if ((occupancy_->IsValid(ii - 1, jj, kk) &&
-               occupancy_->At(ii - 1, jj, kk) == FREE) ||
-              (occupancy_->IsValid(ii + 1, jj, kk) &&
-               occupancy_->At(ii + 1, jj, kk) == FREE) ||
-              (occupancy_->IsValid(ii, jj - 1, kk) &&
-               occupancy_->At(ii, jj - 1, kk) == FREE) ||
-              (occupancy_->IsValid(ii, jj + 1, kk) &&
-               occupancy_->At(ii, jj + 1, kk) == FREE) ||
-              (occupancy_->IsValid(ii, jj, kk - 1) &&
-               occupancy_->At(ii, jj, kk - 1) == FREE) ||
-              (occupancy_->IsValid(ii, jj, kk + 1) &&
-               occupancy_->At(ii, jj, kk + 1) == FREE)) {
-            size_t idx;
-            if (!IndicesToIndex(ii, jj, kk, idx)) {
-              ROS_ERROR("%s: Out of bounds error.", name_.c_str());
-              continue;
-            }
+  // Scan 32 cells per load: a word with no UNKNOWN or OCCUPIED lane is
+  // skipped without visiting any of its cells, and within a candidate
+  // word only the matching lanes are visited.
+  const uint64_t* words = occupancy_->Words();
+  const size_t num_words = occupancy_->NumWords();
+  const size_t num_cells = length_ * width_ * height_;
 
-            frontiers_.insert(idx);
-          }
-        }
+  for (size_t ww = 0; ww < num_words; ww++) {
+    uint64_t candidates = PackedArray3D::MatchMask(words[ww], UNKNOWN) |
+      PackedArray3D::MatchMask(words[ww], OCCUPIED);
 
-        // Obstacle boundary identification.
-        else if (occupancy_->At(ii, jj, kk) == OCCUPIED) {
-          if ((occupancy_->IsValid(ii - 1, jj, kk) &&
-               occupancy_->At(ii - 1, jj, kk) == FREE) ||
-              (occupancy_->IsValid(ii + 1, jj, kk) &&
-               occupancy_->At(ii + 1, jj, kk) == FREE) ||
-              (occupancy_->IsValid(ii, jj - 1, kk) &&
-               occupancy_->At(ii, jj - 1, kk) == FREE) ||
-              (occupancy_->IsValid(ii, jj + 1, kk) &&
-               occupancy_->At(ii, jj + 1, kk) == FREE) ||
-              (occupancy_->IsValid(ii, jj, kk - 1) &&
-               occupancy_->At(ii, jj, kk - 1) == FREE) ||
-              (occupancy_->IsValid(ii, jj, kk + 1) &&
-               occupancy_->At(ii, jj, kk + 1) == FREE)) {
-            size_t idx;
-            if (!IndicesToIndex(ii, jj, kk, idx)) {
-              ROS_ERROR("%s: Out of bounds error.", name_.c_str());
-              continue;
-            }
+    while (candidates != 0) {
+      const size_t lane = __builtin_ctzll(candidates) / 2;
+      candidates &= candidates - 1;
 
-            obstacles_.insert(idx);
-          }
-        }
-      }
+      const size_t idx = ww * PackedArray3D::kCellsPerWord + lane;
+      if (idx >= num_cells)
+        break;
+
+      size_t ii, jj, kk;
+      if (!IndexToIndices(idx, ii, jj, kk))
+        continue;
+
+      if (!HasFreeNeighbor(ii, jj, kk))
+        continue;
+
+      if (occupancy_->Get(idx) == UNKNOWN)
+        frontiers_.insert(idx);
+      else
+        obstacles_.insert(idx);
     }
   }
+
+  return !frontiers_.empty();
+}
+
+// Reclassify one cell in the persistent frontier/obstacle index.
+void ShadeNewmanExploration::UpdateFrontierAt(size_t ii, size_t jj,
+                                              size_t kk) {
+  size_t idx;
+  if (!IndicesToIndex(ii, jj, kk, idx))
+    return;
+
+  const uint8_t type = occupancy_->Get(idx);
+  const bool boundary = (type != FREE) && HasFreeNeighbor(ii, jj, kk);
+
+  if (type == UNKNOWN && boundary) {
+    frontiers_.insert(idx);
+    obstacles_.erase(idx);
+  } else if (type == OCCUPIED && boundary) {
+    obstacles_.insert(idx);
+    frontiers_.erase(idx);
+  } else {
+    frontiers_.erase(idx);
+    obstacles_.erase(idx);
+  }
+}
+
+// Test whether any of the six neighbors is FREE.
+bool ShadeNewmanExploration::HasFreeNeighbor(size_t ii, size_t jj,
+                                             size_t kk) const {
+  return (ii > 0 && occupancy_->At(ii - 1, jj, kk) == FREE) ||
+    (ii + 1 < length_ && occupancy_->At(ii + 1, jj, kk) == FREE) ||
+    (jj > 0 && occupancy_->At(ii, jj - 1, kk) == FREE) ||
+    (jj + 1 < width_ && occupancy_->At(ii, jj + 1, kk) == FREE) ||
+    (kk > 0 && occupancy_->At(ii, jj, kk - 1) == FREE) ||
+    (kk + 1 < height_ && occupancy_->At(ii, jj, kk + 1) == FREE);
 }
 
 // Indices to index. Get a single 1D index from a 3D index.
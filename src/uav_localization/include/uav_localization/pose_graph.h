@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This defines the PoseGraph class, a keyframe-based loop closure backend
+// for UAVLocalization.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef POSE_GRAPH_H
+#define POSE_GRAPH_H
+
+#include <ros/ros.h>
+#include <utils/math/transform_3d.h>
+
+#include <pcl/point_types.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/registration/gicp.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+
+typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
+using namespace math;
+
+class PoseGraph {
+ public:
+  PoseGraph();
+  ~PoseGraph();
+
+  bool Initialize(const ros::NodeHandle& n);
+
+  // Consider the current pose/scan as a keyframe, search for a loop
+  // closure, and incrementally correct the graph. Returns true when a
+  // loop closed, with the correction to apply to the latest pose.
+  bool Update(const Transform3D& pose, const PointCloud::ConstPtr& scan,
+              Transform3D& correction);
+
+ private:
+  // A pose-graph node: the pose estimate at keyframe time and a
+  // downsampled world-frame scan for re-alignment.
+  struct Keyframe {
+    Transform3D pose;
+    PointCloud::Ptr cloud;
+  };
+
+  bool LoadParameters(const ros::NodeHandle& n);
+
+  // Find a revisited keyframe near position, excluding recent frames.
+  int FindCandidate(const Eigen::Vector3d& position);
+
+  // Estimate the world-frame correction that maps the latest keyframe
+  // cloud onto the candidate's structure.
+  bool AlignKeyframes(const Keyframe& candidate, const Keyframe& latest,
+                      Transform3D& correction);
+
+  // Scale a rigid correction by w in [0, 1] (slerp + scaled translation).
+  Transform3D InterpolateCorrection(const Transform3D& correction, double w);
+
+  // Member variables.
+  std::vector<Keyframe> keyframes_;
+
+  double keyframe_distance_, candidate_radius_, max_fitness_;
+  double corr_dist_, tf_epsilon_;
+  int min_keyframe_separation_, max_iters_;
+  bool initialized_;
+  std::string name_;
+};
+
+#endif
@@ -46,7 +46,11 @@
 #include <ros/ros.h>
 #include <message_synchronizer/message_synchronizer.h>
 #include <utils/math/transform_3d.h>
+#include <utils/types/cloud_pool.h>
+#include <utils/timing/stage_timer.h>
 #include <uav_odometry/uav_odometry.h>
+#include <uav_odometry/icp_pyramid.h>
+#include <uav_localization/pose_graph.h>
 #include <uav_mapper/uav_mapper.h>
 
 #include <sensor_msgs/PointCloud2.h>
@@ -82,15 +86,27 @@ class UAVLocalization {
   void RefineTransformation(const PointCloud::Ptr& target,
                             const PointCloud::Ptr& source);
 
+  // Point-to-plane refinement against the mapper's cached voxel normals,
+  // used instead of GICP when index-aligned correspondences exist.
+  void RefinePointToPlane(const PointCloud::Ptr& target,
+                          const PointCloud::Ptr& source);
+
   // Member variables.
   UAVMapper *mapper_;
   UAVOdometry *odometry_;
   Transform3D refined_transform_;
   Transform3D odometry_transform_;
 
+  // Coarse-to-fine prealignment engine.
+  ICPPyramid pyramid_;
+
+  // Loop closure backend.
+  PoseGraph pose_graph_;
+
   double ransac_thresh_, tf_epsilon_, corr_dist_;
   int max_iters_;
-  bool initialized_, rough_alignment_;
+  bool initialized_, rough_alignment_, pyramid_mode_, point_to_plane_,
+    loop_closure_;
   std::string name_;
 };
 
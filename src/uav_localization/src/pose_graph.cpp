@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defining the PoseGraph class.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <uav_localization/pose_graph.h>
+
+// Constructor/destructor.
+PoseGraph::PoseGraph() : initialized_(false) {}
+PoseGraph::~PoseGraph() {}
+
+// Initialize.
+bool PoseGraph::Initialize(const ros::NodeHandle& n) {
+  name_ = ros::names::append(n.getNamespace(), "pose_graph");
+
+  if (!LoadParameters(n)) {
+    ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
+    return false;
+  }
+
+  initialized_ = true;
+  return true;
+}
+
+// Load parameters.
+bool PoseGraph::LoadParameters(const ros::NodeHandle& n) {
+  if (!ros::param::get("/uav_slam/icp/corr_dist", corr_dist_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/tf_epsilon", tf_epsilon_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/max_iters", max_iters_))
+    return false;
+  if (!ros::param::get("/uav_slam/loop/keyframe_distance", keyframe_distance_))
+    return false;
+  if (!ros::param::get("/uav_slam/loop/candidate_radius", candidate_radius_))
+    return false;
+  if (!ros::param::get("/uav_slam/loop/min_keyframe_separation",
+                       min_keyframe_separation_))
+    return false;
+  if (!ros::param::get("/uav_slam/loop/max_fitness", max_fitness_))
+    return false;
+
+  return true;
+}
+
+// Consider the current pose/scan as a keyframe and search for a loop.
+bool PoseGraph::Update(const Transform3D& pose,
+                       const PointCloud::ConstPtr& scan,
+                       Transform3D& correction) {
+  if (!initialized_) {
+    ROS_ERROR("%s: Tried to update before initializing.", name_.c_str());
+    return false;
+  }
+
+  // Only spend a node once we have travelled a keyframe's worth.
+  const Eigen::Vector3d position = pose.GetTranslation();
+  if (!keyframes_.empty()) {
+    Transform3D last_pose = keyframes_.back().pose;
+    if ((position - last_pose.GetTranslation()).norm() < keyframe_distance_)
+      return false;
+  }
+
+  Keyframe keyframe;
+  keyframe.pose = pose;
+  keyframe.cloud.reset(new PointCloud(*scan));
+  keyframes_.push_back(keyframe);
+
+  // Place recognition: a previously-visited keyframe near this position.
+  const int candidate = FindCandidate(position);
+  if (candidate < 0)
+    return false;
+
+  // Verify geometrically and measure the accumulated drift.
+  if (!AlignKeyframes(keyframes_[candidate], keyframes_.back(), correction))
+    return false;
+
+  // Distribute the correction incrementally along the chain between the
+  // two loop endpoints, ramping from zero at the revisited keyframe to
+  // the full correction at the latest one. Only this chain is touched,
+  // so closing a loop costs O(loop length), never a batch solve.
+  const size_t last = keyframes_.size() - 1;
+  for (size_t ii = candidate + 1; ii <= last; ii++) {
+    const double weight =
+      static_cast<double>(ii - candidate) / static_cast<double>(last - candidate);
+    Transform3D partial = InterpolateCorrection(correction, weight);
+    keyframes_[ii].pose = partial * keyframes_[ii].pose;
+    pcl::transformPointCloud(*keyframes_[ii].cloud, *keyframes_[ii].cloud,
+                             partial.GetTransform());
+  }
+
+  ROS_INFO("%s: Closed a loop between keyframes %d and %lu.", name_.c_str(),
+           candidate, last);
+  return true;
+}
+
+// Find a revisited keyframe near position. Recent keyframes are excluded
+// so the loop actually spans drift worth correcting.
+int PoseGraph::FindCandidate(const Eigen::Vector3d& position) {
+  if (keyframes_.size() <= static_cast<size_t>(min_keyframe_separation_))
+    return -1;
+
+  int best = -1;
+  double best_distance = candidate_radius_;
+  const size_t newest = keyframes_.size() - 1 - min_keyframe_separation_;
+  for (size_t ii = 0; ii < newest; ii++) {
+    const double distance =
+      (keyframes_[ii].pose.GetTranslation() - position).norm();
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = static_cast<int>(ii);
+    }
+  }
+
+  return best;
+}
+
+// Estimate the world-frame correction mapping the latest keyframe cloud
+// onto the candidate's structure. Both clouds already live in the world
+// frame, so the residual ICP transform is the accumulated drift.
+bool PoseGraph::AlignKeyframes(const Keyframe& candidate,
+                               const Keyframe& latest,
+                               Transform3D& correction) {
+  pcl::GeneralizedIterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
+  icp.setInputSource(latest.cloud);
+  icp.setInputTarget(candidate.cloud);
+  icp.setMaxCorrespondenceDistance(candidate_radius_);
+  icp.setMaximumIterations(max_iters_);
+  icp.setTransformationEpsilon(tf_epsilon_);
+
+  PointCloud aligned;
+  icp.align(aligned);
+
+  if (!icp.hasConverged() || icp.getFitnessScore() > max_fitness_)
+    return false;
+
+  correction = Transform3D(icp.getFinalTransformation().cast<double>());
+
+  // Reject corrections larger than the search radius: more likely a bad
+  // match than real drift.
+  if (correction.GetTranslation().norm() > candidate_radius_)
+    return false;
+
+  return true;
+}
+
+// Scale a rigid correction by w in [0, 1].
+Transform3D PoseGraph::InterpolateCorrection(const Transform3D& correction,
+                                             double w) {
+  Eigen::Quaterniond rotation(correction.GetRotation());
+  Eigen::Quaterniond partial =
+    Eigen::Quaterniond::Identity().slerp(w, rotation);
+
+  return Transform3D(partial.toRotationMatrix(),
+                     w * correction.GetTranslation());
+}
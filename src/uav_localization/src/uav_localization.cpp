@@ -63,6 +63,16 @@ bool UAVLocalization::Initialize(const ros::NodeHandle& n,
     return false;
   }
 
+  if (pyramid_mode_ && !pyramid_.Initialize(n)) {
+    ROS_ERROR("%s: Failed to initialize ICPPyramid.", name_.c_str());
+    return false;
+  }
+
+  if (loop_closure_ && !pose_graph_.Initialize(n)) {
+    ROS_ERROR("%s: Failed to initialize PoseGraph.", name_.c_str());
+    return false;
+  }
+
   initialized_ = true;
   return true;
 }
@@ -80,6 +90,13 @@ bool UAVLocalization::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!ros::param::get("/uav_slam/localization/rough_alignment", rough_alignment_))
     return false;
+  if (!ros::param::get("/uav_slam/icp/pyramid_mode", pyramid_mode_))
+    return false;
+  if (!ros::param::get("/uav_slam/localization/point_to_plane",
+                       point_to_plane_))
+    return false;
+  if (!ros::param::get("/uav_slam/localization/loop_closure", loop_closure_))
+    return false;
 
   return true;
 }
@@ -115,9 +132,10 @@ void UAVLocalization::Localize(const PointCloud::ConstPtr& scan) {
     return;
   }
 
-  // Do rough alignment using odometry (if flag is set).
-  PointCloud::Ptr neighbors(new PointCloud);
-  PointCloud::Ptr transformed(new PointCloud);
+  // Do rough alignment using odometry (if flag is set). The per-scan
+  // temporaries come from the cloud pool and are recycled on release.
+  PointCloud::Ptr neighbors = CloudPool::Instance().Acquire();
+  PointCloud::Ptr transformed = CloudPool::Instance().Acquire();
   if (rough_alignment_) {
     // Calculate odometry.
     odometry_->ResetIntegratedTransform();
@@ -129,9 +147,13 @@ void UAVLocalization::Localize(const PointCloud::ConstPtr& scan) {
     refined_transform_ *= incremental_transform;
   }
 
-  // Transform cloud into world frame.
-  Eigen::Matrix4d initial_tf = refined_transform_.GetTransform();
-  pcl::transformPointCloud(*scan, *transformed, initial_tf);
+  // Transform cloud into world frame: copy, then run the batched point
+  // kernel over PCL's padded float layout.
+  Transform3D initial_transform = refined_transform_;
+  *transformed = *scan;
+  if (!transformed->points.empty())
+    refined_transform_.TransformPoints(&transformed->points[0].x,
+                                       transformed->points.size(), 4);
 
   // Do fine alignment.
   if (mapper_->Size() > 0) {
@@ -145,21 +167,47 @@ void UAVLocalization::Localize(const PointCloud::ConstPtr& scan) {
     RefineTransformation(neighbors, transformed);
   }
 
-  // Add to the map.
-  Eigen::Matrix4d refined_tf = refined_transform_.GetTransform();
-  pcl::transformPointCloud(*scan, *transformed, refined_tf);
+  // Apply just the refinement delta to the already-transformed cloud
+  // rather than re-transforming the raw scan, and skip the pass entirely
+  // when the refinement was negligible.
+  Transform3D delta = refined_transform_ * initial_transform.Inverse();
+  if (delta != Transform3D() && !transformed->points.empty())
+    delta.TransformPoints(&transformed->points[0].x,
+                          transformed->points.size(), 4);
+
+  // Add to the map, then let the mapper evict structure far from the
+  // current pose.
   mapper_->InsertPoints(*transformed);
+  mapper_->UpdateWindow(refined_transform_);
+
+  // Feed the loop closure backend. A closed loop hands back a world-frame
+  // correction for the current pose.
+  if (loop_closure_) {
+    Transform3D correction;
+    if (pose_graph_.Update(refined_transform_, transformed, correction))
+      refined_transform_ = correction * refined_transform_;
+  }
 }
 
 // Refine initial guess.
 void UAVLocalization::RefineTransformation(const PointCloud::Ptr& target,
                                            const PointCloud::Ptr& source) {
+  timing::ScopedTimer timer("uav_localization/refine_transformation");
+
   if (!initialized_) {
     ROS_ERROR("%s: Tried to refine transform before initializing.",
               name_.c_str());
     return;
   }
 
+  // The neighbor cloud pairs up with the source cloud index for index
+  // when no scan points were skipped, which lets the point-to-plane
+  // solver consume the mapper's cached voxel normals instead of
+  // re-estimating surface statistics per frame.
+  if (point_to_plane_ && target->points.size() == source->points.size()) {
+    RefinePointToPlane(target, source);
+    return;
+  }
 
   // Setup.
   pcl::GeneralizedIterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
@@ -170,10 +218,83 @@ void UAVLocalization::RefineTransformation(const PointCloud::Ptr& target,
   icp.setTransformationEpsilon(tf_epsilon_);
   icp.setRANSACOutlierRejectionThreshold(ransac_thresh_);
 
+  // Coarse-to-fine prealignment seeds the full-resolution solve.
+  Eigen::Matrix4f guess = Eigen::Matrix4f::Identity();
+  if (pyramid_mode_)
+    guess = pyramid_.CoarseAlign(source, target);
+
   // Align.
   PointCloud aligned_scan;
-  icp.align(aligned_scan);
+  icp.align(aligned_scan, guess);
 
   Transform3D refinement(icp.getFinalTransformation().cast<double>());
   refined_transform_ = refinement * refined_transform_;
 }
+
+// Gauss-Newton point-to-plane refinement. Each source point pairs with
+// its map nearest neighbor at the same index, and the plane normal comes
+// from the mapper's incrementally-maintained voxel statistics.
+void UAVLocalization::RefinePointToPlane(const PointCloud::Ptr& target,
+                                         const PointCloud::Ptr& source) {
+  Eigen::Matrix4d refinement = Eigen::Matrix4d::Identity();
+  const double corr_dist_sq = corr_dist_ * corr_dist_;
+
+  for (int iter = 0; iter < max_iters_; iter++) {
+    Eigen::Matrix<double, 6, 6> AtA = Eigen::Matrix<double, 6, 6>::Zero();
+    Eigen::Matrix<double, 6, 1> Atb = Eigen::Matrix<double, 6, 1>::Zero();
+    size_t used = 0;
+
+    for (size_t ii = 0; ii < source->points.size(); ii++) {
+      Eigen::Vector3d p(source->points[ii].x, source->points[ii].y,
+                        source->points[ii].z);
+      p = refinement.block(0, 0, 3, 3) * p + refinement.block(0, 3, 3, 1);
+
+      const Eigen::Vector3d q(target->points[ii].x, target->points[ii].y,
+                              target->points[ii].z);
+      if ((p - q).squaredNorm() > corr_dist_sq)
+        continue;
+
+      Eigen::Vector3d normal;
+      if (!mapper_->VoxelNormal(target->points[ii], normal))
+        continue;
+
+      // Linearized point-to-plane residual.
+      const double residual = normal.dot(p - q);
+      Eigen::Matrix<double, 6, 1> jacobian;
+      jacobian.head(3) = p.cross(normal);
+      jacobian.tail(3) = normal;
+
+      AtA += jacobian * jacobian.transpose();
+      Atb += jacobian * residual;
+      used++;
+    }
+
+    // Not enough planar correspondences to constrain all six degrees.
+    if (used < 10)
+      break;
+
+    // Light damping keeps the solve bounded when the visible geometry is
+    // degenerate (e.g. a single plane leaves three directions free).
+    AtA += 1e-6 * static_cast<double>(used) *
+      Eigen::Matrix<double, 6, 6>::Identity();
+
+    const Eigen::Matrix<double, 6, 1> delta = AtA.ldlt().solve(-Atb);
+
+    // Apply the small-angle update.
+    Eigen::Matrix3d rotation;
+    rotation = Eigen::AngleAxisd(delta(2), Eigen::Vector3d::UnitZ()) *
+               Eigen::AngleAxisd(delta(1), Eigen::Vector3d::UnitY()) *
+               Eigen::AngleAxisd(delta(0), Eigen::Vector3d::UnitX());
+
+    Eigen::Matrix4d update = Eigen::Matrix4d::Identity();
+    update.block(0, 0, 3, 3) = rotation;
+    update.block(0, 3, 3, 1) = delta.tail(3);
+    refinement = update * refinement;
+
+    if (delta.norm() < tf_epsilon_)
+      break;
+  }
+
+  Transform3D refinement_tf(refinement);
+  refined_transform_ = refinement_tf * refined_transform_;
+}
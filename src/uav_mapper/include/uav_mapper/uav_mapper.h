@@ -45,6 +45,8 @@
 
 #include <ros/ros.h>
 #include <uav_odometry/uav_odometry.h>
+#include <utils/math/transform_3d.h>
+#include <utils/timing/stage_timer.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <pcl/point_types.h>
 #include <pcl/octree/octree_search.h>
@@ -52,6 +54,9 @@
 #include <Eigen/Dense>
 #include <cmath>
 #include <vector>
+#include <unordered_set>
+#include <unordered_map>
+#include <thread>
 
 typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
 typedef pcl::octree::OctreePointCloudSearch<pcl::PointXYZ> Octree;
@@ -71,18 +76,65 @@ class UAVMapper {
   // Add points to map.
   void InsertPoints(const PointCloud& cloud);
 
+  // Evict map structure far from the current pose, keeping queries
+  // against a compact local submap.
+  void UpdateWindow(const math::Transform3D& pose);
+
+  // Persist and restore the map as a packed binary snapshot, so a
+  // restarted node recovers its map without re-inserting points one by
+  // one.
+  bool SaveMap(const std::string& filename);
+  bool LoadMap(const std::string& filename);
+
+  // Look up the cached surface normal of the voxel containing point.
+  // Returns false when the voxel has too few samples to be planar.
+  bool VoxelNormal(const pcl::PointXYZ& point, Eigen::Vector3d& normal);
+
   // Size.
   size_t Size();
 
  private:
+  // Incrementally-updated surface statistics for one voxel. The normal is
+  // recomputed lazily from the accumulated first and second moments.
+  struct VoxelStats {
+    VoxelStats()
+      : count(0), sum(Eigen::Vector3d::Zero()),
+        sum_outer(Eigen::Matrix3d::Zero()),
+        normal(Eigen::Vector3d::Zero()), normal_dirty(true) {}
+
+    int count;
+    Eigen::Vector3d sum;
+    Eigen::Matrix3d sum_outer;
+    Eigen::Vector3d normal;
+    bool normal_dirty;
+  };
+
   bool LoadParameters(const ros::NodeHandle& n);
   bool RegisterCallbacks(const ros::NodeHandle& n);
 
+  // Query a contiguous range of valid_indices_ against the octree.
+  void QueryRange(const PointCloud::Ptr& cloud, size_t begin, size_t end);
+
   // Member variables.
   PointCloud::Ptr map_cloud_;
   Octree::Ptr map_octree_;
 
-  double octree_resolution_;
+  // Scratch buffers for bulk insertion, reused across scans.
+  std::unordered_set<long long> scan_voxels_;
+  std::vector<pcl::PointXYZ> candidates_;
+
+  // Scratch buffers for batched nearest-neighbor queries.
+  std::vector<int> valid_indices_;
+  std::vector<int> nn_indices_;
+
+  // Per-voxel surface statistics, updated as points are inserted.
+  std::unordered_map<long long, VoxelStats> voxel_stats_;
+
+  // Center of the last sliding-window rebuild.
+  Eigen::Vector3d window_center_;
+
+  double octree_resolution_, window_radius_;
+  int query_threads_;
   bool initialized_;
   std::string name_;
 };
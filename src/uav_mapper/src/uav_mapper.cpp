@@ -43,9 +43,16 @@
 #include <uav_mapper/uav_mapper.h>
 #include <message_synchronizer/message_synchronizer.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <fstream>
+
 // Constructor/destructor.
 UAVMapper::UAVMapper() : initialized_(false) {
   map_cloud_.reset(new PointCloud);
+  window_center_ = Eigen::Vector3d::Zero();
 }
 
 UAVMapper::~UAVMapper() {}
@@ -76,6 +83,10 @@ bool UAVMapper::Initialize(const ros::NodeHandle& n) {
 bool UAVMapper::LoadParameters(const ros::NodeHandle& n) {
   if (!ros::param::get("/uav_slam/octree/octree_res", octree_resolution_))
     return false;
+  if (!ros::param::get("/uav_slam/octree/window_radius", window_radius_))
+    return false;
+  if (!ros::param::get("/uav_slam/octree/query_threads", query_threads_))
+    return false;
 
   return true;
 }
@@ -85,33 +96,81 @@ bool UAVMapper::RegisterCallbacks(const ros::NodeHandle& n) {
   return true;
 }
 
-// Find nearest neighbors.
+// Find nearest neighbors. The octree is read-only during localization, so
+// the scan is partitioned across worker threads, each querying a
+// contiguous range of pre-compacted valid indices.
 bool UAVMapper::NearestNeighbors(const PointCloud::Ptr cloud,
                                  PointCloud::Ptr neighbors) {
+  timing::ScopedTimer timer("uav_mapper/nearest_neighbors");
+
   neighbors->points.clear();
 
-  // For each point in input cloud, append nearest neighbor to neighbors.
+  // Compact away invalid points up front so the query loop is branch-free.
+  valid_indices_.clear();
+  valid_indices_.reserve(cloud->points.size());
   for (size_t ii = 0; ii < cloud->points.size(); ii++) {
-    float nn_distance = -1.0;
-    int nn_index = -1;
-
-    // Check valid point.
     if (std::isnan(cloud->points[ii].x) ||
         std::isnan(cloud->points[ii].y) ||
-        std::isnan(cloud->points[ii].z)) {
-      ROS_WARN("%s: Skipping nan point.", name_.c_str());
+        std::isnan(cloud->points[ii].z))
       continue;
-    }
 
-    map_octree_->approxNearestSearch(cloud->points[ii], nn_index, nn_distance);
-    if (nn_index >= 0) {
-      neighbors->push_back(map_cloud_->points[nn_index]);
+    valid_indices_.push_back(static_cast<int>(ii));
+  }
+
+  const size_t count = valid_indices_.size();
+  if (count < cloud->points.size())
+    ROS_WARN("%s: Skipping %lu nan points.", name_.c_str(),
+             cloud->points.size() - count);
+  if (count == 0)
+    return false;
+
+  nn_indices_.assign(count, -1);
+
+  if (query_threads_ > 1) {
+    // Partition the queries into contiguous ranges, one per worker.
+    std::vector<std::thread> workers;
+    const size_t stride = (count + query_threads_ - 1) / query_threads_;
+    for (int tt = 0; tt < query_threads_; tt++) {
+      const size_t begin = tt * stride;
+      if (begin >= count)
+        break;
+
+      workers.push_back(std::thread(&UAVMapper::QueryRange, this, cloud,
+                                    begin, std::min(begin + stride, count)));
     }
+
+    for (size_t tt = 0; tt < workers.size(); tt++)
+      workers[tt].join();
+  } else {
+    QueryRange(cloud, 0, count);
   }
 
+  // Gather hits in scan order, reserving the output once.
+  neighbors->points.reserve(count);
+  for (size_t jj = 0; jj < count; jj++) {
+    if (nn_indices_[jj] >= 0)
+      neighbors->points.push_back(map_cloud_->points[nn_indices_[jj]]);
+  }
+
+  neighbors->width = static_cast<uint32_t>(neighbors->points.size());
+  neighbors->height = 1;
+
   return neighbors->points.size() > 0;
 }
 
+// Query a contiguous range of valid_indices_ against the octree.
+void UAVMapper::QueryRange(const PointCloud::Ptr& cloud, size_t begin,
+                           size_t end) {
+  for (size_t jj = begin; jj < end; jj++) {
+    float nn_distance = -1.0;
+    int nn_index = -1;
+
+    map_octree_->approxNearestSearch(cloud->points[valid_indices_[jj]],
+                                     nn_index, nn_distance);
+    nn_indices_[jj] = nn_index;
+  }
+}
+
 // K-nearest neighbor search.
 bool UAVMapper::KNearestNeighbors(const pcl::PointXYZ& point, int k,
                                   std::vector<pcl::PointXYZ>& neighbors) {
@@ -140,19 +199,255 @@ bool UAVMapper::KNearestNeighbors(const pcl::PointXYZ& point, int k,
 }
 
 
-// Add points to map.
+// Hash a point's voxel coordinates into a single key.
+namespace {
+  long long VoxelKey(const pcl::PointXYZ& point, double inv_res) {
+    const long long xi = static_cast<long long>(std::floor(point.x * inv_res));
+    const long long yi = static_cast<long long>(std::floor(point.y * inv_res));
+    const long long zi = static_cast<long long>(std::floor(point.z * inv_res));
+    return (xi * 73856093) ^ (yi * 19349663) ^ (zi * 83492791);
+  }
+} //\ namespace
+
+// Add points to map in bulk. Deduplicate the scan by voxel key first so
+// the octree is descended once per candidate voxel rather than twice per
+// raw point, and reserve map growth up front. The hash voxels are aligned
+// to the world origin rather than the octree's bounding box, so the
+// deduplication is slightly conservative but never adds extra points.
 void UAVMapper::InsertPoints(const PointCloud& cloud) {
+  const double inv_res = 1.0 / octree_resolution_;
+
+  // Pick one representative point per voxel from this scan, accumulating
+  // per-voxel surface statistics from every valid point along the way.
+  scan_voxels_.clear();
+  candidates_.clear();
   for (size_t ii = 0; ii < cloud.points.size(); ii++) {
-    const pcl::PointXYZ point = cloud.points[ii];
+    const pcl::PointXYZ& point = cloud.points[ii];
+    if (std::isnan(point.x) || std::isnan(point.y) || std::isnan(point.z))
+      continue;
+
+    const long long key = VoxelKey(point, inv_res);
 
-    // Add all points to map_cloud_, but only add to octree if voxel is empty.
+    const Eigen::Vector3d position(point.x, point.y, point.z);
+    VoxelStats& stats = voxel_stats_[key];
+    stats.count++;
+    stats.sum += position;
+    stats.sum_outer += position * position.transpose();
+    stats.normal_dirty = true;
+
+    if (scan_voxels_.insert(key).second)
+      candidates_.push_back(point);
+  }
+
+  // One octree descent per candidate voxel.
+  map_cloud_->points.reserve(map_cloud_->points.size() + candidates_.size());
+  for (size_t ii = 0; ii < candidates_.size(); ii++) {
+    const pcl::PointXYZ& point = candidates_[ii];
+
+    // Add to map_cloud_, but only if the voxel is still empty.
     if (!map_octree_->isVoxelOccupiedAtPoint(point))
       map_octree_->addPointToCloud(point, map_cloud_);
-#if 0
+  }
+}
+
+// Evict map structure far from the current pose. Rebuilds at most once
+// per quarter window radius of travel, so the O(map) pass is amortized
+// over many scans.
+void UAVMapper::UpdateWindow(const math::Transform3D& pose) {
+  if (window_radius_ <= 0.0)
+    return;
+
+  const Eigen::Vector3d position = pose.GetTranslation();
+  if ((position - window_center_).norm() < 0.25 * window_radius_)
+    return;
+  window_center_ = position;
+
+  // Keep only points within the window of the current pose.
+  PointCloud::Ptr windowed_cloud(new PointCloud);
+  windowed_cloud->points.reserve(map_cloud_->points.size());
+
+  const double radius_sq = window_radius_ * window_radius_;
+  for (size_t ii = 0; ii < map_cloud_->points.size(); ii++) {
+    const pcl::PointXYZ& point = map_cloud_->points[ii];
+    const double dx = point.x - position(0);
+    const double dy = point.y - position(1);
+    const double dz = point.z - position(2);
+
+    if (dx * dx + dy * dy + dz * dz <= radius_sq)
+      windowed_cloud->points.push_back(point);
+  }
+
+  windowed_cloud->width = static_cast<uint32_t>(windowed_cloud->points.size());
+  windowed_cloud->height = 1;
+
+  // Nothing evicted: keep the existing octree.
+  if (windowed_cloud->points.size() == map_cloud_->points.size())
+    return;
+
+  // Rebuild the octree over the compact submap.
+  map_cloud_ = windowed_cloud;
+  map_octree_.reset(new Octree(octree_resolution_));
+  map_octree_->setInputCloud(map_cloud_);
+  map_octree_->addPointsFromInputCloud();
+
+  // Evict surface statistics along with the voxels they describe.
+  std::unordered_map<long long, VoxelStats>::iterator it =
+    voxel_stats_.begin();
+  while (it != voxel_stats_.end()) {
+    const Eigen::Vector3d centroid = it->second.sum / it->second.count;
+    if ((centroid - position).squaredNorm() > radius_sq)
+      it = voxel_stats_.erase(it);
     else
-      map_cloud_->push_back(point);
-#endif
+      ++it;
+  }
+}
+
+// Look up the cached surface normal of the voxel containing point. The
+// normal is the smallest eigenvector of the voxel's scatter matrix, and
+// is recomputed only when new points have landed in the voxel.
+bool UAVMapper::VoxelNormal(const pcl::PointXYZ& point,
+                            Eigen::Vector3d& normal) {
+  const long long key = VoxelKey(point, 1.0 / octree_resolution_);
+
+  std::unordered_map<long long, VoxelStats>::iterator entry =
+    voxel_stats_.find(key);
+  if (entry == voxel_stats_.end() || entry->second.count < 6)
+    return false;
+
+  VoxelStats& stats = entry->second;
+  if (stats.normal_dirty) {
+    const Eigen::Vector3d mean = stats.sum / stats.count;
+    const Eigen::Matrix3d covariance =
+      stats.sum_outer / stats.count - mean * mean.transpose();
+
+    Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+    stats.normal = solver.eigenvectors().col(0);
+    stats.normal_dirty = false;
   }
+
+  normal = stats.normal;
+  return true;
+}
+
+// On-disk snapshot layout: a fixed header followed by tightly packed
+// x/y/z float triples, so a reader can mmap the file and stream points
+// straight into the cloud.
+namespace {
+  struct MapSnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    double resolution;
+    uint64_t num_points;
+  };
+
+  const uint32_t kSnapshotMagic = 0x50414d55;  // "UMAP"
+  const uint32_t kSnapshotVersion = 1;
+} //\ namespace
+
+// Save the map to a binary snapshot.
+bool UAVMapper::SaveMap(const std::string& filename) {
+  std::ofstream file(filename.c_str(), std::ios::binary);
+  if (!file) {
+    ROS_ERROR("%s: Could not open %s for writing.", name_.c_str(),
+              filename.c_str());
+    return false;
+  }
+
+  MapSnapshotHeader header;
+  header.magic = kSnapshotMagic;
+  header.version = kSnapshotVersion;
+  header.resolution = octree_resolution_;
+  header.num_points = map_cloud_->points.size();
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  // Pack the points contiguously and write them in one shot.
+  std::vector<float> packed;
+  packed.reserve(3 * map_cloud_->points.size());
+  for (size_t ii = 0; ii < map_cloud_->points.size(); ii++) {
+    packed.push_back(map_cloud_->points[ii].x);
+    packed.push_back(map_cloud_->points[ii].y);
+    packed.push_back(map_cloud_->points[ii].z);
+  }
+  file.write(reinterpret_cast<const char*>(packed.data()),
+             packed.size() * sizeof(float));
+
+  return file.good();
+}
+
+// Restore the map from a binary snapshot. The file is mapped read-only
+// and the octree is rebuilt in one bulk pass rather than point by point.
+bool UAVMapper::LoadMap(const std::string& filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ROS_ERROR("%s: Could not open %s for reading.", name_.c_str(),
+              filename.c_str());
+    return false;
+  }
+
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0 ||
+      static_cast<size_t>(file_stat.st_size) < sizeof(MapSnapshotHeader)) {
+    ROS_ERROR("%s: Snapshot %s is truncated.", name_.c_str(),
+              filename.c_str());
+    close(fd);
+    return false;
+  }
+
+  void* mapped =
+    mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    ROS_ERROR("%s: Could not mmap %s.", name_.c_str(), filename.c_str());
+    close(fd);
+    return false;
+  }
+
+  const MapSnapshotHeader* header =
+    static_cast<const MapSnapshotHeader*>(mapped);
+
+  // Compare against the payload actually present, rather than multiplying
+  // num_points out, so a corrupt count cannot overflow the check.
+  const uint64_t payload_points =
+    (file_stat.st_size - sizeof(MapSnapshotHeader)) / (3 * sizeof(float));
+  if (header->magic != kSnapshotMagic ||
+      header->version != kSnapshotVersion ||
+      header->num_points > payload_points) {
+    ROS_ERROR("%s: Snapshot %s is corrupt or has the wrong version.",
+              name_.c_str(), filename.c_str());
+    munmap(mapped, file_stat.st_size);
+    close(fd);
+    return false;
+  }
+
+  if (header->resolution != octree_resolution_)
+    ROS_WARN("%s: Snapshot resolution %f differs from configured %f.",
+             name_.c_str(), header->resolution, octree_resolution_);
+
+  // Stream the packed points straight into a fresh cloud.
+  const float* data = reinterpret_cast<const float*>(
+    static_cast<const char*>(mapped) + sizeof(MapSnapshotHeader));
+
+  PointCloud::Ptr loaded_cloud(new PointCloud);
+  loaded_cloud->points.resize(header->num_points);
+  for (size_t ii = 0; ii < header->num_points; ii++) {
+    loaded_cloud->points[ii].x = data[3 * ii];
+    loaded_cloud->points[ii].y = data[3 * ii + 1];
+    loaded_cloud->points[ii].z = data[3 * ii + 2];
+  }
+  loaded_cloud->width = static_cast<uint32_t>(header->num_points);
+  loaded_cloud->height = 1;
+
+  munmap(mapped, file_stat.st_size);
+  close(fd);
+
+  // Rebuild the octree over the restored cloud in one bulk pass.
+  map_cloud_ = loaded_cloud;
+  map_octree_.reset(new Octree(octree_resolution_));
+  map_octree_->setInputCloud(map_cloud_);
+  map_octree_->addPointsFromInputCloud();
+
+  ROS_INFO("%s: Restored %lu map points from %s.", name_.c_str(),
+           map_cloud_->points.size(), filename.c_str());
+  return true;
 }
 
 // Size.
@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This defines the ICPPyramid class, a coarse-to-fine prealignment engine
+// shared by UAVOdometry and UAVLocalization.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef ICP_PYRAMID_H
+#define ICP_PYRAMID_H
+
+#include <ros/ros.h>
+#include <pcl/point_types.h>
+#include <pcl_ros/point_cloud.h>
+#include <pcl/filters/voxel_grid.h>
+#include <pcl/registration/gicp.h>
+#include <Eigen/Dense>
+#include <vector>
+#include <string>
+
+typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
+
+class ICPPyramid {
+ public:
+  ICPPyramid();
+  ~ICPPyramid();
+
+  bool Initialize(const ros::NodeHandle& n);
+
+  // Align progressively finer voxelizations of source against target and
+  // return the stacked transform, starting from seed. The caller feeds
+  // this to its own full-resolution solver as an initial guess, so the
+  // fine level only needs a few cleanup iterations.
+  Eigen::Matrix4f CoarseAlign(
+    const PointCloud::ConstPtr& source, const PointCloud::ConstPtr& target,
+    const Eigen::Matrix4f& seed = Eigen::Matrix4f::Identity());
+
+ private:
+  bool LoadParameters(const ros::NodeHandle& n);
+
+  // Per-level voxel leaf sizes (coarse to fine) and iteration caps. The
+  // incoming clouds are already voxelized by PointCloudFilter, so these
+  // leaves should all be coarser than the filter's leaf size.
+  std::vector<double> leaf_sizes_;
+  std::vector<int> level_iters_;
+
+  double tf_epsilon_, corr_dist_;
+  bool initialized_;
+  std::string name_;
+};
+
+#endif
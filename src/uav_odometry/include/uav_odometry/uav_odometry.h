@@ -45,9 +45,12 @@
 
 #include <ros/ros.h>
 #include <message_synchronizer/message_synchronizer.h>
+#include <uav_odometry/icp_pyramid.h>
 #include <utils/math/transform_3d.h>
+#include <utils/timing/stage_timer.h>
 
 #include <sensor_msgs/PointCloud2.h>
+#include <geometry_msgs/TransformStamped.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <pcl/point_types.h>
 #include <pcl_ros/point_cloud.h>
@@ -55,6 +58,7 @@
 #include <Eigen/Dense>
 #include <Eigen/Geometry>
 #include <cmath>
+#include <mutex>
 
 typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
 using namespace math;
@@ -77,7 +81,7 @@ class UAVOdometry {
   void ResetIntegratedTransform();
 
   // Get previous cloud.
-  PointCloud::Ptr GetPreviousCloud();
+  PointCloud::ConstPtr GetPreviousCloud();
   PointCloud::Ptr GetAlignedCloud();
 
  private:
@@ -87,15 +91,46 @@ class UAVOdometry {
   // Run ICP.
   void RunICP(const PointCloud::ConstPtr& cloud);
 
+  // Decide whether motion relative to the keyframe warrants re-pinning.
+  bool IsKeyframeStale(const Transform3D& delta);
+
+  // Track the latest IMU orientation for seeding ICP.
+  void ImuCallback(const geometry_msgs::TransformStamped::ConstPtr& msg);
+
   // Member variables.
   Transform3D integrated_transform_;
-  PointCloud::Ptr previous_cloud_;
+
+  // Alignment of the last scan against the pinned keyframe cloud.
+  Transform3D keyframe_delta_;
+
+  // Retained by shared pointer: incoming clouds are immutable by
+  // contract, so pinning the reference frame is O(1) instead of a deep
+  // copy, and the previous reference simply drops its last reference.
+  PointCloud::ConstPtr previous_cloud_;
   PointCloud::Ptr aligned_cloud_;
 
+  // Persistent ICP engine. Keeping this alive across frames caches the
+  // target kd-tree and per-point covariances of previous_cloud_, so each
+  // new scan only pays for its own source-side setup.
+  pcl::GeneralizedIterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp_;
+
+  // Coarse-to-fine prealignment engine.
+  ICPPyramid pyramid_;
+
+  // IMU rotation prior. The callback thread writes the latest orientation
+  // and RunICP snapshots the orientation of each pinned reference cloud.
+  ros::Subscriber imu_subscriber_;
+  std::mutex imu_mutex_;
+  Eigen::Quaterniond latest_imu_q_;
+  Eigen::Quaterniond keyframe_imu_q_;
+  bool imu_received_;
+
   double voxel_leaf_size_, sor_zscore_, ransac_thresh_, tf_epsilon_, corr_dist_;
+  double keyframe_trans_thresh_, keyframe_rot_thresh_;
   int sor_knn_, max_iters_;
+  bool keyframe_mode_, pyramid_mode_, imu_seed_mode_;
   bool initialized_;
-  std::string name_;
+  std::string name_, imu_topic_;
 };
 
 #endif
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defining the ICPPyramid class.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <uav_odometry/icp_pyramid.h>
+
+// Constructor/destructor.
+ICPPyramid::ICPPyramid() : initialized_(false) {}
+ICPPyramid::~ICPPyramid() {}
+
+// Initialize.
+bool ICPPyramid::Initialize(const ros::NodeHandle& n) {
+  name_ = ros::names::append(n.getNamespace(), "icp_pyramid");
+
+  if (!LoadParameters(n)) {
+    ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
+    return false;
+  }
+
+  if (leaf_sizes_.size() != level_iters_.size()) {
+    ROS_ERROR("%s: Pyramid leaf sizes and iteration caps do not match.",
+              name_.c_str());
+    return false;
+  }
+
+  initialized_ = true;
+  return true;
+}
+
+// Load parameters.
+bool ICPPyramid::LoadParameters(const ros::NodeHandle& n) {
+  if (!ros::param::get("/uav_slam/icp/tf_epsilon", tf_epsilon_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/corr_dist", corr_dist_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/pyramid_leaf_sizes", leaf_sizes_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/pyramid_iters", level_iters_))
+    return false;
+
+  return true;
+}
+
+// Run coarse-to-fine prealignment.
+Eigen::Matrix4f ICPPyramid::CoarseAlign(const PointCloud::ConstPtr& source,
+                                        const PointCloud::ConstPtr& target,
+                                        const Eigen::Matrix4f& seed) {
+  Eigen::Matrix4f guess = seed;
+  if (!initialized_) {
+    ROS_ERROR("%s: Tried to align before initializing.", name_.c_str());
+    return guess;
+  }
+
+  pcl::VoxelGrid<pcl::PointXYZ> grid_filter;
+  pcl::GeneralizedIterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
+  icp.setTransformationEpsilon(tf_epsilon_);
+
+  for (size_t ii = 0; ii < leaf_sizes_.size(); ii++) {
+    const double leaf = leaf_sizes_[ii];
+
+    // Downsample both sides to this level's resolution.
+    PointCloud::Ptr coarse_source(new PointCloud);
+    PointCloud::Ptr coarse_target(new PointCloud);
+    grid_filter.setLeafSize(leaf, leaf, leaf);
+    grid_filter.setInputCloud(source);
+    grid_filter.filter(*coarse_source);
+    grid_filter.setInputCloud(target);
+    grid_filter.filter(*coarse_target);
+
+    // GICP needs enough points to estimate local covariances.
+    if (coarse_source->points.size() < 20 ||
+        coarse_target->points.size() < 20)
+      continue;
+
+    // Loosen the correspondence gate to match this level's resolution.
+    icp.setInputSource(coarse_source);
+    icp.setInputTarget(coarse_target);
+    icp.setMaximumIterations(level_iters_[ii]);
+    icp.setMaxCorrespondenceDistance(std::max(corr_dist_, leaf));
+
+    PointCloud aligned;
+    icp.align(aligned, guess);
+    if (icp.hasConverged())
+      guess = icp.getFinalTransformation();
+  }
+
+  return guess;
+}
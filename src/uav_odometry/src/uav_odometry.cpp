@@ -43,9 +43,10 @@
 #include <uav_odometry/uav_odometry.h>
 
 // Constructor/destructor.
-UAVOdometry::UAVOdometry() : initialized_(false) {
-  previous_cloud_.reset(new PointCloud);
+UAVOdometry::UAVOdometry() : initialized_(false), imu_received_(false) {
   aligned_cloud_.reset(new PointCloud);
+  latest_imu_q_ = Eigen::Quaterniond::Identity();
+  keyframe_imu_q_ = Eigen::Quaterniond::Identity();
 }
 
 UAVOdometry::~UAVOdometry() {}
@@ -64,6 +65,17 @@ bool UAVOdometry::Initialize(const ros::NodeHandle& n) {
     return false;
   }
 
+  if (pyramid_mode_ && !pyramid_.Initialize(n)) {
+    ROS_ERROR("%s: Failed to initialize ICPPyramid.", name_.c_str());
+    return false;
+  }
+
+  // Configure the persistent ICP engine once, up front.
+  icp_.setMaxCorrespondenceDistance(corr_dist_);
+  icp_.setMaximumIterations(max_iters_);
+  icp_.setTransformationEpsilon(tf_epsilon_);
+  icp_.setRANSACOutlierRejectionThreshold(ransac_thresh_);
+
   return true;
 }
 
@@ -77,22 +89,54 @@ bool UAVOdometry::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!ros::param::get("/uav_slam/icp/max_iters", max_iters_))
     return false;
+  if (!ros::param::get("/uav_slam/icp/keyframe_mode", keyframe_mode_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/keyframe_trans_thresh",
+                       keyframe_trans_thresh_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/keyframe_rot_thresh",
+                       keyframe_rot_thresh_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/pyramid_mode", pyramid_mode_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/imu_seed_mode", imu_seed_mode_))
+    return false;
+  if (!ros::param::get("/uav_slam/icp/imu_topic", imu_topic_))
+    return false;
 
   return true;
 }
 
 // Register callbacks.
 bool UAVOdometry::RegisterCallbacks(const ros::NodeHandle& n) {
+  if (!imu_seed_mode_)
+    return true;
+
+  ros::NodeHandle node(n);
+  imu_subscriber_ =
+    node.subscribe(imu_topic_.c_str(), 20, &UAVOdometry::ImuCallback, this);
+
   return true;
 }
 
+// Track the latest IMU orientation for seeding ICP.
+void UAVOdometry::ImuCallback(
+  const geometry_msgs::TransformStamped::ConstPtr& msg) {
+  std::lock_guard<std::mutex> lock(imu_mutex_);
+  latest_imu_q_ = Eigen::Quaterniond(msg->transform.rotation.w,
+                                     msg->transform.rotation.x,
+                                     msg->transform.rotation.y,
+                                     msg->transform.rotation.z);
+  imu_received_ = true;
+}
+
 // Get integrated transform.
 Transform3D& UAVOdometry::GetIntegratedTransform() {
   return integrated_transform_;
 }
 
 // Get previous cloud.
-PointCloud::Ptr UAVOdometry::GetPreviousCloud() {
+PointCloud::ConstPtr UAVOdometry::GetPreviousCloud() {
   return previous_cloud_;
 }
 
@@ -116,30 +160,75 @@ void UAVOdometry::UpdateOdometry(const PointCloud::ConstPtr& cloud) {
 
 // Calculate incremental transform. Assume incoming cloud is already filtered.
 void UAVOdometry::RunICP(const PointCloud::ConstPtr& cloud) {
-  // Handle base case.
+  timing::ScopedTimer timer("uav_odometry/run_icp");
+
+  // Handle base case. Retention is just holding the shared pointer.
   if (!initialized_) {
-    pcl::copyPointCloud(*cloud, *previous_cloud_);
+    previous_cloud_ = cloud;
+    icp_.setInputTarget(previous_cloud_);
+    {
+      std::lock_guard<std::mutex> lock(imu_mutex_);
+      keyframe_imu_q_ = latest_imu_q_;
+    }
     initialized_ = true;
   }
 
-  // Setup.
-  pcl::GeneralizedIterativeClosestPoint<pcl::PointXYZ, pcl::PointXYZ> icp;
-  icp.setInputSource(cloud);
-  icp.setInputTarget(previous_cloud_);
-  icp.setMaxCorrespondenceDistance(corr_dist_);
-  icp.setMaximumIterations(max_iters_);
-  icp.setTransformationEpsilon(tf_epsilon_);
-  icp.setRANSACOutlierRejectionThreshold(ransac_thresh_);
+  // Only the source side changes every frame. The target kd-tree and
+  // covariances for previous_cloud_ were cached when the target was set.
+  icp_.setInputSource(cloud);
+
+  // Seed with the IMU rotation accumulated since the reference cloud was
+  // pinned: a fast yaw no longer has to be discovered from identity.
+  Eigen::Matrix4f guess = Eigen::Matrix4f::Identity();
+  if (imu_seed_mode_) {
+    std::lock_guard<std::mutex> lock(imu_mutex_);
+    if (imu_received_) {
+      const Eigen::Quaterniond delta =
+        keyframe_imu_q_.conjugate() * latest_imu_q_;
+      guess.block(0, 0, 3, 3) = delta.toRotationMatrix().cast<float>();
+    }
+  }
 
-  // Align.
-  icp.align(*aligned_cloud_);
+  // Coarse-to-fine prealignment refines the seed, so the fine level only
+  // needs a few cleanup iterations.
+  if (pyramid_mode_)
+    guess = pyramid_.CoarseAlign(cloud, previous_cloud_, guess);
 
-  // Update pointer to last point cloud.
-  pcl::copyPointCloud(*cloud, *previous_cloud_);
+  // Align.
+  icp_.align(*aligned_cloud_, guess);
 
-  // Get transform.
-  Eigen::Matrix4d pose = icp.getFinalTransformation().cast<double>();
+  // Get transform. In keyframe mode this is motion relative to the pinned
+  // keyframe, so chain through the previous frame's keyframe delta to
+  // recover the incremental motion.
+  Eigen::Matrix4d pose = icp_.getFinalTransformation().cast<double>();
 
-  Transform3D incremental_transform(pose);
+  Transform3D keyframe_delta(pose);
+  Transform3D incremental_transform = keyframe_delta_.Inverse() * keyframe_delta;
   integrated_transform_ *= incremental_transform;
+
+  if (!keyframe_mode_ || IsKeyframeStale(keyframe_delta)) {
+    // Re-pin: the current scan becomes the new reference cloud, O(1);
+    // the old reference is released, not copied over.
+    previous_cloud_ = cloud;
+    icp_.setInputTarget(previous_cloud_);
+    keyframe_delta_ = Transform3D();
+
+    std::lock_guard<std::mutex> lock(imu_mutex_);
+    keyframe_imu_q_ = latest_imu_q_;
+  } else {
+    // Keep the keyframe pinned. The cached target stays warm, and during
+    // hover successive scans keep aligning against the same reference.
+    keyframe_delta_ = keyframe_delta;
+  }
+}
+
+// Decide whether motion relative to the keyframe warrants re-pinning.
+bool UAVOdometry::IsKeyframeStale(const Transform3D& delta) {
+  const double translation = delta.GetTranslation().norm();
+  const double cos_angle =
+    std::min(1.0, std::max(-1.0, 0.5 * (delta.GetRotation().trace() - 1.0)));
+  const double rotation = std::acos(cos_angle);
+
+  return (translation > keyframe_trans_thresh_ ||
+          rotation > keyframe_rot_thresh_);
 }
@@ -45,8 +45,12 @@
 
 #include <ros/ros.h>
 #include <message_synchronizer/message_synchronizer.h>
+#include <message_synchronizer/bounded_queue.h>
 #include <point_cloud_filter/point_cloud_filter.h>
 #include <utils/math/transform_3d.h>
+#include <utils/timing/stage_timer.h>
+#include <utils/timing/trace.h>
+#include <utils/types/cloud_pool.h>
 #include <uav_odometry/uav_odometry.h>
 #include <uav_mapper/uav_mapper.h>
 #include <uav_localization/uav_localization.h>
@@ -57,6 +61,7 @@
 #include <tf2_ros/transform_broadcaster.h>
 #include <Eigen/Dense>
 #include <cmath>
+#include <thread>
 
 typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
 using namespace math;
@@ -68,13 +73,37 @@ class UAVSlam {
 
   bool Initialize(const ros::NodeHandle& n);
 
+  // Process one scan synchronously: filter, localize, publish. Used by
+  // the subscriber callback in serial mode and by the offline benchmark
+  // harness, which bypasses the ROS transport entirely.
+  void ProcessScan(const PointCloud::ConstPtr& cloud);
+
+  // Current number of points in the map.
+  size_t MapSize();
+
  private:
+  // A unit of work flowing between pipeline stages.
+  struct ScanJob {
+    PointCloud::ConstPtr raw;
+    PointCloud::Ptr filtered;
+    Transform3D refined;
+    Transform3D odometry;
+    ros::Time stamp;
+  };
+
   bool LoadParameters(const ros::NodeHandle& n);
   bool RegisterCallbacks(const ros::NodeHandle& n);
 
   // Callbacks.
   void AddPointCloudCallback(const PointCloud::ConstPtr& cloud);
   void TimerCallback(const ros::TimerEvent& event);
+  void DiagnosticsTimerCallback(const ros::TimerEvent& event);
+
+  // Pipeline stages. Each runs on its own thread so filtering of scan N+1
+  // overlaps alignment of scan N.
+  void FilterThread();
+  void LocalizeThread();
+  void PublishThread();
 
   // Publish.
   void PublishPose(const Transform3D& transform,
@@ -93,9 +122,21 @@ class UAVSlam {
   ros::Timer timer_;
   MessageSynchronizer<PointCloud::ConstPtr> synchronizer_;
 
+  // Pipeline handoff queues and worker threads. Single-producer,
+  // single-consumer stages preserve scan order end to end.
+  BoundedQueue<PointCloud::ConstPtr> filter_queue_;
+  BoundedQueue<ScanJob> localize_queue_;
+  BoundedQueue<ScanJob> publish_queue_;
+  std::thread filter_thread_;
+  std::thread localize_thread_;
+  std::thread publish_thread_;
+
   // Publishers.
   ros::Publisher scan_publisher_full_;
   ros::Publisher scan_publisher_filtered_;
+  ros::Publisher diagnostics_publisher_;
+  ros::Timer diagnostics_timer_;
+  timing::TraceEmitter trace_;
   tf2_ros::TransformBroadcaster transform_broadcaster_;
 
   // Time stamp.
@@ -103,6 +144,8 @@ class UAVSlam {
 
   std::string scanner_topic_, filtered_topic_, unfiltered_topic_,
     world_frame_, odometry_frame_, localized_frame_;
+  int queue_capacity_;
+  bool pipeline_mode_;
   bool first_step_;
   bool initialized_;
   std::string name_;
@@ -44,7 +44,20 @@
 
 // Constructor/destructor.
 UAVSlam::UAVSlam() : initialized_(false) {}
-UAVSlam::~UAVSlam() {}
+
+UAVSlam::~UAVSlam() {
+  // Unblock and join the pipeline threads.
+  filter_queue_.Stop();
+  localize_queue_.Stop();
+  publish_queue_.Stop();
+
+  if (filter_thread_.joinable())
+    filter_thread_.join();
+  if (localize_thread_.joinable())
+    localize_thread_.join();
+  if (publish_thread_.joinable())
+    publish_thread_.join();
+}
 
 // Initialize.
 bool UAVSlam::Initialize(const ros::NodeHandle& n) {
@@ -99,6 +112,10 @@ bool UAVSlam::LoadParameters(const ros::NodeHandle& n) {
     return false;
   if (!ros::param::get("/uav_slam/io/localized_frame", localized_frame_))
     return false;
+  if (!ros::param::get("/uav_slam/io/pipeline_mode", pipeline_mode_))
+    return false;
+  if (!ros::param::get("/uav_slam/io/queue_capacity", queue_capacity_))
+    return false;
 
   return true;
 }
@@ -117,13 +134,76 @@ bool UAVSlam::RegisterCallbacks(const ros::NodeHandle& n) {
     node.advertise<PointCloud>(unfiltered_topic_.c_str(), 10, false);
   scan_publisher_filtered_ =
     node.advertise<PointCloud>(filtered_topic_.c_str(), 10, false);
+  diagnostics_publisher_ =
+    node.advertise<diagnostic_msgs::DiagnosticArray>("diagnostics", 1, false);
+
+  // Periodically flush per-stage timing histograms.
+  diagnostics_timer_ = node.createTimer(
+    ros::Duration(1.0), &UAVSlam::DiagnosticsTimerCallback, this);
+
+  // Cross-node trace sidecar.
+  trace_.Advertise(node);
 
   // Timer.
   //timer_ = n.createTimer(ros::Duration(0.1), &UAVSlam::TimerCallback, this);
 
+  // Spin up the pipeline stages.
+  if (pipeline_mode_) {
+    filter_queue_.SetCapacity(queue_capacity_);
+    localize_queue_.SetCapacity(queue_capacity_);
+    publish_queue_.SetCapacity(queue_capacity_);
+
+    filter_thread_ = std::thread(&UAVSlam::FilterThread, this);
+    localize_thread_ = std::thread(&UAVSlam::LocalizeThread, this);
+    publish_thread_ = std::thread(&UAVSlam::PublishThread, this);
+  }
+
   return true;
 }
 
+// Filter stage: downsample and denoise incoming scans.
+void UAVSlam::FilterThread() {
+  PointCloud::ConstPtr cloud;
+  while (filter_queue_.Pop(cloud)) {
+    ScanJob job;
+    job.raw = cloud;
+
+    // Copy out of the filter's reused buffer before handing downstream,
+    // since the next scan will overwrite it. The destination is a pooled
+    // buffer whose capacity survives recycling.
+    job.filtered = CloudPool::Instance().Acquire();
+    *job.filtered = *filter_.Filter(cloud);
+    localize_queue_.Push(job);
+  }
+}
+
+// Localization stage: align each filtered scan and snapshot the resulting
+// transforms for the publish stage.
+void UAVSlam::LocalizeThread() {
+  ScanJob job;
+  while (localize_queue_.Pop(job)) {
+    localization_.Localize(job.filtered);
+    trace_.Emit(job.raw->header.stamp * 1000ull, "uav_slam/localized");
+
+    job.refined = localization_.GetRefinedTransform();
+    job.odometry = localization_.GetOdometryTransform();
+    job.stamp.fromNSec(job.raw->header.stamp * 1000);
+    publish_queue_.Push(job);
+  }
+}
+
+// Publish stage: broadcast poses and scans off the critical path.
+void UAVSlam::PublishThread() {
+  ScanJob job;
+  while (publish_queue_.Pop(job)) {
+    stamp_ = job.stamp;
+    PublishPose(job.refined, localized_frame_);
+    PublishPose(job.odometry, odometry_frame_);
+    PublishFullScan(job.raw);
+    PublishFilteredScan(job.filtered);
+  }
+}
+
 // Timer callback.
 void UAVSlam::TimerCallback(const ros::TimerEvent& event) {
   std::vector<PointCloud::ConstPtr> sorted_clouds;
@@ -146,13 +226,47 @@ void UAVSlam::TimerCallback(const ros::TimerEvent& event) {
 }
 
 
+// Publish aggregated per-stage latency histograms.
+void UAVSlam::DiagnosticsTimerCallback(const ros::TimerEvent& event) {
+  if (diagnostics_publisher_.getNumSubscribers() == 0)
+    return;
+
+  diagnostic_msgs::DiagnosticArray msg;
+  msg.header.stamp = ros::Time::now();
+  timing::StageRegistry::Instance().Fill(msg);
+  diagnostics_publisher_.publish(msg);
+}
+
 // Point cloud callback.
 void UAVSlam::AddPointCloudCallback(const PointCloud::ConstPtr& cloud) {
+  timing::ScopedTimer callback_timer("uav_slam/add_point_cloud_callback");
   //  synchronizer_.AddMessage(cloud);
-  PointCloud::Ptr filtered_cloud = filter_.Filter(cloud);
+
+  // The scan's stamp is the pipeline-wide correlation ID (pcl stamps are
+  // microseconds).
+  trace_.Emit(cloud->header.stamp * 1000ull, "uav_slam/receive");
+
+  // In pipeline mode the callback only enqueues: a slow ICP solve sheds
+  // the oldest queued scan instead of backing up the subscriber queue.
+  if (pipeline_mode_) {
+    filter_queue_.Push(cloud);
+    return;
+  }
+
+  ProcessScan(cloud);
+}
+
+// Process one scan synchronously. The filter output is copied here:
+// downstream (odometry keyframe pinning, intra-process subscribers)
+// retains clouds by shared pointer, which the filter's reused buffer
+// cannot back. The pipeline path makes this copy in its filter stage.
+void UAVSlam::ProcessScan(const PointCloud::ConstPtr& cloud) {
+  PointCloud::Ptr filtered_cloud = CloudPool::Instance().Acquire();
+  *filtered_cloud = *filter_.Filter(cloud);
 
   // Localize.
   localization_.Localize(filtered_cloud);
+  trace_.Emit(cloud->header.stamp * 1000ull, "uav_slam/localized");
 
   // Publish.
   stamp_.fromNSec(cloud->header.stamp * 1000);
@@ -162,16 +276,20 @@ void UAVSlam::AddPointCloudCallback(const PointCloud::ConstPtr& cloud) {
   PublishFilteredScan(filtered_cloud);
 }
 
+// Current number of points in the map.
+size_t UAVSlam::MapSize() {
+  return mapper_.Size();
+}
+
 // Publish refimed transform.
 void UAVSlam::PublishPose(const Transform3D& transform,
                           const std::string& child_frame_id) {
   geometry_msgs::TransformStamped stamped;
 
-  Eigen::Matrix3d rotation = transform.GetRotation();
   Eigen::Vector3d translation = transform.GetTranslation();
 
-  Eigen::Quaterniond quat(rotation);
-  quat.normalize();
+  // Cached on the transform; only recomputed after a mutation.
+  const Transform3D::Quaternion& quat = transform.GetQuaternion();
 
   stamped.transform.rotation.x = quat.x();
   stamped.transform.rotation.y = quat.y();
@@ -187,24 +305,26 @@ void UAVSlam::PublishPose(const Transform3D& transform,
   transform_broadcaster_.sendTransform(stamped);
 }
 
-// Publish full scan.
+// Publish full scan. Patch the header in place and publish the shared
+// pointer, rather than copying several MB of points just to restamp: this
+// node owns the incoming message, and publishing a shared pointer also
+// lets intraprocess subscribers skip serialization entirely.
 void UAVSlam::PublishFullScan(const PointCloud::ConstPtr& cloud) {
   if (scan_publisher_full_.getNumSubscribers() == 0)
     return;
 
-  PointCloud msg = *cloud;
-  msg.header.stamp = stamp_.toNSec() / 1000;
-  msg.header.frame_id = localized_frame_.c_str();
+  PointCloud::Ptr msg = boost::const_pointer_cast<PointCloud>(cloud);
+  msg->header.stamp = stamp_.toNSec() / 1000;
+  msg->header.frame_id = localized_frame_.c_str();
   scan_publisher_full_.publish(msg);
 }
 
-// Publish filtered scan.
+// Publish filtered scan, zero-copy as above.
 void UAVSlam::PublishFilteredScan(const PointCloud::Ptr& cloud) {
   if (scan_publisher_filtered_.getNumSubscribers() == 0)
     return;
 
-  PointCloud msg = *cloud;
-  msg.header.stamp = stamp_.toNSec() / 1000;
-  msg.header.frame_id = localized_frame_.c_str();
-  scan_publisher_filtered_.publish(msg);
+  cloud->header.stamp = stamp_.toNSec() / 1000;
+  cloud->header.frame_id = localized_frame_.c_str();
+  scan_publisher_filtered_.publish(cloud);
 }
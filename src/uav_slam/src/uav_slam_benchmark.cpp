@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Offline benchmark harness for the uav_slam pipeline. Replays recorded
+// point clouds from a bag straight into UAVSlam::ProcessScan (no ROS
+// transport in the loop), then reports per-scan latency percentiles,
+// peak RSS, and final map size as a single line of JSON so runs can be
+// compared mechanically.
+//
+// Usage: uav_slam_benchmark <bag file>
+// Parameters are read from the parameter server exactly as for the live
+// node, so load the usual yaml files first.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <uav_slam/uav_slam.h>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <pcl_conversions/pcl_conversions.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+  // Latency at the given percentile, assuming latencies is sorted.
+  double Percentile(const std::vector<double>& latencies, double fraction) {
+    if (latencies.empty())
+      return 0.0;
+
+    size_t index = static_cast<size_t>(fraction * latencies.size());
+    if (index >= latencies.size())
+      index = latencies.size() - 1;
+    return latencies[index];
+  }
+
+  // Peak resident set size in kB, from /proc/self/status.
+  long PeakRSSKilobytes() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+      if (line.compare(0, 6, "VmHWM:") == 0)
+        return atol(line.c_str() + 6);
+    }
+    return -1;
+  }
+} //\ namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "uav_slam_benchmark");
+  ros::NodeHandle n("~");
+
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <bag file>\n", argv[0]);
+    return 1;
+  }
+
+  // Run the pipeline serially so per-scan latency is well-defined.
+  ros::param::set("/uav_slam/io/pipeline_mode", false);
+
+  UAVSlam slam;
+  if (!slam.Initialize(n)) {
+    ROS_ERROR("uav_slam_benchmark: Failed to initialize UAVSlam.");
+    return 1;
+  }
+
+  std::string scanner_topic;
+  ros::param::get("/uav_slam/io/scanner_topic", scanner_topic);
+
+  rosbag::Bag bag(argv[1], rosbag::bagmode::Read);
+  rosbag::View view(bag, rosbag::TopicQuery(scanner_topic));
+
+  std::vector<double> latencies;
+  for (rosbag::View::iterator it = view.begin(); it != view.end(); ++it) {
+    sensor_msgs::PointCloud2::ConstPtr msg =
+      it->instantiate<sensor_msgs::PointCloud2>();
+    if (!msg)
+      continue;
+
+    PointCloud::Ptr cloud(new PointCloud);
+    pcl::fromROSMsg(*msg, *cloud);
+
+    const ros::WallTime start = ros::WallTime::now();
+    slam.ProcessScan(cloud);
+    latencies.push_back((ros::WallTime::now() - start).toSec());
+  }
+  bag.close();
+
+  std::sort(latencies.begin(), latencies.end());
+
+  double total = 0.0;
+  for (size_t ii = 0; ii < latencies.size(); ii++)
+    total += latencies[ii];
+
+  printf("{\"bag\": \"%s\", \"scans\": %lu, "
+         "\"mean_ms\": %.3f, \"p50_ms\": %.3f, \"p90_ms\": %.3f, "
+         "\"p99_ms\": %.3f, \"max_ms\": %.3f, "
+         "\"peak_rss_kb\": %ld, \"map_points\": %lu}\n",
+         argv[1], latencies.size(),
+         latencies.empty() ? 0.0 : 1000.0 * total / latencies.size(),
+         1000.0 * Percentile(latencies, 0.50),
+         1000.0 * Percentile(latencies, 0.90),
+         1000.0 * Percentile(latencies, 0.99),
+         latencies.empty() ? 0.0 : 1000.0 * latencies.back(),
+         PeakRSSKilobytes(), slam.MapSize());
+
+  return 0;
+}
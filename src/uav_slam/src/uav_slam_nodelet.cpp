@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Nodelet wrapper for the UAVSlam pipeline. Running it in the same
+// nodelet manager as octomap_server gives intra-process shared-pointer
+// message passing, so multi-megabyte clouds stop being serialized
+// between our own processes.
+//
+// Run with /uav_slam/io/pipeline_mode enabled (the default): intra-process
+// subscribers hold the published cloud pointers asynchronously, and the
+// pipeline publishes a per-scan copy, while the serial path publishes the
+// filter's reused buffer.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <uav_slam/uav_slam.h>
+
+#include <ros/ros.h>
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+namespace uav_slam {
+
+class UAVSlamNodelet : public nodelet::Nodelet {
+ public:
+  virtual void onInit() {
+    NODELET_DEBUG("Initializing uav_slam nodelet...");
+
+    slam_.reset(new UAVSlam());
+    if (!slam_->Initialize(getNodeHandle()))
+      NODELET_ERROR("Failed to initialize UAVSlam nodelet.");
+  }
+
+ private:
+  boost::shared_ptr<UAVSlam> slam_;
+};
+
+} //\ namespace uav_slam
+
+PLUGINLIB_DECLARE_CLASS(uav_slam, UAVSlamNodelet, uav_slam::UAVSlamNodelet, nodelet::Nodelet);
@@ -118,6 +118,15 @@ class Camera {
   bool WorldToImage(double wx, double wy, double wz,
                     double* u_distorted, double* v_distorted) const;
 
+  // Batched projection: apply extrinsics, the k1-k5 distortion model and
+  // the intrinsic matrix to a whole cloud as column-wise Eigen
+  // expressions. Column ii of points is a world-frame point; pixels gets
+  // its distorted image coordinates, and valid_mask[ii] is nonzero when
+  // the point lies in front of the camera, within the distortion model's
+  // trust region, and inside the image bounds.
+  void ProjectCloud(const Eigen::Matrix3Xd& points, Eigen::Matrix2Xd& pixels,
+                    uint8_t* valid_mask) const;
+
   // Convert a normalized unit direction into the image by distorting it with
   // the camera's radial distortion parameters.
   bool DirectionToImage(double u_normalized, double v_normalized,
@@ -219,6 +228,55 @@ bool Camera::WorldToImage(double wx, double wy, double wz, double *u_distorted,
   return CameraToImage(cx, cy, cz, u_distorted, v_distorted);
 }
 
+// Batched projection of a whole cloud through extrinsics, distortion and
+// intrinsics, as vectorized column operations.
+void Camera::ProjectCloud(const Eigen::Matrix3Xd& points,
+                          Eigen::Matrix2Xd& pixels,
+                          uint8_t* valid_mask) const {
+  const Eigen::Index num_points = points.cols();
+  pixels.resize(2, num_points);
+  if (num_points == 0)
+    return;
+
+  // Extrinsics in one multiply.
+  const Matrix34d Rt = extrinsics_.Rt();
+  Eigen::Matrix3Xd cam = Rt.block<3, 3>(0, 0) * points;
+  cam.colwise() += Eigen::Vector3d(Rt.col(3));
+
+  // Normalized direction vectors.
+  Eigen::ArrayXd u = cam.row(0).array() / cam.row(2).array();
+  Eigen::ArrayXd v = cam.row(1).array() / cam.row(2).array();
+
+  // k1-k5 distortion, vectorized (same model as Distort()). Points whose
+  // radial term leaves the model's trust region are marked invalid
+  // instead of taking the per-point warp fallback.
+  const CameraIntrinsics& intr = intrinsics_;
+  Eigen::ArrayXd r_sq = u * u + v * v;
+  Eigen::ArrayXd radial =
+    1.0 + intr.k1() * r_sq + intr.k2() * r_sq * r_sq
+    + intr.k5() * r_sq * r_sq * r_sq;
+
+  Eigen::ArrayXd u_dist = radial * u
+    + 2.0 * intr.k3() * u * v + intr.k4() * (r_sq + 2.0 * u * u);
+  Eigen::ArrayXd v_dist = radial * v
+    + intr.k3() * (r_sq + 2.0 * v * v) + 2.0 * intr.k4() * u * v;
+
+  // Intrinsic matrix, expanded (K is upper triangular).
+  const Matrix3d K = intr.K();
+  pixels.row(0) =
+    (K(0, 0) * u_dist + K(0, 1) * v_dist + K(0, 2)).matrix().transpose();
+  pixels.row(1) = (K(1, 1) * v_dist + K(1, 2)).matrix().transpose();
+
+  // One mask pass: in front of the camera, trusted distortion, inside
+  // the image.
+  for (Eigen::Index ii = 0; ii < num_points; ii++) {
+    valid_mask[ii] =
+      (cam(2, ii) >= 0.0 &&
+       radial(ii) >= 0.85 && radial(ii) <= 1.15 &&
+       intr.PointInImage(pixels(0, ii), pixels(1, ii))) ? 1 : 0;
+  }
+}
+
 // Convert a normalized unit direction into the image by distorting it with the
 // camera's radial distortion parameters.
 bool Camera::DirectionToImage(double u_normalized, double v_normalized,
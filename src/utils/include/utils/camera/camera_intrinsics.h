@@ -53,6 +53,8 @@
 #include <Eigen/Dense>
 #include <glog/logging.h>
 
+#include <vector>
+
 namespace bsfm {
 
 using Eigen::Matrix3d;
@@ -119,6 +121,15 @@ class CameraIntrinsics {
   // Test if a point is in the image.
   bool PointInImage(double u, double v) const;
 
+  // Fast path for ImageToDirection through a lazily-built per-pixel
+  // undistortion LUT. The table is built once at image resolution on
+  // first use (each entry runs the iterative inversion exactly once) and
+  // invalidated by any Set* call; afterwards a lookup is one bilinear
+  // gather. Falls back to the analytic path off the image.
+  void ImageToDirectionFast(double u_distorted, double v_distorted,
+                            double *u_normalized,
+                            double *v_normalized) const;
+
   // Check if a point is in front of the camera.
   bool CameraToImage(double cx, double cy, double cz, double *u_distorted,
                      double *v_distorted) const;
@@ -151,6 +162,12 @@ class CameraIntrinsics {
   double k3_;
   double k4_;
   double k5_;
+
+  // Per-pixel undistortion LUT (2 floats per pixel, row-major), built
+  // lazily and invalidated whenever the intrinsics change.
+  void BuildUndistortionLUT() const;
+  mutable std::vector<float> undistort_lut_;
+  mutable bool lut_valid_;
   double horizontal_fov_;
   double vertical_fov_;
 };  //\class CameraIntrinsics
@@ -172,6 +189,7 @@ CameraIntrinsics::CameraIntrinsics()
       k3_(0.0),
       k4_(0.0),
       k5_(0.0),
+      lut_valid_(false),
       horizontal_fov_(0.0),
       vertical_fov_(0.0) {}
 
@@ -190,7 +208,8 @@ CameraIntrinsics::CameraIntrinsics(const Matrix3d &K, int image_width,
       k2_(0.0),
       k3_(0.0),
       k4_(0.0),
-      k5_(0.0) {
+      k5_(0.0),
+      lut_valid_(false) {
   horizontal_fov_ = 2.0 * atan2(0.5 * image_width_, f_u_);
   vertical_fov_ = 2.0 * atan2(0.5 * image_height_, f_v_);
 }
@@ -213,7 +232,8 @@ CameraIntrinsics::CameraIntrinsics(int image_left, int image_top,
       k2_(k2),
       k3_(k3),
       k4_(k4),
-      k5_(k5) {
+      k5_(k5),
+      lut_valid_(false) {
   horizontal_fov_ = 2.0 * atan2(0.5 * image_width_, f_u_);
   vertical_fov_ = 2.0 * atan2(0.5 * image_height_, f_v_);
 }
@@ -221,38 +241,46 @@ CameraIntrinsics::CameraIntrinsics(int image_left, int image_top,
 // Set individual parameters.
 void CameraIntrinsics::SetImageLeft(int image_left) {
   image_left_ = image_left;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetImageTop(int image_top) {
   image_top_ = image_top;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetImageWidth(int image_width) {
   image_width_ = image_width;
   horizontal_fov_ = 2.0 * atan2(0.5 * image_width_, f_u_);
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetImageHeight(int image_height) {
   image_height_ = image_height;
   vertical_fov_ = 2.0 * atan2(0.5 * image_height_, f_v_);
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetFU(double f_u) {
   f_u_ = f_u;
   horizontal_fov_ = 2.0 * atan2(0.5 * image_width_, f_u_);
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetFV(double f_v) {
   f_v_ = f_v;
   vertical_fov_ = 2.0 * atan2(0.5 * image_height_, f_v_);
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetCU(double c_u) {
   c_u_ = c_u;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetCV(double c_v) {
   c_v_ = c_v;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetK(double k1, double k2, double k3, double k4,
@@ -262,36 +290,44 @@ void CameraIntrinsics::SetK(double k1, double k2, double k3, double k4,
   k3_ = k3;
   k4_ = k4;
   k5_ = k5;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetK1(double k1) {
   k1_ = k1;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetK2(double k2) {
   k2_ = k2;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetK3(double k3) {
   k3_ = k3;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetK4(double k4) {
   k4_ = k4;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetK5(double k5) {
   k5_ = k5;
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetHorizontalFOV(double horizontal_fov) {
   horizontal_fov_ = horizontal_fov;
   f_u_ = 0.5 * image_width_ / tan(0.5 * horizontal_fov_);
+  lut_valid_ = false;
 }
 
 void CameraIntrinsics::SetVerticalFOV(double vertical_fov) {
   vertical_fov_ = vertical_fov;
   f_v_ = 0.5 * image_height_ / tan(0.5 * vertical_fov_);
+  lut_valid_ = false;
 }
 
 // Extract parameters.
@@ -469,6 +505,77 @@ void CameraIntrinsics::Distort(double u, double v, double *u_distorted,
 }
 
 // Rectilinearize point.
+// Build the per-pixel undistortion LUT: one iterative inversion per
+// pixel, after which every lookup is a bilinear gather.
+void CameraIntrinsics::BuildUndistortionLUT() const {
+  undistort_lut_.assign(2 * static_cast<size_t>(image_width_)
+                        * static_cast<size_t>(image_height_), 0.f);
+
+  for (int v = 0; v < image_height_; ++v) {
+    for (int u = 0; u < image_width_; ++u) {
+      // The table spans the absolute pixel domain, honoring the image
+      // left/top offsets.
+      double u_normalized = 0.0, v_normalized = 0.0;
+      ImageToDirection(static_cast<double>(image_left_ + u),
+                       static_cast<double>(image_top_ + v),
+                       &u_normalized, &v_normalized);
+
+      const size_t index =
+        2 * (static_cast<size_t>(v) * image_width_ + u);
+      undistort_lut_[index] = static_cast<float>(u_normalized);
+      undistort_lut_[index + 1] = static_cast<float>(v_normalized);
+    }
+  }
+
+  lut_valid_ = true;
+}
+
+// Fast path for ImageToDirection: bilinear gather from the LUT.
+void CameraIntrinsics::ImageToDirectionFast(double u_distorted,
+                                            double v_distorted,
+                                            double *u_normalized,
+                                            double *v_normalized) const {
+  CHECK_NOTNULL(u_normalized);
+  CHECK_NOTNULL(v_normalized);
+
+  // Off the image (or no image configured): analytic fallback. The LUT
+  // spans the absolute pixel domain starting at the image left/top.
+  const double u_local = u_distorted - image_left_;
+  const double v_local = v_distorted - image_top_;
+  if (image_width_ < 2 || image_height_ < 2 ||
+      u_local < 0.0 || u_local > image_width_ - 1 ||
+      v_local < 0.0 || v_local > image_height_ - 1) {
+    ImageToDirection(u_distorted, v_distorted, u_normalized, v_normalized);
+    return;
+  }
+
+  if (!lut_valid_)
+    BuildUndistortionLUT();
+
+  const int u0 = static_cast<int>(u_local);
+  const int v0 = static_cast<int>(v_local);
+  const int u1 = (u0 + 1 < image_width_) ? u0 + 1 : u0;
+  const int v1 = (v0 + 1 < image_height_) ? v0 + 1 : v0;
+  const float au = static_cast<float>(u_local - u0);
+  const float av = static_cast<float>(v_local - v0);
+
+  const float* lut = &undistort_lut_[0];
+  const size_t i00 = 2 * (static_cast<size_t>(v0) * image_width_ + u0);
+  const size_t i01 = 2 * (static_cast<size_t>(v0) * image_width_ + u1);
+  const size_t i10 = 2 * (static_cast<size_t>(v1) * image_width_ + u0);
+  const size_t i11 = 2 * (static_cast<size_t>(v1) * image_width_ + u1);
+
+  const float w00 = (1.f - au) * (1.f - av);
+  const float w01 = au * (1.f - av);
+  const float w10 = (1.f - au) * av;
+  const float w11 = au * av;
+
+  *u_normalized = w00 * lut[i00] + w01 * lut[i01]
+    + w10 * lut[i10] + w11 * lut[i11];
+  *v_normalized = w00 * lut[i00 + 1] + w01 * lut[i01 + 1]
+    + w10 * lut[i10 + 1] + w11 * lut[i11 + 1];
+}
+
 void CameraIntrinsics::Undistort(double u_distorted, double v_distorted,
                                  double *u, double *v, int iterations) const {
   CHECK_NOTNULL(u);
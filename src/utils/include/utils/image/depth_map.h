@@ -39,6 +39,9 @@
 
 #include <utils/image/image.h>
 #include <Eigen/Dense>
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+#include <vector>
 
 using Eigen::Vector3d;
 
@@ -56,6 +59,12 @@ namespace bsfm {
     Vector3d Unproject(size_t u, size_t v) const;
     bool SaturatedAt(size_t u, size_t v) const;
 
+    // Unproject every pixel into a contiguous cloud buffer in one pass:
+    // the inversion branch is hoisted out of the loop, the per-column and
+    // per-row ray factors are precomputed once from the intrinsics, and
+    // saturated pixels are skipped.
+    void UnprojectAll(pcl::PointCloud<pcl::PointXYZ>& cloud) const;
+
     // Setters.
     void SetInverted(bool value);
 
@@ -108,6 +117,51 @@ namespace bsfm {
     return GetValue(u, v) <= 0 || GetValue(u, v) >= 255;
   }
 
+  void DepthMap::UnprojectAll(pcl::PointCloud<pcl::PointXYZ>& cloud) const {
+    // @TODO jds: Need to load these from a parameter or something
+    const double focal_length_x = 248.9;
+    const double focal_length_y = 247.6;
+
+    const size_t width = Width();
+    const size_t height = Height();
+
+    cloud.points.clear();
+    cloud.points.reserve(width * height);
+
+    // Precompute the ray factor of every column and row once.
+    std::vector<float> col_factors(width), row_factors(height);
+    for (size_t u = 0; u < width; u++)
+      col_factors[u] = static_cast<float>(
+        (u - width / 2.0) / focal_length_x);
+    for (size_t v = 0; v < height; v++)
+      row_factors[v] = static_cast<float>(
+        (v - height / 2.0) / focal_length_y);
+
+    // Hoist the inversion branch out of the pixel loop.
+    const bool inverted = IsInverted();
+
+    for (size_t v = 0; v < height; v++) {
+      const float row_factor = row_factors[v];
+      for (size_t u = 0; u < width; u++) {
+        uchar value = at<uchar>(v, u * 3);
+        if (inverted)
+          value = 255 - value;
+
+        // Skip saturated (invalid) pixels.
+        if (value == 0 || value == 255)
+          continue;
+
+        const float z = static_cast<float>(value);
+        cloud.points.push_back(
+          pcl::PointXYZ(col_factors[u] * z, row_factor * z, z));
+      }
+    }
+
+    cloud.width = static_cast<uint32_t>(cloud.points.size());
+    cloud.height = 1;
+    cloud.is_dense = true;
+  }
+
 } //\ namespace bsfm
 
 #endif
@@ -46,6 +46,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include <Eigen/Dense>
 #include <glog/logging.h>
@@ -93,9 +94,22 @@ class Image {
   void ToCV(cv::Mat& out) const;
   void FromCV(const cv::Mat& in);
 
-  // Convert to Eigen matrix.
+  // Convert to Eigen matrix (copies and converts).
   void ToEigen(MatrixXf& eigen_out);
 
+  // Zero-copy row-major Eigen views aliasing the underlying Mat buffer.
+  // Only available when the data is already in the mapped element type,
+  // single channel and contiguous (anything else needs a converting
+  // copy; use ToEigen for that). The view is invalidated by any call
+  // that mutates the image.
+  typedef Eigen::Map<Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic,
+                                   Eigen::RowMajor> > EigenViewF;
+  typedef Eigen::Map<Eigen::Matrix<unsigned char, Eigen::Dynamic,
+                                   Eigen::Dynamic, Eigen::RowMajor> >
+    EigenViewU;
+  EigenViewF ViewF();
+  EigenViewU ViewU();
+
   // Save and load.
   void Read(const std::string& filename, bool grayscale = false);
   void Write(const std::string& filename) const;
@@ -112,7 +126,10 @@ class Image {
   void Resize(double scale);
   void Resize(size_t new_width, size_t new_height);
 
-  // Transpose, rotate, and flip.
+  // Transpose, rotate, and flip. These are lazy: each call only updates
+  // the pending-view flags (the eight axis-aligned orientations form a
+  // closed group), and the pixels are rearranged once, on the next access
+  // that needs contiguous data.
   void Transpose();
   void RotateClockwise();
   void RotateCounterClockwise();
@@ -139,8 +156,16 @@ class Image {
 
   std::string GetTypeStr() const;
  private:
+  // Apply any pending lazy transforms to the pixel data.
+  void Materialize() const;
+
   bool grayscale_;
   std::shared_ptr<cv::Mat> image_;
+
+  // Pending lazy view state, applied as transpose first, then the flips.
+  mutable bool pending_transpose_ = false;
+  mutable bool pending_flip_lr_ = false;
+  mutable bool pending_flip_ud_ = false;
 }; //\class Image
 
 // Non-member conversion from OpenCV to Eigen matrices.
@@ -159,12 +184,14 @@ inline void EigenMatToOpenCV(
 
 template <typename T>
 T& Image::at(size_t u, size_t v) {
+  Materialize();
   CHECK_NOTNULL(image_.get());
   return image_->template at<T>(u, v);
 }
 
 template <typename T>
 const T& Image::at(size_t u, size_t v) const {
+  Materialize();
   CHECK_NOTNULL(image_.get());
   return image_->template at<T>(u, v);
 }
@@ -196,6 +223,9 @@ void EigenMatToOpenCV(
 
 // Deep copy ctor.
 Image::Image(const Image& other) : grayscale_(false) {
+  pending_transpose_ = other.pending_transpose_;
+  pending_flip_lr_ = other.pending_flip_lr_;
+  pending_flip_ud_ = other.pending_flip_ud_;
   image_ = other.image_;
   grayscale_ = other.grayscale_;
 }
@@ -237,6 +267,7 @@ Image::Image(const Image& other) : grayscale_(false) {
 
 
  void Image::ToCV(cv::Mat& out) const {
+   Materialize();
    CHECK(image_.get()) << "Image data is not allocated.";
 
    if (grayscale_) {
@@ -247,6 +278,8 @@ Image::Image(const Image& other) : grayscale_(false) {
  }
 
  void Image::FromCV(const cv::Mat& in) {
+   // New pixel data: any pending lazy transforms no longer apply.
+   pending_transpose_ = pending_flip_lr_ = pending_flip_ud_ = false;
    CHECK(image_.get()) << "Image data is not allocated.";
 
    if (in.channels() == 1) {
@@ -258,11 +291,14 @@ Image::Image(const Image& other) : grayscale_(false) {
  }
 
  void Image::ToEigen(MatrixXf& eigen_out) {
+   Materialize();
    CHECK(image_.get()) << "Image data is not allocated.";
    OpenCVToEigenMat(*image_, eigen_out);
  }
 
  void Image::Read(const std::string& filename, bool grayscale) {
+   // New pixel data: any pending lazy transforms no longer apply.
+   pending_transpose_ = pending_flip_lr_ = pending_flip_ud_ = false;
    if (grayscale) {
      *image_ = cv::imread(filename.c_str(), CV_LOAD_IMAGE_GRAYSCALE);
      cv::cvtColor(*image_, *image_, CV_GRAY2RGB);
@@ -274,17 +310,18 @@ Image::Image(const Image& other) : grayscale_(false) {
  }
 
  void Image::Write(const std::string& filename) const {
+   Materialize();
    cv::imwrite(filename.c_str(), *image_);
  }
 
  size_t Image::Width() const {
    CHECK(image_.get()) << "Image data is not allocated.";
-   return image_->cols;
+   return pending_transpose_ ? image_->rows : image_->cols;
  }
 
  size_t Image::Height() const {
    CHECK(image_.get()) << "Image data is not allocated.";
-   return image_->rows;
+   return pending_transpose_ ? image_->cols : image_->rows;
  }
 
  size_t Image::Channels() const {
@@ -293,19 +330,24 @@ Image::Image(const Image& other) : grayscale_(false) {
  }
 
  void Image::Resize(double scale) {
+   Materialize();
    CHECK(image_.get()) << "Image data is not allocated.";
    cv::resize(*image_, *image_, cv::Size(), scale, scale, CV_INTER_LANCZOS4);
  }
 
  void Image::Resize(size_t new_width, size_t new_height) {
+   Materialize();
    CHECK(image_.get()) << "Image data is not allocated.";
    cv::resize(*image_, *image_, cv::Size(new_width, new_height),
               CV_INTER_LANCZOS4);
  }
 
+ // Appending a transpose to the pending state (transpose-then-flips)
+ // toggles the transpose and swaps the two flip axes.
  void Image::Transpose() {
    CHECK(image_.get()) << "Image data is not allocated.";
-   cv::transpose(*image_, *image_);
+   pending_transpose_ = !pending_transpose_;
+   std::swap(pending_flip_lr_, pending_flip_ud_);
  }
 
  void Image::RotateClockwise() {
@@ -322,15 +364,52 @@ Image::Image(const Image& other) : grayscale_(false) {
 
  void Image::FlipLR() {
    CHECK(image_.get()) << "Image data is not allocated.";
-   cv::flip(*image_, *image_, 1 /*about vertical axis*/);
+   pending_flip_lr_ = !pending_flip_lr_;
  }
 
  void Image::FlipUD() {
    CHECK(image_.get()) << "Image data is not allocated.";
-   cv::flip(*image_, *image_, 0 /*about horizontal axis*/);
+   pending_flip_ud_ = !pending_flip_ud_;
+ }
+
+ // Apply any pending lazy transforms, once, in canonical order.
+ void Image::Materialize() const {
+   if (!pending_transpose_ && !pending_flip_lr_ && !pending_flip_ud_)
+     return;
+
+   CHECK(image_.get()) << "Image data is not allocated.";
+   if (pending_transpose_)
+     cv::transpose(*image_, *image_);
+   if (pending_flip_lr_)
+     cv::flip(*image_, *image_, 1 /*about vertical axis*/);
+   if (pending_flip_ud_)
+     cv::flip(*image_, *image_, 0 /*about horizontal axis*/);
+
+   pending_transpose_ = false;
+   pending_flip_lr_ = false;
+   pending_flip_ud_ = false;
+ }
+
+ // Zero-copy views over the underlying buffer.
+ Image::EigenViewF Image::ViewF() {
+   Materialize();
+   CHECK(image_.get()) << "Image data is not allocated.";
+   CHECK(image_->type() == CV_32FC1) << "ViewF needs single-channel float data.";
+   CHECK(image_->isContinuous()) << "ViewF needs contiguous data.";
+   return EigenViewF(reinterpret_cast<float*>(image_->data),
+                     image_->rows, image_->cols);
+ }
+
+ Image::EigenViewU Image::ViewU() {
+   Materialize();
+   CHECK(image_.get()) << "Image data is not allocated.";
+   CHECK(image_->type() == CV_8UC1) << "ViewU needs single-channel 8-bit data.";
+   CHECK(image_->isContinuous()) << "ViewU needs contiguous data.";
+   return EigenViewU(image_->data, image_->rows, image_->cols);
  }
 
  void Image::ConvertToGrayscale() {
+   Materialize();
    CHECK(image_.get()) << "Image data is not allocated.";
 
    if (grayscale_) {
@@ -343,6 +422,7 @@ Image::Image(const Image& other) : grayscale_(false) {
  }
 
  void Image::ConvertToRGB() {
+   Materialize();
    CHECK(image_.get()) << "Image data is not allocated.";
 
    if (!grayscale_) {
@@ -357,6 +437,7 @@ Image::Image(const Image& other) : grayscale_(false) {
  // Add a colored circle at the specified location.
  void Image::Circle(unsigned int u, unsigned int v, unsigned int radius,
                     unsigned int line_thickness, double heat) {
+   Materialize();
    if (heat > 1.0 || heat < 0.0) {
      VLOG(1) << "Heat value is out of bounds.";
      return;
@@ -375,6 +456,7 @@ Image::Image(const Image& other) : grayscale_(false) {
  void Image::Line(unsigned int u1, unsigned int v1,
                   unsigned int u2, unsigned int v2,
                   unsigned int line_thickness, double heat) {
+   Materialize();
    if (heat > 1.0 || heat < 0.0) {
      VLOG(1) << "Heat value is out of bounds.";
      return;
@@ -393,6 +475,7 @@ Image::Image(const Image& other) : grayscale_(false) {
 
 
  void Image::ImShow(const std::string& window_name, unsigned int wait_time) {
+   Materialize();
    CHECK(image_.get()) << "Image data is not allocated.";
 
    cv::namedWindow(window_name.c_str(), CV_WINDOW_AUTOSIZE);
@@ -36,8 +36,9 @@
 
 ///////////////////////////////////////////////////////////////////////////////
 //
-// This class defines the Array3D class, which is a very simple wrapper around
-// std::vector to support 3D indexing.
+// This class defines the Array3D class, a flat contiguous container with 3D
+// indexing, raw-slab access for vectorized kernels, cache-blocked
+// iteration, and a six-neighbor stencil visitor for relaxation sweeps.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -45,7 +46,8 @@
 #define UTILS_ARRAY_3D_H
 
 #include <vector>
-#include <iostream>
+#include <algorithm>
+#include <cstddef>
 
 template<typename T>
 class Array3D {
@@ -53,12 +55,48 @@ public:
   ~Array3D() {}
   Array3D(size_t length, size_t width, size_t height);
 
-  // Accessor.
+  // Accessors. Unchecked: callers gate with IsValid(), and kernels that
+  // have already validated their bounds pay nothing per access.
   inline T& At(size_t ii, size_t jj, size_t kk);
+  inline const T& At(size_t ii, size_t jj, size_t kk) const;
 
   // Test out of bounds.
   inline bool IsValid(size_t ii, size_t jj, size_t kk) const;
 
+  // Flat index and raw-slab access. Storage is one contiguous block in
+  // ii-major order; neighbors along x/y/z sit at fixed strides, so
+  // stencil kernels can walk the slab directly.
+  inline size_t Index(size_t ii, size_t jj, size_t kk) const;
+  inline T* Data() { return data_.data(); }
+  inline const T* Data() const { return data_.data(); }
+  inline size_t XStride() const { return width_ * height_; }
+  inline size_t YStride() const { return height_; }
+  inline size_t Size() const { return data_.size(); }
+
+  // Dimensions.
+  inline size_t Length() const { return length_; }
+  inline size_t Width() const { return width_; }
+  inline size_t Height() const { return height_; }
+
+  // Overwrite every cell.
+  inline void Fill(const T& value);
+
+  // Visit a sub-box (inclusive bounds) in cache-blocked tiles, so deep
+  // loops reuse lines already resident instead of streaming the slab.
+  // Visitor is called as visitor(ii, jj, kk, cell reference).
+  template<typename Visitor>
+  void ForEachTiled(size_t ii0, size_t jj0, size_t kk0, size_t ii1,
+                    size_t jj1, size_t kk1, size_t tile, Visitor visitor);
+
+  // Visit every cell of a sub-box with its six neighbors loaded through
+  // precomputed strides. Bounds must be interior (>= 1 cell from every
+  // face). Visitor is called as
+  // visitor(ii, jj, kk, center reference,
+  //         left, right, back, front, down, up).
+  template<typename Visitor>
+  void ForEachStencil(size_t ii0, size_t jj0, size_t kk0, size_t ii1,
+                      size_t jj1, size_t kk1, Visitor visitor);
+
 private:
   const size_t length_, width_, height_;
   std::vector<T> data_;
@@ -73,20 +111,12 @@ Array3D<T>::Array3D(size_t length, size_t width, size_t height)
 
 template<typename T>
 T& Array3D<T>::At(size_t ii, size_t jj, size_t kk) {
-  if (ii >= length_) {
-    std::cerr << "X-index too large. Setting to max." << std::endl;
-    ii = length_ - 1;
-  }
-  if (jj >= width_) {
-    std::cerr << "Y-index too large. Setting to max." << std::endl;
-    jj = width_ - 1;
-  }
-  if (kk >= height_) {
-    std::cerr << "Z-index too large. Setting to max." << std::endl;
-    kk = height_ - 1;
-  }
+  return data_[Index(ii, jj, kk)];
+}
 
-  return data_.at(ii * width_ * height_ + jj * height_ + kk);
+template<typename T>
+const T& Array3D<T>::At(size_t ii, size_t jj, size_t kk) const {
+  return data_[Index(ii, jj, kk)];
 }
 
 template<typename T>
@@ -96,4 +126,56 @@ bool Array3D<T>::IsValid(size_t ii, size_t jj, size_t kk) const {
   return false;
 }
 
+template<typename T>
+size_t Array3D<T>::Index(size_t ii, size_t jj, size_t kk) const {
+  return ii * width_ * height_ + jj * height_ + kk;
+}
+
+template<typename T>
+void Array3D<T>::Fill(const T& value) {
+  std::fill(data_.begin(), data_.end(), value);
+}
+
+template<typename T>
+template<typename Visitor>
+void Array3D<T>::ForEachTiled(size_t ii0, size_t jj0, size_t kk0, size_t ii1,
+                              size_t jj1, size_t kk1, size_t tile,
+                              Visitor visitor) {
+  for (size_t ti = ii0; ti <= ii1; ti += tile) {
+    for (size_t tj = jj0; tj <= jj1; tj += tile) {
+      for (size_t tk = kk0; tk <= kk1; tk += tile) {
+        const size_t ei = std::min(ti + tile - 1, ii1);
+        const size_t ej = std::min(tj + tile - 1, jj1);
+        const size_t ek = std::min(tk + tile - 1, kk1);
+
+        for (size_t ii = ti; ii <= ei; ii++)
+          for (size_t jj = tj; jj <= ej; jj++)
+            for (size_t kk = tk; kk <= ek; kk++)
+              visitor(ii, jj, kk, data_[Index(ii, jj, kk)]);
+      }
+    }
+  }
+}
+
+template<typename T>
+template<typename Visitor>
+void Array3D<T>::ForEachStencil(size_t ii0, size_t jj0, size_t kk0,
+                                size_t ii1, size_t jj1, size_t kk1,
+                                Visitor visitor) {
+  const size_t x_stride = XStride();
+  const size_t y_stride = YStride();
+
+  for (size_t ii = ii0; ii <= ii1; ii++) {
+    for (size_t jj = jj0; jj <= jj1; jj++) {
+      size_t idx = Index(ii, jj, kk0);
+      for (size_t kk = kk0; kk <= kk1; kk++, idx++) {
+        visitor(ii, jj, kk, data_[idx],
+                data_[idx - x_stride], data_[idx + x_stride],
+                data_[idx - y_stride], data_[idx + y_stride],
+                data_[idx - 1], data_[idx + 1]);
+      }
+    }
+  }
+}
+
 #endif
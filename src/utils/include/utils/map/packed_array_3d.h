@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This defines the PackedArray3D class: a 3D array storing a 2-bit value
+// per cell, 32 cells to a 64-bit word. Besides the ~16x footprint
+// reduction over an enum per cell, scans can test a whole word of cells
+// per load via MatchMask().
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef UTILS_PACKED_ARRAY_3D_H
+#define UTILS_PACKED_ARRAY_3D_H
+
+#include <vector>
+#include <cstddef>
+#include <stdint.h>
+
+class PackedArray3D {
+public:
+  ~PackedArray3D() {}
+  PackedArray3D(size_t length, size_t width, size_t height)
+    : length_(length), width_(width), height_(height),
+      words_((length * width * height + kCellsPerWord - 1) / kCellsPerWord,
+             0) {}
+
+  static const size_t kCellsPerWord = 32;
+
+  // Accessors. Unchecked: callers gate with IsValid().
+  inline uint8_t At(size_t ii, size_t jj, size_t kk) const {
+    return Get(Index(ii, jj, kk));
+  }
+  inline uint8_t Get(size_t idx) const {
+    return (words_[idx / kCellsPerWord] >> (2 * (idx % kCellsPerWord))) & 3;
+  }
+  inline void Set(size_t ii, size_t jj, size_t kk, uint8_t value) {
+    SetFlat(Index(ii, jj, kk), value);
+  }
+  inline void SetFlat(size_t idx, uint8_t value) {
+    const size_t shift = 2 * (idx % kCellsPerWord);
+    uint64_t& word = words_[idx / kCellsPerWord];
+    word = (word & ~(static_cast<uint64_t>(3) << shift)) |
+      (static_cast<uint64_t>(value & 3) << shift);
+  }
+
+  // Test out of bounds.
+  inline bool IsValid(size_t ii, size_t jj, size_t kk) const {
+    return ii < length_ && jj < width_ && kk < height_;
+  }
+
+  // Flat index, laid out identically to Array3D (kk fastest).
+  inline size_t Index(size_t ii, size_t jj, size_t kk) const {
+    return ii * width_ * height_ + jj * height_ + kk;
+  }
+
+  // Dimensions.
+  inline size_t Length() const { return length_; }
+  inline size_t Width() const { return width_; }
+  inline size_t Height() const { return height_; }
+
+  // Overwrite every cell (padding lanes included).
+  inline void Fill(uint8_t value) {
+    const uint64_t pattern =
+      static_cast<uint64_t>(value & 3) * 0x5555555555555555ULL;
+    for (size_t ww = 0; ww < words_.size(); ww++)
+      words_[ww] = pattern;
+  }
+
+  // Raw word access for word-at-a-time scans.
+  inline const uint64_t* Words() const { return words_.data(); }
+  inline size_t NumWords() const { return words_.size(); }
+
+  // Mask with bit 2*lane set for every lane of word equal to value, so a
+  // scan visits only matching cells: lane = ctz(mask) / 2, then clear the
+  // lowest set bit and repeat.
+  static inline uint64_t MatchMask(uint64_t word, uint8_t value) {
+    const uint64_t pattern =
+      static_cast<uint64_t>(value & 3) * 0x5555555555555555ULL;
+    const uint64_t diff = word ^ pattern;
+    return ~(diff | (diff >> 1)) & 0x5555555555555555ULL;
+  }
+
+private:
+  const size_t length_, width_, height_;
+  std::vector<uint64_t> words_;
+};
+
+#endif
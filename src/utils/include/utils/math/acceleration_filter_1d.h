@@ -89,7 +89,7 @@ namespace math {
     void Propagate(double dt) {
       A_(0, 1) = dt;
       A_(1, 2) = dt;
-      A_(0, 2) = 0.5 * dt;
+      A_(0, 2) = 0.5 * dt * dt;
 
       // Update state.
       x_ = A_ * x_;
@@ -119,6 +119,58 @@ namespace math {
     RowVector3d Ha_; // acceleration measurement
 
   }; //\ class AccelerationFilter1D
+
+  // Fixed-capacity sample window with O(1) incremental statistics, for
+  // IMU-rate consumers that want windowed means and finite-difference
+  // derivatives next to the filter. The window size is a compile-time
+  // parameter, storage is in-object, and Update never allocates or
+  // rescans the window.
+  template<size_t WindowSize>
+  class SampleWindow1D {
+  public:
+    SampleWindow1D() : head_(0), count_(0), sum_(0.0) {}
+    ~SampleWindow1D() {}
+
+    // Add a sample with its timestamp.
+    void Update(double sample, double stamp) {
+      if (count_ == WindowSize)
+        sum_ -= samples_[head_];
+      else
+        count_++;
+
+      samples_[head_] = sample;
+      stamps_[head_] = stamp;
+      head_ = (head_ + 1) % WindowSize;
+      sum_ += sample;
+    }
+
+    size_t Size() const { return count_; }
+
+    // Mean over the window, maintained incrementally.
+    double Mean() const {
+      return (count_ > 0) ? sum_ / static_cast<double>(count_) : 0.0;
+    }
+
+    // Finite-difference derivative between the oldest and newest samples.
+    double Derivative() const {
+      if (count_ < 2)
+        return 0.0;
+
+      const size_t newest = (head_ + WindowSize - 1) % WindowSize;
+      const size_t oldest = (count_ == WindowSize) ? head_ : 0;
+      const double dt = stamps_[newest] - stamps_[oldest];
+      if (dt <= 0.0)
+        return 0.0;
+
+      return (samples_[newest] - samples_[oldest]) / dt;
+    }
+
+  private:
+    double samples_[WindowSize];
+    double stamps_[WindowSize];
+    size_t head_, count_;
+    double sum_;
+  }; //\ class SampleWindow1D
 } //\ namespace math
 
 #endif
@@ -39,8 +39,11 @@
 #define PATH_MATH_RANDOM_GENERATOR_H
 
 #include <ros/ros.h>
+#include <Eigen/Core>
 #include <math.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <time.h>
 #include <vector>
 
@@ -92,16 +95,45 @@ class RandomGenerator {
   // 'mean' and 'stddev'.
   void DoublesGaussian(size_t count, double mean, double stddev,
                        std::vector<double>* doubles) const;
+
+  // Fills an (n x 2) matrix with uniform samples from the given box in
+  // one call, so planner sampling loops stop paying per-call overhead.
+  void SampleUniform2D(size_t count, double xmin, double xmax,
+                       double ymin, double ymax,
+                       Eigen::MatrixXf* samples) const;
+
+ private:
+  // PCG32 (O'Neill) step. Each generator owns its own state, so separate
+  // instances -- e.g. one per planner thread -- never contend or couple
+  // the way the old global rand() did.
+  inline uint32_t Next() const {
+    const uint64_t oldstate = state_;
+    state_ = oldstate * 6364136223846793005ULL + inc_;
+    const uint32_t xorshifted =
+      static_cast<uint32_t>(((oldstate >> 18u) ^ oldstate) >> 27u);
+    const uint32_t rot = static_cast<uint32_t>(oldstate >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31u));
+  }
+
+  mutable uint64_t state_;
+  uint64_t inc_;
 };  //\class RandomGenerator
 
 // ---------------------------- IMPLEMENTATION ------------------------- //
 
-RandomGenerator::RandomGenerator(unsigned long seed) {
-  srand(seed);
+RandomGenerator::RandomGenerator(unsigned long seed)
+  : state_(0u), inc_((static_cast<uint64_t>(seed) << 1u) | 1u) {
+  // Standard PCG32 seeding sequence.
+  Next();
+  state_ += 0x853c49e6748fea9bULL + static_cast<uint64_t>(seed);
+  Next();
 }
 
-RandomGenerator::RandomGenerator() {
-  srand(Seed());
+RandomGenerator::RandomGenerator()
+  : state_(0u), inc_((static_cast<uint64_t>(Seed()) << 1u) | 1u) {
+  Next();
+  state_ += 0x853c49e6748fea9bULL + static_cast<uint64_t>(Seed());
+  Next();
 }
 
 unsigned long RandomGenerator::Seed() {
@@ -118,8 +150,7 @@ unsigned long RandomGenerator::Seed() {
 
 
 int RandomGenerator::Integer() const {
-  // TODO(eanelson: Use a threadsafe rng.
-  return rand();
+  return static_cast<int>(Next() % static_cast<uint32_t>(RAND_MAX));
 }
 
 // Generates a random integer in [0, 'max').
@@ -169,7 +200,8 @@ void RandomGenerator::IntegersUniform(size_t count, int min, int max,
 }
 
 double RandomGenerator::Double() const {
-  return static_cast<double>(Integer()) / static_cast<double>(RAND_MAX);
+  // One engine step gives the full mantissa-worth of randomness.
+  return static_cast<double>(Next()) * (1.0 / 4294967296.0);
 }
 
 double RandomGenerator::DoubleUniform(double min, double max) const {
@@ -181,8 +213,7 @@ double RandomGenerator::DoubleUniform(double min, double max) const {
       return min;
     }
 
-    double coefficient = (max - min) / static_cast<double>(RAND_MAX);
-    return min + static_cast<double>(Integer()) * coefficient;
+    return min + (max - min) * Double();
 }
 
 double RandomGenerator::DoubleGaussian(double mean, double stddev) const {
@@ -228,6 +259,20 @@ void RandomGenerator::DoublesGaussian(size_t count, double mean, double stddev,
   }
 }
 
+void RandomGenerator::SampleUniform2D(size_t count, double xmin, double xmax,
+                                      double ymin, double ymax,
+                                      Eigen::MatrixXf* samples) const {
+  if (samples == nullptr) {
+    return;
+  }
+
+  samples->resize(count, 2);
+  for (size_t i = 0; i < count; ++i) {
+    (*samples)(i, 0) = static_cast<float>(xmin + (xmax - xmin) * Double());
+    (*samples)(i, 1) = static_cast<float>(ymin + (ymax - ymin) * Double());
+  }
+}
+
 
 }  //\namespace math
 
@@ -46,7 +46,9 @@
 #define MATH_GEOMETRY_ROTATION_H
 
 #include <Eigen/Core>
+#include <Eigen/Geometry>
 #include <cmath>
+#include <cstddef>
 #include <Eigen/LU>
 #include <glog/logging.h>
 
@@ -102,6 +104,28 @@ namespace math {
   // An error metric between two rotation matrices on SO3.
   double SO3Error(const Matrix3d& R1, const Matrix3d& R2);
 
+  // Batched conversion kernels for trajectory post-processing: convert a
+  // whole array of rotations in one call, writing each result straight
+  // into caller-provided storage with no per-element temporaries. The
+  // per-element conventions match the single-rotation functions above.
+  void MatricesToEulerAngles(const Matrix3d* rotations, size_t count,
+                             Vector3d* euler_angles);
+  void MatricesToQuaternions(const Matrix3d* rotations, size_t count,
+                             Eigen::Quaterniond* quaternions);
+  void EulerAnglesToMatrices(const Vector3d* euler_angles, size_t count,
+                             Matrix3d* rotations);
+
+  // Small-angle fast path: the first-order rotation matrix, skipping all
+  // six trig evaluations. Accurate to second order in the angles, so use
+  // it only when every angle is well under a degree.
+  inline Matrix3d SmallAngleMatrix(double phi, double theta, double psi) {
+    Matrix3d R;
+    R << 1.0, -psi, theta,
+         psi, 1.0, -phi,
+        -theta, phi, 1.0;
+    return R;
+  }
+
   // ----------------------------- IMPLEMENTATION -----------------------------------
 
   // Convert from Euler angles to a rotation matrix. Phi, theta, and psi define the
@@ -230,6 +254,35 @@ namespace math {
     return (0.5 * R_vee).norm();
   }
 
+
+  // Batched conversions. Each loop writes its result directly into the
+  // output array.
+  void MatricesToEulerAngles(const Matrix3d* rotations, size_t count,
+                             Vector3d* euler_angles) {
+    CHECK_NOTNULL(rotations);
+    CHECK_NOTNULL(euler_angles);
+
+    for (size_t ii = 0; ii < count; ii++)
+      euler_angles[ii] = MatrixToEulerAngles(rotations[ii]);
+  }
+
+  void MatricesToQuaternions(const Matrix3d* rotations, size_t count,
+                             Eigen::Quaterniond* quaternions) {
+    CHECK_NOTNULL(rotations);
+    CHECK_NOTNULL(quaternions);
+
+    for (size_t ii = 0; ii < count; ii++)
+      quaternions[ii] = Eigen::Quaterniond(rotations[ii]);
+  }
+
+  void EulerAnglesToMatrices(const Vector3d* euler_angles, size_t count,
+                             Matrix3d* rotations) {
+    CHECK_NOTNULL(euler_angles);
+    CHECK_NOTNULL(rotations);
+
+    for (size_t ii = 0; ii < count; ii++)
+      rotations[ii] = EulerAnglesToMatrix(euler_angles[ii]);
+  }
 }  //\namespace math
 
 #endif
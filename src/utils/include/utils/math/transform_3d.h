@@ -44,6 +44,8 @@
 #define UTILS_MATH_TRANSFORM_3D
 
 #include <Eigen/Dense>
+#include <Eigen/Geometry>
+#include <iostream>
 
 typedef Eigen::Matrix<double, 3, 4> Matrix34d;
 
@@ -51,49 +53,65 @@ namespace math {
 
   class Transform3D {
   public:
+    // Unaligned variants so Transform3D can live inside any container or
+    // class without Eigen's aligned-new boilerplate.
+    typedef Eigen::Transform<double, 3, Eigen::Isometry, Eigen::DontAlign>
+      Isometry;
+    typedef Eigen::Quaternion<double, Eigen::DontAlign> Quaternion;
+
     ~Transform3D() {}
 
     // Constructors.
-    Transform3D() {
-      rotation_ = Eigen::Matrix3d::Identity();
-      translation_ = Eigen::Vector3d::Zero();
+    Transform3D() : transform_(Isometry::Identity()) {
+      Invalidate();
     }
     Transform3D(const Eigen::Matrix4d& tf) {
-      rotation_ = tf.block(0, 0, 3, 3);
-      translation_ = tf.block(0, 3, 3, 1);
+      transform_.linear() = tf.block(0, 0, 3, 3);
+      transform_.translation() = tf.block(0, 3, 3, 1);
+      Invalidate();
     }
     Transform3D(const Eigen::Matrix3d& rotation,
                 const Eigen::Vector3d& translation) {
-      rotation_ = rotation;
-      translation_ = translation;
+      transform_.linear() = rotation;
+      transform_.translation() = translation;
+      Invalidate();
     }
 
     // Getters.
-    Eigen::Matrix3d GetRotation() const { return rotation_; }
-    Eigen::Vector3d GetTranslation() const { return translation_; }
-    Eigen::Matrix4d GetTransform() const {
-      Eigen::Matrix4d tf = Eigen::Matrix4d::Identity();
-      tf.block(0, 0, 3, 3) = rotation_;
-      tf.block(0, 3, 3, 1) = translation_;
-      return tf;
+    Eigen::Matrix3d GetRotation() const { return transform_.linear(); }
+    Eigen::Vector3d GetTranslation() const { return transform_.translation(); }
+    Eigen::Matrix4d GetTransform() const { return transform_.matrix(); }
+
+    // Unit quaternion for this rotation, cached until the next mutation
+    // so per-publish conversions stop re-deriving it.
+    const Quaternion& GetQuaternion() const {
+      if (!quaternion_valid_) {
+        quaternion_ = Quaternion(Eigen::Matrix3d(transform_.linear()));
+        quaternion_.normalize();
+        quaternion_valid_ = true;
+      }
+      return quaternion_;
     }
+
     Matrix34d Dehomogenize() const {
       Matrix34d P;
-      P.block(0, 0, 3, 3) = rotation_;
-      P.block(0, 3, 3, 1) = translation_;
+      P.block(0, 0, 3, 3) = transform_.linear();
+      P.block(0, 3, 3, 1) = transform_.translation();
       return P;
     }
 
     // Setters.
     void SetIdentity() {
-      rotation_ = Eigen::Matrix3d::Identity();
-      translation_ = Eigen::Vector3d::Zero();
+      transform_ = Isometry::Identity();
+      Invalidate();
     }
     void SetRotation(Eigen::Matrix3d& rotation) {
-      rotation_ = rotation;
+      transform_.linear() = rotation;
+      Invalidate();
     }
     void SetTranslation(Eigen::Vector3d& translation) {
-      translation_ = translation;
+      transform_.translation() = translation;
+      Invalidate();
     }
 
     // Operators.
@@ -101,59 +119,82 @@ namespace math {
       if (this == &rhs)
         return *this;
 
-      rotation_ = rhs.GetRotation();
-      translation_ = rhs.GetTranslation();
+      transform_ = rhs.transform_;
+      Invalidate();
       return *this;
     }
-    Transform3D operator*(const Transform3D& rhs) {
-      Eigen::Matrix3d rotation = rotation_ * rhs.rotation_;
-      Eigen::Vector3d translation =
-        rotation_ * rhs.translation_ + translation_;
-
-      Transform3D product(rotation, translation);
-      return product;
+    Transform3D operator*(const Transform3D& rhs) const {
+      return Transform3D(Isometry(transform_ * rhs.transform_));
     }
-    Eigen::Vector3d operator*(const Eigen::Vector3d& rhs) {
-      return rotation_ * rhs + translation_;
+    Eigen::Vector3d operator*(const Eigen::Vector3d& rhs) const {
+      return transform_ * rhs;
     }
     void operator*=(const Transform3D& rhs) {
-      translation_ = rotation_ * rhs.translation_ + translation_;
-      rotation_ = rotation_ * rhs.rotation_;
+      transform_ = transform_ * rhs.transform_;
+      Invalidate();
     }
-    Transform3D operator-(const Transform3D& rhs) {
-      Eigen::Matrix3d rotation = rotation_.transpose() * rhs.rotation_;
-      Eigen::Vector3d translation =
-        rotation_.transpose() * (rhs.translation_ - translation_);
-
-      Transform3D delta(rotation, translation);
-      return delta;
+    Transform3D operator-(const Transform3D& rhs) const {
+      // Relative transform taking this pose to rhs.
+      return Transform3D(Isometry(transform_.inverse() * rhs.transform_));
     }
-    bool operator==(const Transform3D& rhs) {
-      return (rotation_.isApprox(rhs.rotation_, 1e-8) &&
-              translation_.isApprox(rhs.translation_, 1e-8));
+    bool operator==(const Transform3D& rhs) const {
+      return transform_.matrix().isApprox(rhs.transform_.matrix(), 1e-8);
     }
-    bool operator!=(const Transform3D& rhs) {
-      return !(rotation_.isApprox(rhs.rotation_, 1e-8) &&
-               translation_.isApprox(rhs.translation_, 1e-8));
+    bool operator!=(const Transform3D& rhs) const {
+      return !(*this == rhs);
     }
 
-    // Other operations.
-    Transform3D Inverse() {
-      Transform3D inv(rotation_.transpose(), -rotation_.transpose() * translation_);
-      return inv;
+    // Other operations. The rigid inverse is computed once and cached
+    // until the next mutation.
+    Transform3D Inverse() const {
+      if (!inverse_valid_) {
+        inverse_ = transform_.inverse(Eigen::Isometry);
+        inverse_valid_ = true;
+      }
+      return Transform3D(inverse_);
+    }
+
+    // Transform a batch of packed float points in place. stride_floats is
+    // the number of floats between consecutive points (4 for PCL's padded
+    // PointXYZ layout). One cast of the transform, then tight fused
+    // multiply-adds over the contiguous buffer.
+    void TransformPoints(float* xyz, size_t count,
+                         size_t stride_floats = 3) const {
+      const Eigen::Matrix3f rotation = transform_.linear().cast<float>();
+      const Eigen::Vector3f translation =
+        transform_.translation().cast<float>();
+
+      for (size_t ii = 0; ii < count; ii++) {
+        Eigen::Map<Eigen::Vector3f> point(xyz + stride_floats * ii);
+        point = rotation * point + translation;
+      }
     }
 
     // Printing.
     void Print(const std::string& prefix = std::string()) const {
       if (!prefix.empty())
         std::cout << prefix << std::endl;
-      std::cout << "Rotation: " << rotation_ << std::endl;
-      std::cout << "Translation: " << translation_.transpose() << std::endl;
+      std::cout << "Rotation: " << transform_.linear() << std::endl;
+      std::cout << "Translation: "
+                << transform_.translation().transpose() << std::endl;
     }
 
   private:
-    Eigen::Matrix3d rotation_;
-    Eigen::Vector3d translation_;
+    explicit Transform3D(const Isometry& transform) : transform_(transform) {
+      Invalidate();
+    }
+
+    void Invalidate() {
+      quaternion_valid_ = false;
+      inverse_valid_ = false;
+    }
+
+    Isometry transform_;
+
+    // Lazily-maintained caches.
+    mutable Quaternion quaternion_;
+    mutable Isometry inverse_;
+    mutable bool quaternion_valid_, inverse_valid_;
   }; //\ class Transform3D
 } //\ namespace math
 
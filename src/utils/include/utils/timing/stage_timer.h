@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Lightweight scoped-timer instrumentation. Each instrumented stage
+// aggregates a latency histogram into a process-wide registry, which a
+// node can periodically flush onto a diagnostics topic.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef UTILS_TIMING_STAGE_TIMER
+#define UTILS_TIMING_STAGE_TIMER
+
+#include <ros/ros.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <sstream>
+#include <limits>
+
+namespace timing {
+
+  // Aggregated statistics for one pipeline stage.
+  struct StageStats {
+    StageStats() : count(0), total(0.0),
+                   min(std::numeric_limits<double>::max()), max(0.0) {
+      for (size_t ii = 0; ii < kNumBuckets; ii++)
+        buckets[ii] = 0;
+    }
+
+    // Power-of-two latency histogram: bucket ii covers [2^ii, 2^(ii+1)) ms,
+    // with the last bucket catching everything slower.
+    static const size_t kNumBuckets = 12;
+
+    size_t count;
+    double total, min, max;
+    size_t buckets[kNumBuckets];
+  };
+
+  // Process-wide stage registry. Recording is one mutex acquisition and a
+  // map lookup per instrumented scope exit -- negligible against the
+  // millisecond-scale stages being measured.
+  class StageRegistry {
+  public:
+    static StageRegistry& Instance() {
+      static StageRegistry registry;
+      return registry;
+    }
+
+    void Record(const std::string& stage, double seconds) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      StageStats& stats = stats_[stage];
+
+      stats.count++;
+      stats.total += seconds;
+      stats.min = std::min(stats.min, seconds);
+      stats.max = std::max(stats.max, seconds);
+
+      const double ms = 1000.0 * seconds;
+      size_t bucket = 0;
+      while (bucket + 1 < StageStats::kNumBuckets && ms >= (1 << (bucket + 1)))
+        bucket++;
+      stats.buckets[bucket]++;
+    }
+
+    // Append one DiagnosticStatus per stage to msg.
+    void Fill(diagnostic_msgs::DiagnosticArray& msg) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (std::map<std::string, StageStats>::const_iterator it =
+             stats_.begin(); it != stats_.end(); ++it) {
+        const StageStats& stats = it->second;
+
+        diagnostic_msgs::DiagnosticStatus status;
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.name = it->first;
+
+        AppendValue(status, "count", stats.count);
+        AppendValue(status, "mean_ms",
+                    1000.0 * stats.total / std::max<size_t>(stats.count, 1));
+        AppendValue(status, "min_ms", 1000.0 * stats.min);
+        AppendValue(status, "max_ms", 1000.0 * stats.max);
+
+        // Histogram as a compact pipe-separated list of bucket counts.
+        std::ostringstream histogram;
+        for (size_t ii = 0; ii < StageStats::kNumBuckets; ii++) {
+          if (ii > 0)
+            histogram << "|";
+          histogram << stats.buckets[ii];
+        }
+        diagnostic_msgs::KeyValue entry;
+        entry.key = "histogram_ms_pow2";
+        entry.value = histogram.str();
+        status.values.push_back(entry);
+
+        msg.status.push_back(status);
+      }
+    }
+
+  private:
+    StageRegistry() {}
+
+    template<typename ValueType>
+    static void AppendValue(diagnostic_msgs::DiagnosticStatus& status,
+                            const std::string& key, ValueType value) {
+      std::ostringstream stream;
+      stream << value;
+
+      diagnostic_msgs::KeyValue entry;
+      entry.key = key;
+      entry.value = stream.str();
+      status.values.push_back(entry);
+    }
+
+    std::mutex mutex_;
+    std::map<std::string, StageStats> stats_;
+  }; //\ class StageRegistry
+
+  // RAII wall-clock timer for one instrumented scope.
+  class ScopedTimer {
+  public:
+    explicit ScopedTimer(const std::string& stage)
+      : stage_(stage), start_(ros::WallTime::now()) {}
+    ~ScopedTimer() {
+      StageRegistry::Instance().Record(
+        stage_, (ros::WallTime::now() - start_).toSec());
+    }
+
+  private:
+    std::string stage_;
+    ros::WallTime start_;
+  }; //\ class ScopedTimer
+
+} //\ namespace timing
+
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Cross-node pipeline tracing. The data's header stamp doubles as the
+// correlation ID -- it is the one value every stage already preserves --
+// and each participating node appends "<trace_nsec>|<stage>|<wall_nsec>"
+// records to its own pipeline_trace topic. The offline tool in
+// scripts/trace_timeline.py stitches the per-node streams back into
+// per-scan timelines.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef UTILS_TIMING_TRACE
+#define UTILS_TIMING_TRACE
+
+#include <ros/ros.h>
+#include <std_msgs/String.h>
+
+#include <cstdio>
+#include <stdint.h>
+
+namespace timing {
+
+  class TraceEmitter {
+  public:
+    TraceEmitter() {}
+    ~TraceEmitter() {}
+
+    // Advertise the sidecar topic in the node's namespace.
+    void Advertise(ros::NodeHandle node) {
+      publisher_ = node.advertise<std_msgs::String>("pipeline_trace", 100,
+                                                    false);
+    }
+
+    // Record that 'stage' handled the data identified by trace_nsec (its
+    // header stamp) now. Free when nobody subscribes.
+    void Emit(uint64_t trace_nsec, const char* stage) {
+      if (publisher_.getNumSubscribers() == 0)
+        return;
+
+      char buffer[160];
+      snprintf(buffer, sizeof(buffer), "%llu|%s|%llu",
+               static_cast<unsigned long long>(trace_nsec), stage,
+               static_cast<unsigned long long>(ros::WallTime::now().toNSec()));
+
+      std_msgs::String msg;
+      msg.data = buffer;
+      publisher_.publish(msg);
+    }
+
+  private:
+    ros::Publisher publisher_;
+  }; //\ class TraceEmitter
+
+} //\ namespace timing
+
+#endif
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2015, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Author: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// A freelist pool of point cloud buffers. Per-scan temporaries are
+// acquired from here instead of allocated fresh: a released cloud keeps
+// its points capacity, so steady state runs without multi-megabyte
+// allocations or the page faults that come with them.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef UTILS_TYPES_CLOUD_POOL_H
+#define UTILS_TYPES_CLOUD_POOL_H
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+#include <mutex>
+#include <vector>
+
+class CloudPool {
+ public:
+  typedef pcl::PointCloud<pcl::PointXYZ> PointCloud;
+
+  static CloudPool& Instance() {
+    // Intentionally leaked: clouds released during static destruction
+    // must still find a live pool.
+    static CloudPool* pool = new CloudPool();
+    return *pool;
+  }
+
+  // Acquire a cleared cloud. The shared pointer is the RAII handle: once
+  // every holder releases it, the buffer (with its grown capacity) is
+  // handed out again. Thread-safe, since pipeline stages share the pool.
+  PointCloud::Ptr Acquire() {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (size_t ii = 0; ii < clouds_.size(); ++ii) {
+      if (clouds_[ii].use_count() == 1) {
+        PointCloud::Ptr cloud = clouds_[ii];
+        cloud->points.clear();
+        cloud->width = 0;
+        cloud->height = 1;
+        cloud->is_dense = true;
+        return cloud;
+      }
+    }
+
+    PointCloud::Ptr fresh(new PointCloud);
+    clouds_.push_back(fresh);
+    return fresh;
+  }
+
+ private:
+  CloudPool() {}
+
+  std::mutex mutex_;
+  std::vector<PointCloud::Ptr> clouds_;
+};
+
+#endif
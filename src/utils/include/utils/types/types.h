@@ -45,6 +45,7 @@
 #define UTILS_TYPES_TYPES_H
 
 #include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
 #include <Eigen/Core>
 #include <limits>
 #include <vector>
@@ -64,4 +65,73 @@ namespace Point3D {
 // matrices.
 typedef ::Eigen::Matrix<double, 3, 4> Matrix34d;
 
+// Structure-of-arrays point buffer: separate contiguous x/y/z slabs, so
+// vectorized kernels stream full-width lanes instead of skipping the
+// padding float in pcl::PointXYZ's AoS layout. Conversion costs one pass
+// per scan; the layout win is reused by every downstream kernel.
+class PointBufferSoA {
+ public:
+  PointBufferSoA() {}
+  ~PointBufferSoA() {}
+
+  size_t Size() const { return x_.size(); }
+
+  void Resize(size_t count) {
+    x_.resize(count);
+    y_.resize(count);
+    z_.resize(count);
+  }
+
+  void Clear() {
+    x_.clear();
+    y_.clear();
+    z_.clear();
+  }
+
+  // Raw component slabs (16-byte aligned by the allocator on 64-bit
+  // targets, which is what SSE loads want).
+  float* X() { return x_.empty() ? NULL : &x_[0]; }
+  float* Y() { return y_.empty() ? NULL : &y_[0]; }
+  float* Z() { return z_.empty() ? NULL : &z_[0]; }
+  const float* X() const { return x_.empty() ? NULL : &x_[0]; }
+  const float* Y() const { return y_.empty() ? NULL : &y_[0]; }
+  const float* Z() const { return z_.empty() ? NULL : &z_[0]; }
+
+  // Eigen views over each component, for expression-template kernels.
+  ::Eigen::Map< ::Eigen::VectorXf> XMap() {
+    return ::Eigen::Map< ::Eigen::VectorXf>(X(), x_.size());
+  }
+  ::Eigen::Map< ::Eigen::VectorXf> YMap() {
+    return ::Eigen::Map< ::Eigen::VectorXf>(Y(), y_.size());
+  }
+  ::Eigen::Map< ::Eigen::VectorXf> ZMap() {
+    return ::Eigen::Map< ::Eigen::VectorXf>(Z(), z_.size());
+  }
+
+  // Conversions to and from the AoS cloud type, one pass each way.
+  void FromPointCloud(const ::pcl::PointCloud< ::pcl::PointXYZ>& cloud) {
+    Resize(cloud.points.size());
+    for (size_t ii = 0; ii < cloud.points.size(); ii++) {
+      x_[ii] = cloud.points[ii].x;
+      y_[ii] = cloud.points[ii].y;
+      z_[ii] = cloud.points[ii].z;
+    }
+  }
+
+  void ToPointCloud(::pcl::PointCloud< ::pcl::PointXYZ>& cloud) const {
+    cloud.points.resize(x_.size());
+    for (size_t ii = 0; ii < x_.size(); ii++) {
+      cloud.points[ii].x = x_[ii];
+      cloud.points[ii].y = y_[ii];
+      cloud.points[ii].z = z_[ii];
+    }
+    cloud.width = static_cast<uint32_t>(x_.size());
+    cloud.height = 1;
+    cloud.is_dense = true;
+  }
+
+ private:
+  std::vector<float> x_, y_, z_;
+};  //\class PointBufferSoA
+
 #endif
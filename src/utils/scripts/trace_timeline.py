@@ -0,0 +1,46 @@
+#!/usr/bin/env python
+"""Reconstruct per-scan pipeline timelines from trace records.
+
+Feed it a file of "<trace_nsec>|<stage>|<wall_nsec>" lines, one per
+record -- e.g. collected with
+    rostopic echo -p /uav_slam/pipeline_trace/data > trace.txt
+from every node's pipeline_trace topic (concatenate the files). Prints
+one timeline per trace ID with per-stage wall-clock offsets, so "how old
+is the map this goal came from" becomes reading a line.
+"""
+
+import sys
+from collections import defaultdict
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(1)
+
+    timelines = defaultdict(list)
+    for path in sys.argv[1:]:
+        with open(path) as handle:
+            for line in handle:
+                line = line.strip().strip('"')
+                parts = line.split('|')
+                if len(parts) != 3:
+                    continue
+                try:
+                    trace, wall = int(parts[0]), int(parts[2])
+                except ValueError:
+                    continue
+                timelines[trace].append((wall, parts[1]))
+
+    for trace in sorted(timelines):
+        events = sorted(timelines[trace])
+        start = events[0][0]
+        stages = ' -> '.join(
+            '%s@%+.1fms' % (stage, (wall - start) * 1e-6)
+            for wall, stage in events)
+        print('%d: %s (total %.1f ms)' %
+              (trace, stages, (events[-1][0] - start) * 1e-6))
+
+
+if __name__ == '__main__':
+    main()